@@ -0,0 +1,198 @@
+/*
+ * Microbenchmark for MVTablePartition index layouts. Builds a single partition
+ * with one version per key, then times uniformly random version lookups. Keys
+ * are hashed up front, as the distributor does for the CC threads, so only
+ * the index is measured.
+ *
+ * Lookups are timed twice: one key at a time, and in windows of keys that are
+ * prefetched before being looked up, as MVScheduler::ScheduleStream does.
+ * Finally, range scans of BENCH_SCAN_LEN keys from random start keys are timed
+ * against a partition that also keeps its keys in order.
+ *
+ * usage: build/index_bench [num_keys] [num_lookups] [cpu] [window]
+ */
+
+#include <mv_table.h>
+#include <cpuinfo.h>
+#include <machine.h>
+#include <util.h>
+#include <cstdlib>
+#include <iostream>
+#include <fstream>
+
+uint64_t recordSize = 8;
+uint32_t NUM_CC_THREADS = 1;
+uint32_t NUM_VPARTS = 1;
+
+#define BENCH_SCAN_LEN 100
+
+static const char *index_names[] = {"chained", "fingerprint8", "fingerprint16"};
+
+static void run_index(MVIndexType type, uint64_t num_keys, uint64_t *keys,
+                      uint64_t *hashes, uint64_t num_lookups,
+                      uint64_t *lookup_keys, uint64_t *lookup_hashes, int cpu,
+                      uint64_t window)
+{
+        MVRecordAllocator *alloc;
+        MVTablePartition *partition;
+        MVRecord *rec;
+        uint64_t i, j, k, start, end, found, version;
+        double build_cycles, lookup_cycles, window_cycles;
+        std::ofstream result_file;
+        bool success;
+
+        alloc = new (cpu) MVRecordAllocator(MVRecord::HeaderSize()*(num_keys+1024),
+                                            cpu, 0, 0);
+        partition = new (cpu) MVTablePartition(num_keys, cpu, alloc, type);
+        version = CREATE_MV_TIMESTAMP(1, 0);
+
+        start = rdtsc();
+        for (i = 0; i < num_keys; ++i) {
+                success = partition->WriteNewVersion(keys[i], hashes[i], NULL,
+                                                     version, &rec);
+                assert(success);
+        }
+        end = rdtsc();
+        build_cycles = (double)(end - start) / num_keys;
+
+        found = 0;
+        start = rdtsc();
+        for (i = 0; i < num_lookups; ++i) {
+                rec = partition->GetMVRecord(lookup_keys[i], lookup_hashes[i],
+                                             version + 1);
+                found += rec != NULL;
+        }
+        end = rdtsc();
+        assert(found == num_lookups);
+        lookup_cycles = (double)(end - start) / num_lookups;
+
+        found = 0;
+        start = rdtsc();
+        for (i = 0; i < num_lookups; i = j) {
+                j = i + window < num_lookups? i + window : num_lookups;
+                for (k = i; k < j; ++k) 
+                        partition->Prefetch(lookup_hashes[k]);
+                for (k = i; k < j; ++k) 
+                        partition->PrefetchHead(lookup_hashes[k]);
+                for (k = i; k < j; ++k) {
+                        rec = partition->GetMVRecord(lookup_keys[k],
+                                                     lookup_hashes[k], 
+                                                     version + 1);
+                        found += rec != NULL;
+                }
+        }
+        end = rdtsc();
+        assert(found == num_lookups);
+        window_cycles = (double)(end - start) / num_lookups;
+
+        result_file.open("results.txt", std::ios::app | std::ios::out);
+        result_file << "index_bench ";
+        result_file << "index:" << index_names[type] << " ";
+        result_file << "keys:" << num_keys << " ";
+        result_file << "lookups:" << num_lookups << " ";
+        result_file << "header_bytes:" << MVRecord::HeaderSize() << " ";
+        result_file << "insert_ns:" << build_cycles*1e9/FREQUENCY << " ";
+        result_file << "lookup_ns:" << lookup_cycles*1e9/FREQUENCY << " ";
+        result_file << "window:" << window << " ";
+        result_file << "window_lookup_ns:" << window_cycles*1e9/FREQUENCY << "\n";
+        result_file.close();
+        std::cerr << index_names[type] << ": " << lookup_cycles <<
+                " cycles per lookup, " << window_cycles << 
+                " with prefetching\n";
+}
+
+static void run_scan(MVIndexType type, uint64_t num_keys, uint64_t *keys,
+                     uint64_t *hashes, uint64_t num_scans, 
+                     uint64_t *scan_keys, int cpu)
+{
+        MVRecordAllocator *alloc;
+        MVTablePartition *partition;
+        MVRecord *rec, *versions[BENCH_SCAN_LEN];
+        uint64_t i, start, end, found, version;
+        double build_cycles, scan_cycles;
+        std::ofstream result_file;
+        bool success;
+
+        alloc = new (cpu) MVRecordAllocator(MVRecord::HeaderSize()*(num_keys+1024),
+                                            cpu, 0, 0);
+        partition = new (cpu) MVTablePartition(num_keys, cpu, alloc, type, 
+                                               true);
+        version = CREATE_MV_TIMESTAMP(1, 0);
+
+        start = rdtsc();
+        for (i = 0; i < num_keys; ++i) {
+                success = partition->WriteNewVersion(keys[i], hashes[i], NULL,
+                                                     version, &rec);
+                assert(success);
+        }
+        end = rdtsc();
+        build_cycles = (double)(end - start) / num_keys;
+
+        found = 0;
+        start = rdtsc();
+        for (i = 0; i < num_scans; ++i) 
+                found += partition->ScanRange(scan_keys[i], num_keys, 
+                                              BENCH_SCAN_LEN, version + 1,
+                                              versions);
+        end = rdtsc();
+        assert(found > 0);
+        scan_cycles = (double)(end - start) / found;
+
+        result_file.open("results.txt", std::ios::app | std::ios::out);
+        result_file << "scan_bench ";
+        result_file << "index:" << index_names[type] << " ";
+        result_file << "keys:" << num_keys << " ";
+        result_file << "scans:" << num_scans << " ";
+        result_file << "scan_len:" << BENCH_SCAN_LEN << " ";
+        result_file << "insert_ns:" << build_cycles*1e9/FREQUENCY << " ";
+        result_file << "scan_ns_per_key:" << scan_cycles*1e9/FREQUENCY << "\n";
+        result_file.close();
+        std::cerr << index_names[type] << ": " << scan_cycles << 
+                " cycles per scanned key\n";
+}
+
+int main(int argc, char **argv)
+{
+        uint64_t num_keys, num_lookups, window, i, j, *keys, *hashes;
+        uint64_t *lookup_keys, *lookup_hashes;
+        CompositeKey ckey;
+        int cpu;
+
+        num_keys = argc > 1? strtoull(argv[1], NULL, 10) : 10000000;
+        num_lookups = argc > 2? strtoull(argv[2], NULL, 10) : 10000000;
+        cpu = argc > 3? atoi(argv[3]) : 0;
+        window = argc > 4? strtoull(argv[4], NULL, 10) : 16;
+        assert(window > 0);
+        pin_thread(cpu);
+
+        keys = (uint64_t*)malloc(sizeof(uint64_t)*num_keys);
+        hashes = (uint64_t*)malloc(sizeof(uint64_t)*num_keys);
+        lookup_keys = (uint64_t*)malloc(sizeof(uint64_t)*num_lookups);
+        lookup_hashes = (uint64_t*)malloc(sizeof(uint64_t)*num_lookups);
+        assert(keys != NULL && hashes != NULL);
+        assert(lookup_keys != NULL && lookup_hashes != NULL);
+        srand(0);
+        for (i = 0; i < num_keys; ++i) {
+                ckey.tableId = 0;
+                ckey.key = i;
+                keys[i] = i;
+                hashes[i] = CompositeKey::Hash(&ckey);
+        }
+
+        /* Lookups read their keys sequentially, like a CC thread's KeyStream. */
+        for (i = 0; i < num_lookups; ++i) {
+                j = (((uint64_t)rand() << 31) | rand()) % num_keys;
+                lookup_keys[i] = keys[j];
+                lookup_hashes[i] = hashes[j];
+        }
+
+        run_index(MV_INDEX_CHAINED, num_keys, keys, hashes, num_lookups,
+                  lookup_keys, lookup_hashes, cpu, window);
+        run_index(MV_INDEX_FINGERPRINT8, num_keys, keys, hashes, num_lookups,
+                  lookup_keys, lookup_hashes, cpu, window);
+        run_index(MV_INDEX_FINGERPRINT16, num_keys, keys, hashes, num_lookups,
+                  lookup_keys, lookup_hashes, cpu, window);
+        run_scan(MV_INDEX_FINGERPRINT8, num_keys, keys, hashes, 
+                 num_lookups/BENCH_SCAN_LEN, lookup_keys, cpu);
+        return 0;
+}
@@ -18,6 +18,36 @@ fmt_si = "build/si --cc_type 3  --num_lock_threads {0} --num_txns {1} --num_reco
 
 fmt_multi_cc = "build/db --cc_type 0 --num_cc_threads {0} --num_txns {1} --epoch_size 10000 --num_records {2} --num_worker_threads {3} --txn_size {8} --experiment {4} --record_size {7} --distribution {5} --theta {6} --read_pct 0 --read_txn_size 10"
 
+fmt_bcast = "build/db --cc_type 0 --num_cc_threads {0} --num_txns {1} --epoch_size {2} --num_records 1000000 --num_worker_threads 1 --txn_size 10 --experiment 0 --record_size 1000 --distribution 0 --theta 0.0 --read_pct 0 --read_txn_size 10 --num_ppp_threads 1 --cc_fanout {3}"
+
+fmt_steal = "build/db --cc_type 0 --num_cc_threads {0} --num_txns 1000000 --epoch_size 10000 --num_records {1} --num_worker_threads {2} --txn_size 10 --experiment {3} --record_size 1000 --distribution {4} --theta 0.9 --read_pct 0 --read_txn_size 10 --exec_slice {5}"
+
+fmt_adaptive = "build/db --cc_type 0 --num_cc_threads 8 --num_txns 1000000 --epoch_size 10000 --num_records 1000000 --num_worker_threads 16 --txn_size 10 --experiment 0 --record_size 1000 --distribution 1 --theta 0.9 --read_pct 0 --read_txn_size 10 --epoch_target_us {0} --arrival_rate {1}"
+
+fmt_readers = "build/db --cc_type 0 --num_cc_threads 8 --num_txns 1000000 --epoch_size 10000 --num_records 1000000 --num_worker_threads {0} --txn_size 10 --experiment 0 --record_size 1000 --distribution 1 --theta 0.9 --read_pct {1} --read_txn_size 10 --num_reader_threads {2}"
+
+fmt_placement = "build/db --cc_type 0 --num_cc_threads 8 --num_txns 1000000 --epoch_size 10000 --num_records 1000000 --num_worker_threads {0} --txn_size 10 --experiment 0 --record_size 1000 --distribution {1} --theta 0.9 --read_pct 0 --read_txn_size 10 --payload_placement {2}"
+
+fmt_scan = "build/db --cc_type 0 --num_cc_threads 8 --num_txns 1000000 --epoch_size 10000 --num_records 1000000 --num_worker_threads 16 --txn_size 10 --experiment 5 --record_size 1000 --distribution {0} --theta 0.9 --read_pct {1} --read_txn_size {2}"
+
+fmt_churn = "build/db --cc_type 0 --num_cc_threads 8 --num_txns 1000000 --epoch_size 10000 --num_records 1000000 --num_worker_threads {0} --txn_size 8 --experiment 6 --record_size 1000 --distribution {1} --theta 0.9 --read_pct {2} --read_txn_size 10"
+
+fmt_ollp = "build/db --cc_type 0 --num_cc_threads 8 --num_txns 1000000 --epoch_size {0} --num_records 1000000 --num_worker_threads 16 --txn_size 8 --experiment 7 --record_size 1000 --distribution {1} --theta {2} --read_pct 0 --read_txn_size 10"
+
+fmt_log = "build/db --cc_type 0 --num_cc_threads 8 --num_txns 1000000 --epoch_size {0} --num_records 1000000 --num_worker_threads 16 --txn_size 10 --experiment {1} --record_size 1000 --distribution 0 --read_pct 0 --read_txn_size 10"
+
+fmt_ckpt = "build/db --cc_type 0 --num_cc_threads 8 --num_txns 1000000 --epoch_size 10000 --num_records 1000000 --num_worker_threads 16 --txn_size 10 --experiment {0} --record_size 1000 --distribution 0 --read_pct 0 --read_txn_size 10 --command_log {1}/log --checkpoint_dir {1}"
+
+fmt_lazy = "build/db --cc_type 0 --num_cc_threads 8 --num_txns 1000000 --epoch_size 10000 --num_records 1000000 --num_worker_threads 16 --txn_size 10 --experiment 0 --record_size 1000 --distribution {0} --theta 0.9 --read_pct {1} --read_txn_size 10 --lazy_depth {2}"
+
+fmt_deltas = "build/db --cc_type 0 --num_cc_threads 8 --num_txns 1000000 --epoch_size 10000 --num_records {0} --num_worker_threads {1} --txn_size 10 --experiment 3 --record_size 1000 --distribution 0 --read_pct 0 --read_txn_size 10 --incr_deltas {2}"
+
+fmt_vparts = "build/db --cc_type 0 --num_cc_threads 8 --num_txns 1000000 --epoch_size 10000 --num_records 1000000 --num_worker_threads 16 --txn_size 10 --experiment 0 --record_size 1000 --distribution 1 --theta {0} --read_pct 0 --read_txn_size 10 --num_vparts {1} --repartition_interval {2}"
+
+fmt_aborts = "build/db --cc_type 0 --num_cc_threads 8 --num_txns 1000000 --epoch_size 10000 --num_records {0} --num_worker_threads {1} --txn_size 10 --experiment 3 --record_size 1000 --distribution 0 --read_pct 0 --read_txn_size 10 --overdraft_abort {2}"
+
+fmt_watermark = "build/db --cc_type 0 --num_cc_threads 8 --num_txns 1000000 --epoch_size {0} --num_records 1000000 --num_worker_threads {1} --txn_size 10 --experiment 0 --record_size 1000 --distribution 0 --read_pct 0 --read_txn_size 10"
+
 
 def main():
 #    write_searches_top()
@@ -98,6 +128,184 @@ def test_cc():
     
         
 
+# Per-epoch cost of broadcasting batches through the CC thread tree. Reported
+# as bcast_fanout_us/bcast_fanin_us at the root, see write_results.
+def cc_broadcast(outfile):
+    os.system("rm results.txt")
+    thread_range = [4,8,16,32,64]
+    fanout_range = [0,2,4,8]
+    for t in thread_range:
+        for f in fanout_range:
+            for epoch_size in [1000, 10000]:
+                cmd = fmt_bcast.format(str(t), str(200*epoch_size), 
+                                       str(epoch_size), str(f))
+                os.system(cmd)
+    os.system("cat results.txt >> " + outfile)
+
+
+# Executor tail-of-epoch idle time (exec_idle_us) with static txn assignment 
+# (exec_slice 0) and with work stealing, on contended YCSB and SmallBank.
+def exec_stealing(outfile):
+    os.system("rm results.txt")
+    workloads = [(0, 1000000, 1), (3, 100, 0)]
+    for expt, records, distribution in workloads:
+        for workers in [8, 16, 32]:
+            for slice_size in [0, 4, 16, 64]:
+                cmd = fmt_steal.format(str(8), str(records), str(workers), 
+                                       str(expt), str(distribution), 
+                                       str(slice_size))
+                os.system(cmd)
+    os.system("cat results.txt >> " + outfile)
+
+
+# Adaptive epoch sizing: throughput and p99 latency against the latency 
+# target, with a backlog and with paced arrivals. Per-epoch sizes and stage 
+# timings are appended to epochs.txt.
+def adaptive_epochs(outfile):
+    os.system("rm results.txt epochs.txt")
+    for rate in [0, 200000, 1000000]:
+        for target in [0, 1000, 5000, 20000]:
+            os.system(fmt_adaptive.format(str(target), str(rate)))
+    os.system("cat results.txt >> " + outfile)
+
+
+# Read-heavy YCSB with read-only txns run by the executors (0 readers) or by 
+# a pool of snapshot readers, keeping the total thread count fixed.
+def snapshot_readers(outfile):
+    os.system("rm results.txt")
+    for read_pct in [50, 90, 99]:
+        for readers in [0, 4, 8, 12]:
+            cmd = fmt_readers.format(str(16 - readers), str(read_pct), 
+                                     str(readers))
+            os.system(cmd)
+    os.system("cat results.txt >> " + outfile)
+
+# Payloads placed on the writing executor's node (0), the owning CC thread's 
+# node (1) or interleaved (2), with enough executors to span sockets. Results 
+# report payload_remote_pct alongside throughput.
+def payload_placement(outfile):
+    os.system("rm results.txt")
+    for dist in [0, 1]:
+        for workers in [8, 16, 32]:
+            for placement in [0, 1, 2]:
+                cmd = fmt_placement.format(str(workers), str(dist), 
+                                           str(placement))
+                os.system(cmd)
+    os.system("cat results.txt >> " + outfile)
+
+
+def range_scans(outfile):
+    os.system("rm results.txt")
+    for dist in [0, 1]:
+        for read_pct in [1, 10, 50]:
+            for scan_len in [10, 100, 1000]:
+                cmd = fmt_scan.format(str(dist), str(read_pct), 
+                                      str(scan_len))
+                os.system(cmd)
+    os.system("cat results.txt >> " + outfile)
+
+
+def churn(outfile):
+    os.system("rm results.txt")
+    for dist in [0, 1]:
+        for workers in [8, 16, 32]:
+            for read_pct in [0, 50]:
+                cmd = fmt_churn.format(str(workers), str(dist), 
+                                       str(read_pct))
+                os.system(cmd)
+    os.system("cat results.txt >> " + outfile)
+
+
+def ollp(outfile):
+    os.system("rm results.txt")
+    for epoch_size in [1000, 10000]:
+        os.system(fmt_ollp.format(str(epoch_size), "0", "0.0"))
+        for theta in [0.5, 0.7, 0.9]:
+            cmd = fmt_ollp.format(str(epoch_size), "1", str(theta))
+            os.system(cmd)
+    os.system("cat results.txt >> " + outfile)
+
+
+# Throughput without and with the command log, then the time to replay it.
+def command_log(outfile, log_path):
+    os.system("rm results.txt")
+    for expt in [0, 3]:
+        for epoch_size in [1000, 10000]:
+            cmd = fmt_log.format(str(epoch_size), str(expt))
+            os.system(cmd)
+            os.system(cmd + " --command_log " + log_path)
+            os.system(cmd + " --command_log " + log_path + " --replay 1")
+    os.system("rm " + log_path)
+    os.system("cat results.txt >> " + outfile)
+
+
+# Throughput while checkpointing with a varying number of threads against the 
+# log alone, then the time to reload the last checkpoint and replay the rest.
+def checkpoint(outfile, ckpt_dir):
+    os.system("rm results.txt")
+    os.system("mkdir -p " + ckpt_dir)
+    for expt in [0, 3]:
+        cmd = fmt_ckpt.format(str(expt), ckpt_dir)
+        os.system(cmd.replace(" --checkpoint_dir " + ckpt_dir, ""))
+        for threads in [1, 2, 4, 8]:
+            os.system(cmd + " --checkpoint_threads " + str(threads) + 
+                      " --checkpoint_interval 20")
+            os.system(cmd + " --checkpoint_threads " + str(threads) + 
+                      " --replay 1")
+    os.system("rm -r " + ckpt_dir)
+    os.system("cat results.txt >> " + outfile)
+
+
+# Write-heavy workloads executed eagerly and with a growing number of batches 
+# deferred, with and without reads forcing deferred txns.
+def lazy(outfile):
+    os.system("rm results.txt")
+    for dist in [0, 1]:
+        for read_pct in [0, 10]:
+            for depth in [0, 1, 2, 4, 8]:
+                cmd = fmt_lazy.format(str(dist), str(read_pct), str(depth))
+                os.system(cmd)
+    os.system("cat results.txt >> " + outfile)
+
+
+def deltas(outfile):
+    os.system("rm results.txt")
+    for records in [50, 1000, 100000]:
+        for threads in [4, 8, 16, 32]:
+            for incr in [0, 1]:
+                cmd = fmt_deltas.format(str(records), str(threads), str(incr))
+                os.system(cmd)
+    os.system("cat results.txt >> " + outfile)
+
+
+def vparts(outfile):
+    os.system("rm results.txt")
+    for theta in [0.9, 0.95, 0.99]:
+        for (parts, interval) in [(8, 0), (64, 0), (64, 10), (256, 10)]:
+            cmd = fmt_vparts.format(str(theta), str(parts), str(interval))
+            os.system(cmd)
+    os.system("cat results.txt >> " + outfile)
+
+
+def aborts(outfile):
+    os.system("rm results.txt")
+    for records in [50, 1000, 100000]:
+        for threads in [4, 8, 16, 32]:
+            for abort in [0, 1]:
+                cmd = fmt_aborts.format(str(records), str(threads), str(abort))
+                os.system(cmd)
+    os.system("cat results.txt >> " + outfile)
+
+
+def watermark(outfile):
+    os.system("rm results.txt")
+    for epoch_size in [1000, 10000]:
+        for threads in [8, 16, 32, 64]:
+            cmd = fmt_watermark.format(str(epoch_size), str(threads))
+            os.system(cmd)
+    os.system("cat results.txt >> " + outfile)
+
+
 def gen_range(low, high, diff):
     ret = []
     while low <= high:
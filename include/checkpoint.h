@@ -0,0 +1,189 @@
+#ifndef         CHECKPOINT_H_
+#define         CHECKPOINT_H_
+
+#include <mv_action.h>
+#include <mv_table.h>
+#include <snapshot_reader.h>
+#include <runnable.hh>
+#include <db.h>
+#include <string>
+#include <vector>
+
+#define CHECKPOINT_MAGIC 0x54504b43
+#define CHECKPOINT_BUFFER (1<<20)
+#define CHECKPOINT_SLICE 1024
+#define CHECKPOINT_LOAD_KEYS 1000
+
+/*
+ * The manifest names the epoch of the newest complete checkpoint and the
+ * number of files it was written to, one per checkpoint thread. It replaces
+ * the previous manifest only once every file is durable, so a crash in the
+ * middle of a checkpoint leaves the previous one in place.
+ */
+struct CheckpointManifest {
+        uint32_t magic;
+        uint32_t epoch;
+        uint32_t numFiles;
+        uint32_t pad;
+};
+
+/* Start of a checkpoint file, followed by numEntries entries, size bytes. */
+struct CheckpointFileHeader {
+        uint32_t magic;
+        uint32_t epoch;
+        uint32_t fileId;
+        uint32_t pad;
+        uint64_t numEntries;
+        uint64_t size;
+};
+
+/* A checkpointed key, followed by the size bytes of its value. */
+struct CheckpointEntry {
+        uint64_t key;
+        uint32_t table;
+        uint32_t size;
+};
+
+/*
+ * Shared by the checkpoint threads. Thread 0 starts a checkpoint by setting
+ * epoch and then bumping round, every thread bumps finished once its file is
+ * durable.
+ */
+struct CheckpointRound {
+        volatile uint64_t __attribute__((aligned(CACHE_LINE))) round;
+        volatile uint32_t epoch;
+        volatile uint64_t __attribute__((aligned(CACHE_LINE))) finished;
+};
+
+struct CheckpointConfig {
+        uint32_t threadId;
+        uint32_t numThreads;
+        int cpu;
+        uint32_t numTables;
+        uint32_t numPartitions;         // Virtual partitions
+        MVTablePartition **partitions;  // [vpart*numTables + table]
+        uint64_t *recordSizes;
+        const char *dir;
+        uint32_t interval;
+        ReaderEpochs *epochs;
+        uint32_t pinId;                 // checkpointer's slot in epochs->pins
+        CheckpointRound *round;
+};
+
+/*
+ * records, bytes and write_cycles are the thread's own share of every
+ * checkpoint, write_cycles including its fdatasync. checkpoints, epoch (the
+ * newest checkpoint's) and cycles, from pinning the epoch to putting the
+ * manifest in place, are kept by thread 0 only.
+ */
+struct CheckpointStats {
+        uint64_t checkpoints;
+        uint32_t epoch;
+        uint64_t cycles;
+        uint64_t records;
+        uint64_t bytes;
+        uint64_t write_cycles;
+};
+
+/*
+ * Background checkpoints of the MV engine, taken without stopping the
+ * pipeline. Thread 0 pins the newest executed epoch like a snapshot reader
+ * (its pin is one more slot in ReaderEpochs), which holds garbage collection
+ * at that epoch until the checkpoint is done. Every thread then walks its
+ * slice of each partition's key index and writes the version visible at the
+ * epoch, found by following epoch_ancestor back from the newest version, to
+ * its own file. Deleted and absent keys are left out.
+ *
+ * A checkpoint is reloaded by one CheckpointReader per file, whose entries
+ * are installed by CheckpointLoad txns in place of the usual load.
+ */
+class Checkpointer : public Runnable {
+ private:
+        CheckpointConfig config;
+        CheckpointStats stats;
+        char *buffer;
+        uint64_t used;
+        int fd;
+        uint32_t lastEpoch;
+
+        uint32_t Pin();
+        void Unpin();
+        void Flush();
+        void Append(uint64_t key, uint32_t table, const void *value,
+                    uint32_t size);
+        void WriteFile(uint32_t epoch);
+        void WriteManifest(uint32_t epoch);
+        void RemoveFiles(uint32_t epoch);
+
+ protected:
+        virtual void StartWorking();
+        virtual void Init();
+
+ public:
+        void* operator new(std::size_t sz, int cpu) {
+                return alloc_mem(sz, cpu);
+        }
+
+        Checkpointer(CheckpointConfig config);
+        CheckpointStats GetStats();
+
+        static std::string Path(const char *dir, uint32_t epoch,
+                                uint32_t file);
+
+        /* False if dir holds no complete checkpoint. */
+        static bool ReadManifest(const char *dir,
+                                 CheckpointManifest *OUT_MANIFEST);
+
+        /* Drop the checkpoint in dir, if any, before a fresh run. */
+        static void RemoveManifest(const char *dir);
+};
+
+/* Reload txn: blind writes of a run of checkpointed keys. */
+class CheckpointLoad : public txn {
+ private:
+        std::vector<const CheckpointEntry*> entries;
+
+ public:
+        CheckpointLoad(const std::vector<const CheckpointEntry*> &entries);
+        virtual bool Run();
+        virtual uint32_t num_writes();
+        virtual void get_writes(struct big_key *array);
+};
+
+struct CheckpointReaderConfig {
+        int cpu;
+        const char *dir;
+        uint32_t epoch;
+        uint32_t fileId;
+};
+
+/*
+ * Reads one checkpoint file and cuts its entries into CheckpointLoad txns of
+ * up to CHECKPOINT_LOAD_KEYS keys, then exits. The file stays in memory, the
+ * txns point into it.
+ */
+class CheckpointReader : public Runnable {
+ private:
+        CheckpointReaderConfig config;
+        std::vector<txn*> loads;
+        uint64_t bytes;
+        volatile uint64_t done;
+
+ protected:
+        virtual void StartWorking();
+        virtual void Init();
+
+ public:
+        void* operator new(std::size_t sz, int cpu) {
+                return alloc_mem(sz, cpu);
+        }
+
+        CheckpointReader(CheckpointReaderConfig config);
+
+        /* Wait for the file to be read. */
+        void WaitDone();
+        const std::vector<txn*>& GetLoads();
+        uint64_t Bytes();
+};
+
+#endif          /* CHECKPOINT_H_ */
@@ -0,0 +1,106 @@
+#ifndef         COMMAND_LOG_H_
+#define         COMMAND_LOG_H_
+
+#include <mv_action.h>
+#include <runnable.hh>
+#include <concurrent_queue.h>
+#include <vector>
+
+#define COMMAND_LOG_MAGIC 0x4d484f42
+
+/*
+ * An epoch's entry in the log: the header, followed by numTxns txn entries,
+ * size bytes in all. checksum covers the txn entries, so an epoch that was
+ * torn by a crash is recognized on replay.
+ */
+struct CommandLogHeader {
+        uint32_t magic;
+        uint32_t epoch;
+        uint32_t numTxns;
+        uint32_t size;
+        uint64_t checksum;
+};
+
+/* A txn's entry: its stored procedure, then size bytes of parameters. */
+struct CommandLogTxn {
+        uint32_t proc;
+        uint32_t size;
+};
+
+/* An encoded epoch, header included. */
+struct CommandLogRecord {
+        uint32_t epoch;
+        uint64_t size;
+        char *data;
+};
+
+struct CommandLogConfig {
+        int cpu;
+        const char *path;
+        SimpleQueue<CommandLogRecord> *inputQueue;
+};
+
+/*
+ * syncs counts the fdatasyncs, each of which commits every epoch appended
+ * since the last one. release_waits counts the epochs whose results were
+ * held back for their log write, release_wait_cycles the time they waited.
+ */
+struct CommandLogStats {
+        uint64_t epochs;
+        uint64_t txns;
+        uint64_t bytes;
+        uint64_t syncs;
+        uint64_t sync_cycles;
+        uint64_t release_waits;
+        uint64_t release_wait_cycles;
+};
+
+/*
+ * Command log of the txns the input stage hands to the distributor. The
+ * input stage encodes each epoch's batch, the procedure and parameters of
+ * every txn (see txn::log_params), and appends it before it enqueues the
+ * batch. The log thread writes epochs out in order and group commits
+ * everything appended so far with one fdatasync, while the batches go
+ * through the CC and execution stages. An epoch's results are released
+ * once it is durable, see WaitDurable.
+ *
+ * Execution is deterministic once the order of txns is fixed, so replaying
+ * the logged epochs against the freshly loaded database rebuilds its state
+ * (see Read). Snapshot readers' txns change nothing and are not logged.
+ */
+class CommandLog : public Runnable {
+ private:
+        CommandLogConfig config;
+        int fd;
+        volatile uint64_t __attribute__((aligned(CACHE_LINE))) durableEpoch;
+        CommandLogStats stats;
+
+        void Write(const CommandLogRecord &record);
+
+ protected:
+        virtual void StartWorking();
+        virtual void Init();
+
+ public:
+        void* operator new(std::size_t sz, int cpu) {
+                return alloc_mem(sz, cpu);
+        }
+
+        CommandLog(CommandLogConfig config);
+
+        /* Encode batch and queue it for the log thread, called in order. */
+        void Append(uint32_t epoch, const ActionBatch &batch);
+
+        /* Wait until every epoch up to epoch is durable. */
+        void WaitDurable(uint32_t epoch);
+
+        CommandLogStats GetStats();
+
+        /*
+         * The epochs of the log at path, in order, up to the first that is
+         * missing or was not completely written.
+         */
+        static std::vector<CommandLogRecord> Read(const char *path);
+};
+
+#endif          /* COMMAND_LOG_H_ */
@@ -13,6 +13,7 @@
 
 #include "util.h"
 #include "machine.h"
+#include "cpuinfo.h"
 
 
 #define CACHE_PAD 64
@@ -369,6 +370,101 @@ public:
   }    
 };
 
+//
+// Chase-Lev work-stealing deque. The owner pushes and pops at the bottom,
+// thieves steal from the top. The buffer is fixed size; Push asserts that it
+// never holds more than capacity elements at once. The fences assume x86-TSO:
+// only Pop's store to bottom must be ordered before its load of top.
+//
+template<class T>
+class WorkStealingDeque {
+  PAD(volatile int64_t) m_top;
+  PAD(volatile int64_t) m_bottom;
+  T *m_buf;
+  int64_t m_mask;
+
+public:
+  void* operator new(std::size_t sz, int cpu) {
+    return alloc_mem(sz, cpu);
+  }
+
+  // capacity must be a power of 2.
+  WorkStealingDeque(uint64_t capacity, int cpu) {
+    assert(capacity > 0 && (capacity & (capacity - 1)) == 0);
+    m_buf = (T*)alloc_mem(sizeof(T)*capacity, cpu);
+    assert(m_buf != NULL);
+    m_mask = (int64_t)capacity - 1;
+    m_top.v = 0;
+    m_bottom.v = 0;
+  }
+
+  // Owner only.
+  inline void
+  Push(const T &elem) {
+    int64_t b = m_bottom.v;
+    assert(b - m_top.v <= m_mask);
+    m_buf[b & m_mask] = elem;
+    barrier();
+    m_bottom.v = b + 1;
+  }
+
+  // Owner only. Takes the most recently pushed element.
+  inline bool
+  Pop(T *OUT_ELEM) {
+    int64_t b, t;
+    bool ret;
+
+    b = m_bottom.v - 1;
+    xchgq((volatile uint64_t*)&m_bottom.v, (uint64_t)b);
+    t = m_top.v;
+    if (t > b) {
+      m_bottom.v = t;
+      return false;
+    }
+    *OUT_ELEM = m_buf[b & m_mask];
+    if (t < b)
+      return true;
+
+    // Last element, race with thieves for it.
+    ret = cmp_and_swap((volatile uint64_t*)&m_top.v, (uint64_t)t,
+                       (uint64_t)(t + 1));
+    m_bottom.v = t + 1;
+    return ret;
+  }
+
+  //
+  // Any thread. Takes the oldest element if accept(elem) holds for it. Fails
+  // if the deque is empty, the element is refused, or another thread got there
+  // first.
+  //
+  template<class Accept>
+  inline bool
+  Steal(T *OUT_ELEM, Accept accept) {
+    int64_t t, b;
+    T elem;
+
+    t = m_top.v;
+    barrier();
+    b = m_bottom.v;
+    barrier();
+    if (t >= b)
+      return false;
+    elem = m_buf[t & m_mask];
+    if (!accept(elem))
+      return false;
+    if (!cmp_and_swap((volatile uint64_t*)&m_top.v, (uint64_t)t,
+                      (uint64_t)(t + 1)))
+      return false;
+    *OUT_ELEM = elem;
+    return true;
+  }
+
+  inline bool
+  IsEmpty() {
+    return m_bottom.v <= m_top.v;
+  }
+};
+
 //
 // Use this class to get new queue_elems for inter-thread communication. The 
 // elements are pre-allocated, so we can avoid using malloc/new and the badness
@@ -7,6 +7,7 @@
 #include <pthread.h>
 #include <numa.h>
 #include <sys/mman.h>
+#include <stdint.h>
 
 #ifndef MAP_HUGETLB
 #define MAP_HUGETLB 0x40000
@@ -43,4 +44,10 @@ alloc_interleaved(size_t size, int startCpu, int endCpu);
 void*
 alloc_interleaved_all(size_t size);
 
+void*
+alloc_on_node(size_t size, int node);
+
+void
+get_mem_nodes(void **addrs, uint64_t count, int *OUT_NODES);
+
 #endif
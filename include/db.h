@@ -66,6 +66,35 @@ namespace std {
                 };
 };
 
+/* 
+ * A range read: the first limit keys of a table in [start, end), in key 
+ * order. 
+ */
+struct big_range {
+        uint64_t start;
+        uint64_t end;
+        uint32_t table_id;
+        uint32_t limit;
+};
+
+/* 
+ * Stored procedures a txn can be logged as (see txn::log_proc). Txns that 
+ * cannot be logged, like the loaders, report PROC_NONE.
+ */
+enum txn_proc {
+        PROC_NONE = 0,
+        PROC_YCSB_READONLY,
+        PROC_YCSB_RMW,
+        PROC_YCSB_CHURN,
+        PROC_YCSB_SCAN,
+        PROC_SB_BALANCE,
+        PROC_SB_DEPOSIT_CHECKING,
+        PROC_SB_TRANSACT_SAVING,
+        PROC_SB_AMALGAMATE,
+        PROC_SB_WRITE_CHECK,
+        NUM_PROCS,
+};
+
 enum usage_type {
         READ,
         WRITE,
@@ -86,11 +115,67 @@ class translator {
         virtual void *write_ref(uint64_t key, uint32_t table) = 0;
         virtual void *read(uint64_t key, uint32_t table) = 0;
         virtual int rand() = 0;
+
+        /*
+         * Positional access, for stored procedures that know where each key
+         * sits in their sets. index is the key's position in get_reads(), or
+         * in get_writes() followed by get_rmws(). The key itself is passed
+         * along too, translators that reorder their sets fall back on it.
+         */
+        virtual void *read_at(uint32_t index, uint64_t key, uint32_t table);
+        virtual void *write_ref_at(uint32_t index, uint64_t key,
+                                   uint32_t table);
+
+        /* 
+         * Result of the index'th range of get_ranges(): fills in the keys 
+         * (if OUT_KEYS is not NULL) and record values in key order, and 
+         * returns how many there are. Only the multiversion engine serves 
+         * range reads. 
+         */
+        virtual uint32_t range_at(uint32_t index, uint64_t *OUT_KEYS, 
+                                  void **OUT_VALUES);
+
+        /* Note that Run() is about to return false as a logic abort. */
+        virtual void abort();
 };
 
 /*
  * Every transaction implementation must conform to this interface. Independent 
  * of concurrency control technique used.
+ *
+ * A blind write (get_writes) inserts its key if the key does not exist. A 
+ * delete (get_deletes) removes its key; afterwards the key reads as NULL, as 
+ * does an RMW of it, until it is written again. Only the multiversion engine 
+ * serves deletes.
+ *
+ * The last num_incrs() keys of get_rmws() are commutative increments: Run() 
+ * only adds to them, treating the record as 64-bit words, and never reads 
+ * them back. Other engines run them as RMWs. The multiversion engine may 
+ * instead hand Run() a zeroed delta to add to, see Executor::Fold.
+ *
+ * A txn whose sets depend on the data it reads (e.g. keys found through a 
+ * secondary index) is reconnoitred first (OLLP): while needs_recon() is true 
+ * it is run read-only through recon(), against the latest snapshot, reading 
+ * the keys of get_recon_reads(). recon() predicts the sets the getters report 
+ * from then on. If Run() finds the data no longer matches the prediction, it 
+ * updates the prediction, leaves its writes untouched and returns false; the 
+ * txn is then restarted with the new sets in a later epoch. Such txns write 
+ * through RMWs only, and only the multiversion engine serves them.
+ *
+ * A txn that fails a business rule aborts by returning abort() from Run(). 
+ * The abort is part of the txn's deterministic outcome: the multiversion 
+ * engine rolls its versions back to copies of their predecessors, so the 
+ * txns that depend on it go ahead as if it had written nothing (see 
+ * Executor::Rollback). Such txns write through RMWs only. The other engines 
+ * do not roll back what Run() already wrote, so a txn should abort before 
+ * its first write.
+ *
+ * A txn is logged as a command (see CommandLog): its stored procedure, 
+ * log_proc(), and the log_size() bytes of parameters log_params() writes, 
+ * which the txn's from_log() rebuilds it from on replay. A replayed txn must 
+ * do exactly what the original did, so Run() may only draw random numbers 
+ * through txn_rand(), which the multiversion engine seeds from the txn's 
+ * timestamp.
  */
 class txn {
  private:
@@ -99,18 +184,36 @@ class txn {
         void* get_write_ref(uint64_t key, uint32_t table_id);
         void* get_read_ref(uint64_t key, uint32_t table_id);
         void* get_insert_ref(uint64_t key, uint32_t table_id);
+        void* get_read_at(uint32_t index, uint64_t key, uint32_t table_id);
+        void* get_write_at(uint32_t index, uint64_t key, uint32_t table_id);
+        uint32_t get_range_at(uint32_t index, uint64_t *OUT_KEYS, 
+                              void **OUT_VALUES);
         int txn_rand();
+        bool abort();
         
  public:
         txn();
+        virtual ~txn();
         virtual bool Run() = 0;
         
         virtual uint32_t num_reads();
         virtual uint32_t num_writes();
         virtual uint32_t num_rmws();
+        virtual uint32_t num_incrs();
+        virtual uint32_t num_ranges();
+        virtual uint32_t num_deletes();
         virtual void get_reads(struct big_key *array);
         virtual void get_writes(struct big_key *array);
         virtual void get_rmws(struct big_key *array);
+        virtual void get_ranges(struct big_range *array);
+        virtual void get_deletes(struct big_key *array);
+        virtual bool needs_recon();
+        virtual uint32_t num_recon_reads();
+        virtual void get_recon_reads(struct big_key *array);
+        virtual void recon();
+        virtual uint32_t log_proc();
+        virtual uint32_t log_size();
+        virtual void log_params(char *buf);
         void set_translator(translator *trans);
 };
 
@@ -4,7 +4,10 @@
 #include <scheduler.h>
 #include <mv_record.h>
 #include <database.h>
+#include <snapshot_reader.h>
+#include <algorithm>
 #include <set>
+#include <vector>
 
 struct ActionListNode {
   mv_action *action;
@@ -36,6 +39,19 @@ struct GarbageBinConfig {
   SimpleQueue<RecordList> **workerChannels;
 };
 
+/* 
+ * Garbage returned by a GarbageBin: version headers to the CC threads and 
+ * payloads to the executors. A release hands back the garbage of every epoch 
+ * since the previous release, lag is the number of epochs between the two.
+ */
+struct GarbageBinStats {
+        uint64_t versions;
+        uint64_t payloads;
+        uint64_t releases;
+        uint64_t lag_sum;
+        uint64_t max_lag;
+};
+
 class GarbageBin {
  private:
 
@@ -51,8 +67,10 @@ class GarbageBin {
   uint32_t snapshotEpoch;
 
   GarbageBinConfig config;
+  GarbageBinStats stats;
 
   void ReturnGarbage();
+  void CollectPayloads(MVRecordList stickies);
 
  public:
   void* operator new(std::size_t sz, int cpu) {
@@ -61,9 +79,9 @@ class GarbageBin {
   
   GarbageBin(GarbageBinConfig config);
 
-  void AddRecord(uint32_t workerThread, uint32_t tableId, Record *rec);
   void AddMVRecord(uint32_t ccThread, MVRecord *rec);
   void FinishEpoch(uint32_t epoch);
+  GarbageBinStats GetStats();
 };
 
 /* List of actions still to be completed as part of a particular epoch. */
@@ -97,48 +115,329 @@ class PendingActionList {
         uint32_t Size();
 };
 
+/*
+ * Where an executor places the payloads of the versions it writes.
+ * EXECUTOR keeps them on the writing executor's node. CC keeps one pool per
+ * node and places a payload on the node of the CC thread that owns its key,
+ * where the versions' headers live. INTERLEAVED spreads them over all nodes
+ * page by page.
+ */
+#define MAX_NUMA_NODES 16
+
+enum PayloadPlacement {
+        PAYLOAD_EXECUTOR = 0,
+        PAYLOAD_CC = 1,
+        PAYLOAD_INTERLEAVED = 2,
+};
+
+/* 
+ * Thread-local allocator of a single table's record payloads. Starts out with 
+ * numRecords payloads; Grow adds another chunk when recycling can't keep up.
+ * Chunks are allocated on node, or interleaved over all nodes if node is -1.
+ */
 class RecordAllocator {
  private:
   Record *freeList;
+  size_t recordSize;
+  uint32_t chunkSize;
+  int node;
+  uint32_t owner;
+  uint32_t tableId;
+  uint32_t pool;
+  uint64_t numRecords;
+  uint64_t numFree;
+
+  void AddChunk(uint32_t numRecords);
   
  public:
   void* operator new(std::size_t sz, int cpu) {
     return alloc_mem(sz, cpu);
   }
 
-  RecordAllocator(size_t recordSize, uint32_t numRecords, int cpu);  
+  RecordAllocator(size_t recordSize, uint32_t numRecords, int node,
+                  uint32_t owner, uint32_t tableId, uint32_t pool);  
   bool GetRecord(Record **OUT_REC);
   void FreeSingle(Record *rec);
   void Recycle(RecordList recList);
+  void Grow();
+  uint64_t Live();
+};
+
+class Executor;
+
+/* 
+ * A batch's ActionArena, waiting until no executor can still dereference its 
+ * actions. releaseEpoch is 0 until the low watermark passes epoch.
+ */
+struct RetiredArena {
+        ActionArena *arena;
+        uint32_t epoch;
+        uint32_t releaseEpoch;
+};
+
+/* Executors combined per group of the low watermark's tree, at most. */
+#define EXEC_WM_FANOUT 8
+
+/* An executor's or a group's finished epoch, on a cache line of its own. */
+struct EpochSlot {
+        volatile uint64_t __attribute__((aligned(CACHE_LINE))) epoch;
+};
+
+/* 
+ * Combining tree of finished epochs. Executors are grouped by NUMA node, at 
+ * most EXEC_WM_FANOUT to a group, and each group's slot holds the oldest 
+ * epoch its members have finished. An executor that finishes an epoch 
+ * publishes it in its own slot, raises its group's slot to its members' 
+ * minimum and, unless its group is the one holding the watermark back, the 
+ * low watermark to the groups' minimum (see Executor::PublishEpoch). So any 
+ * executor advances the watermark, and only group slots are read across 
+ * nodes. currentEpoch is the newest epoch any executor has finished; with 
+ * lowWatermark it gives the GC lag at any time.
+ */
+struct EpochTree {
+        uint32_t numGroups;
+        uint32_t *groupOf;              // Group of each executor
+        uint32_t *members;              // Executors, in order of group
+        uint32_t *groupStart;           // Group g's in members, numGroups+1
+        EpochSlot *executors;
+        EpochSlot *groups;
+        volatile uint64_t __attribute__((aligned(CACHE_LINE))) currentEpoch;
+        volatile uint32_t __attribute__((aligned(CACHE_LINE))) lowWatermark;
+};
+
+/* 
+ * A unit of executor work: count consecutive txns of the batch of the given 
+ * epoch.
+ */
+struct ExecSlice {
+        mv_action **actions;
+        uint32_t count;
+        uint32_t epoch;
 };
 
 struct ExecutorConfig {
         uint32_t threadId;
         uint32_t numExecutors;
         int cpu;
-        volatile uint32_t *epochPtr;
-        volatile uint32_t *lowWaterMarkPtr;
+        EpochTree *epochs;
+        volatile uint32_t *lowWaterMarkPtr;     // &epochs->lowWatermark
         SimpleQueue<ActionBatch> *inputQueue;
         SimpleQueue<ActionBatch> *outputQueue;
         uint32_t numTables;
-        uint64_t *recordSizes;
-        uint64_t *allocatorSizes;
+        uint64_t *recordSizes;          // Payload size of each table
+        uint64_t *allocatorSizes;       // Initial payloads per table
         uint32_t numQueuesPerTable;
         SimpleQueue<RecordList> *recycleQueues;
         GarbageBinConfig garbageConfig;
+        uint32_t sliceSize;             // 0 disables work stealing
+        Executor **peers;               // All executors, indexed by threadId
+        ReaderEpochs *readers;          // NULL without snapshot readers
+        PayloadPlacement placement;
+        int *ccNodes;                   // NUMA node of each CC thread
+        SimpleQueue<RestartedTxn> *restartQueue;  // NULL without recon txns
+        uint32_t lazyDepth;             // 0 executes every batch eagerly
+};
+
+/* 
+ * Recon and restarts of txns whose sets depend on the data they read (OLLP). 
+ * recons counts the recon actions run, restarts the txns whose prediction 
+ * turned out stale. Of the restarted txns that eventually committed, 
+ * restart_epochs and restart_cycles sum the epochs and the time from their 
+ * first abort until their commit.
+ */
+struct RestartStats {
+        uint64_t recons;
+        uint64_t restarts;
+        uint64_t restarted;
+        uint64_t restart_epochs;
+        uint64_t restart_cycles;
+
+        inline void Add(const RestartStats &other) {
+                recons += other.recons;
+                restarts += other.restarts;
+                restarted += other.restarted;
+                restart_epochs += other.restart_epochs;
+                restart_cycles += other.restart_cycles;
+        }
+};
+
+/* 
+ * Lazy execution. reads counts the read-only txns evaluated when their batch 
+ * arrived and forced the deferred txns they forced along the way. deferred 
+ * counts the batches deferred, deferred_sum and deferred_max sample how many 
+ * are waiting each time one is. A deferred batch is drained while the 
+ * executor has no input (idle_drains) or to make room for a new one 
+ * (full_drains).
+ */
+struct LazyStats {
+        uint64_t reads;
+        uint64_t forced;
+        uint64_t deferred;
+        uint64_t deferred_sum;
+        uint64_t deferred_max;
+        uint64_t idle_drains;
+        uint64_t full_drains;
+
+        inline void Add(const LazyStats &other) {
+                reads += other.reads;
+                forced += other.forced;
+                deferred += other.deferred;
+                deferred_sum += other.deferred_sum;
+                deferred_max = std::max(deferred_max, other.deferred_max);
+                idle_drains += other.idle_drains;
+                full_drains += other.full_drains;
+        }
+};
+
+/* 
+ * Commutative increments written as deltas. writes counts the delta versions 
+ * written, read_folds the deltas folded for a reader, and fold_chain_max the 
+ * most deltas folded at once.
+ */
+struct DeltaStats {
+        uint64_t writes;
+        uint64_t read_folds;
+        uint64_t fold_chain_max;
+
+        inline void Add(const DeltaStats &other) {
+                writes += other.writes;
+                read_folds += other.read_folds;
+                fold_chain_max = std::max(fold_chain_max, 
+                                          other.fold_chain_max);
+        }
+};
+
+/* Logic aborts rolled back, by stored procedure (see txn::log_proc). */
+struct AbortStats {
+        uint64_t procs[NUM_PROCS];
+
+        inline void Add(const AbortStats &other) {
+                for (uint32_t i = 0; i < NUM_PROCS; ++i)
+                        procs[i] += other.procs[i];
+        }
+
+        inline uint64_t Total() const {
+                uint64_t total = 0;
+                for (uint32_t i = 0; i < NUM_PROCS; ++i)
+                        total += procs[i];
+                return total;
+        }
+};
+
+/* 
+ * advances counts the times the executor raised the low watermark. Each time 
+ * it finishes an epoch, the GC lag behind the newest finished epoch is 
+ * sampled into lag_sum and lag_max.
+ */
+struct WatermarkStats {
+        uint64_t advances;
+        uint64_t lag_sum;
+        uint64_t lag_max;
+
+        inline void Add(const WatermarkStats &other) {
+                advances += other.advances;
+                lag_sum += other.lag_sum;
+                lag_max = std::max(lag_max, other.lag_max);
+        }
+};
+
+/* 
+ * Counters kept by each executor, the database load batch is not counted. 
+ * waiting_sum accumulates the number of the executor's txns that are parked 
+ * or pending each time it schedules a new txn. wakeup_cycles measures the 
+ * time from a predecessor's completion until the home executor retries the 
+ * parked txn. idle_cycles counts the time spent at the end of each batch 
+ * finding nothing to execute, neither woken txns nor slices to steal.
+ * payload_accesses counts the payloads the executor writes or copies when it
+ * installs a txn's versions, payload_remote those on another node. The 
+ * counters of optional features are kept apart.
+ */
+struct ExecutorStats {
+        uint64_t txns;
+        uint64_t parks;
+        uint64_t wakeups;
+        uint64_t wakeup_cycles;
+        uint64_t waiting_sum;
+        uint64_t max_waiting;
+        uint64_t steals;
+        uint64_t idle_cycles;
+        uint64_t payload_accesses;
+        uint64_t payload_remote;
+        RestartStats restarts;
+        LazyStats lazy;
+        DeltaStats deltas;
+        AbortStats aborts;
+        WatermarkStats wm;
+
+        inline void Add(const ExecutorStats &other) {
+                txns += other.txns;
+                parks += other.parks;
+                wakeups += other.wakeups;
+                wakeup_cycles += other.wakeup_cycles;
+                waiting_sum += other.waiting_sum;
+                max_waiting = std::max(max_waiting, other.max_waiting);
+                steals += other.steals;
+                idle_cycles += other.idle_cycles;
+                payload_accesses += other.payload_accesses;
+                payload_remote += other.payload_remote;
+                restarts.Add(other.restarts);
+                lazy.Add(other.lazy);
+                deltas.Add(other.deltas);
+                aborts.Add(other.aborts);
+                wm.Add(other.wm);
+        }
 };
 
 class Executor : public Runnable {
+
+        friend class ExecutorTest;
+
  private:
         ExecutorConfig config;
         GarbageBin *garbageBin;
         PendingActionList *pendingList;
         uint32_t epoch;
 
+        /* 
+         * Txns of this executor whose predecessors have finished, pushed by 
+         * whichever executor completed the predecessor. 
+         */
+        volatile uint64_t __attribute__((aligned(CACHE_LINE))) readyQueue;
+        uint32_t numWaiting;
+        ExecutorStats stats;
+
+        /* Slices of the current batch, stolen from by idle executors. */
+        WorkStealingDeque<ExecSlice> *slices;
+        uint32_t victim;
+
+        /* 
+         * Lazy mode: batches acknowledged but not yet executed, oldest first, 
+         * in a ring of lazyDepth. Their epochs follow epoch, the next one to 
+         * be executed. forcing is set while a new batch's reads are evaluated.
+         */
+        ActionBatch *deferred;
+        uint32_t deferredHead;
+        uint32_t numDeferred;
+        bool forcing;
+
+        /* Deltas being folded, see Fold. */
+        std::vector<MVRecord*> foldChain;
+
+        /* Arenas of processed batches, kept by executor 0 only. */
+        RetiredArena *retiredArenas;
+        uint32_t retiredHead;
+        uint32_t retiredTail;
+
+        /* 
+         * Payload pools, allocators[pool*numTables + table]. There is a pool 
+         * per node under PAYLOAD_CC, NULL for nodes without CC threads, and a 
+         * single pool otherwise.
+         */
         RecordAllocator **allocators;
+        uint32_t numPools;
+        int node;
         void **bufs;
         uint64_t buf_ptr;
-        PendingActionList *pendingGC;
         uint64_t counter;
 
  protected:
@@ -146,22 +445,51 @@ class Executor : public Runnable {
         //  Executor(ExecutorConfig config);
         virtual void StartWorking();
         virtual void Init();
-        void ReturnVersion(MVRecord *record);
 
         void ExecPending();
 
         void ProcessBatch(const ActionBatch &batch);
+        void FinishBatch(const ActionBatch &batch);
+        void Defer(const ActionBatch &batch);
+        void ForceReads(const ActionBatch &batch);
+        void Drain();
         bool ProcessSingle(mv_action *action);
         bool ProcessTxn(mv_action *action);
 
         bool run_readonly(mv_action *action);
+        void SetupAllocators();
         void RecycleData();
-
-        void adjust_lowwatermark();
-
-        uint32_t DoPendingGC();
-        bool ProcessSingleGC(mv_action *action);
+        void RecyclePools(RecordList recycled);
+
+        void PublishEpoch(uint32_t epoch);
+        bool AdvanceWatermark();
+        void FollowWatermark();
+        void AdvanceReaders(uint32_t low_watermark);
+        void RetireArena(ActionArena *arena);
+        void ReclaimArenas(uint32_t low_watermark);
+        mv_action* get_writer(MVRecord *version, uint32_t low_watermark);
+        mv_action* unwritten(MVRecord *version, uint32_t low_watermark);
+        uint32_t Fold(MVRecord *version, uint32_t table);
+        void FoldRead(MVRecord *version, uint32_t table);
+        void FoldDeltas(const ActionBatch &batch);
+
+        bool check_ranges(mv_action *action, uint32_t low_watermark);
         bool check_ready(mv_action *action);
+        bool ScheduleOwn(mv_action *action);
+        bool Park(mv_action *action, mv_action *blocker);
+        void Substantiate(mv_action *action);
+        bool RunReady();
+        void PushSlices(const ActionBatch &batch);
+        void RunSlice(const ExecSlice &slice);
+        void RunOwn(mv_action *action);
+        bool Steal(ExecSlice *OUT_SLICE);
+        uint32_t PayloadPool(uint32_t ccThread);
+        Record* AllocPayload(uint32_t pool, uint32_t tableId);
+        void CountPayload(Record *payload);
+        void InstallPayloads(mv_action *action);
+        void Resubmit(mv_action *action);
+        void Rollback(mv_action *action);
+        void CountCommit(mv_action *action);
 
  public:
         void* operator new(std::size_t sz, int cpu) {
@@ -169,6 +497,15 @@ class Executor : public Runnable {
         }
 
         Executor(ExecutorConfig config);
+        void Wake(mv_action *action);
+        ExecutorStats GetStats();
+        GarbageBinStats GetGCStats();
+        volatile uint32_t* GCWatermark();
+        volatile uint32_t* Watermark();
+        EpochTree* Epochs();
+        void SetRestartQueue(SimpleQueue<RestartedTxn> *queue);
+        uint64_t LivePayloads();
+        WorkStealingDeque<ExecSlice>* GetSlices();
 };
 
 #endif          // EXECUTOR_H_
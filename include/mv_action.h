@@ -8,21 +8,106 @@
 #define MV_EPOCH_MASK 0xFFFFFFFF00000000
 #define GET_MV_EPOCH(timestamp) (timestamp & MV_EPOCH_MASK)
 #define CREATE_MV_TIMESTAMP(epoch, timestamp) ((((uint64_t)epoch)<<32) | timestamp)
+#define MV_WAITERS_CLOSED 0x1
 
 extern uint32_t NUM_CC_THREADS;
-
-struct key_index {
-        usage_type use;
-        uint32_t index;
-        bool initialized;
-};
+extern uint32_t NUM_VPARTS;
 
 class mv_action;
 class Executor;
 
+enum KeyStreamFlags {
+        KEY_STREAM_WRITE = 0x1,
+        KEY_STREAM_RMW = 0x2,
+        KEY_STREAM_RANGE = 0x4,
+        KEY_STREAM_DELETE = 0x8,
+        KEY_STREAM_INCR = 0x10,
+};
+
+/*
+ * The keys a single CC thread handles in a batch, in timestamp order (a txn's 
+ * reads precede its writes). The distributor lays them out as a struct of 
+ * arrays so the CC thread scans them sequentially instead of chasing lists 
+ * threaded through every txn's read- and write-sets. slots[i] points to the 
+ * value field of the txn's CompositeKey, the CC thread stores the version it 
+ * finds (reads) or creates (writes) there. All arrays share one allocation 
+ * starting at keys. Every CC thread gets an entry for each of a txn's range 
+ * reads, placed with its reads; for those, keys[i] is the range's index in 
+ * the txn's range set and slots[i] is NULL.
+ */
+struct KeyStream {
+        uint32_t count;
+        uint32_t *txns;
+        uint32_t *tables;
+        uint64_t *keys;
+        uint64_t *hashes;
+        uint8_t *flags;
+        MVRecord ***slots;
+};
+
+/* 
+ * Bump allocator for one batch's mv_actions, their key sets and the batch's 
+ * action buffer, so building a batch costs no per-txn malloc. The first chunk 
+ * is sized from the epoch size, further chunks are only added if an estimate 
+ * falls short. Objects are never freed individually: the whole arena is 
+ * released once no executor can dereference the batch's actions any more 
+ * (see Executor::ReclaimArenas). The arena owns the txns of its actions, 
+ * which go with it, except those resubmitted to a later batch.
+ */
+class ActionArena {
+ private:
+        struct Chunk {
+                Chunk *next;
+                uint64_t size;
+                uint64_t used;
+                char data[0];
+        };
+        
+        Chunk *chunks;
+        uint64_t chunkSize;
+        mv_action *actions;             // Linked through arena_next
+
+        void AddChunk(uint64_t size);
+
+ public:
+        ActionArena(uint64_t size);
+        void* Alloc(uint64_t size, uint64_t alignment);
+        void AddAction(mv_action *action);
+        void Release();
+};
+
+/* 
+ * Stage timestamps (rdtsc) of an adaptively sized epoch: when the input stage 
+ * closed it, and when the CC threads finished scheduling it. 
+ */
+struct EpochTiming {
+        uint64_t closed;
+        uint64_t scheduled;
+};
+
 struct ActionBatch {
     mv_action **actionBuf;
     uint32_t numActions;
+    KeyStream *streams;         // One per CC thread, set by the distributor
+    uint32_t *owners;           // CC thread of each virtual partition, and
+    uint32_t *loads;            // the batch's keys in it (see AssignOwners)
+    ActionArena *arena;         // Backs actionBuf and its actions, may be NULL
+    EpochTiming *timing;        // NULL unless epochs are sized adaptively
+};
+
+/*
+ * A txn to be submitted again, in a later epoch's batch (see 
+ * MVActionDistributor::InjectRestarts): after its recon, or after it found 
+ * its predicted sets stale. timestamp is that of the incarnation just run. 
+ * firstEpoch and firstAbort (rdtsc) date the txn's first abort, they are 
+ * only set once restarts is non-zero.
+ */
+struct RestartedTxn {
+        txn *t;
+        uint64_t timestamp;
+        uint64_t firstAbort;
+        uint32_t firstEpoch;
+        uint32_t restarts;
 };
 
 enum ActionState {
@@ -31,48 +116,92 @@ enum ActionState {
         SUBSTANTIATED,
 };
 
+/*
+ * A txn's range read (see big_range). Keys are hash partitioned, so each CC 
+ * thread resolves its own part of the range, at most limit versions in key 
+ * order starting at versions[threadId*limit], and sets counts[threadId]. 
+ * Declaring the range up front is what keeps phantoms out: each CC thread 
+ * resolves it in timestamp order with the writes that add keys to its 
+ * partition.
+ */
+struct MVRangeRead {
+        uint64_t start;
+        uint64_t end;
+        uint32_t tableId;
+        uint32_t limit;
+        uint32_t *counts;
+        MVRecord **versions;
+};
+
 struct Record {
         Record *next;
+        uint32_t owner;         // Executor whose RecordAllocator it belongs to
+        uint16_t tableId;
+        uint8_t pool;           // Which of the owner's allocators of the table
+        int8_t node;            // NUMA node of the payload, -1 if unknown
         char value[0];
 };
 
+/* MVRecord::value points at a Record's payload, recover the Record itself. */
+static inline Record* payload_record(void *payload)
+{
+        return (Record*)((char*)payload - offsetof(Record, value));
+}
+
 struct RecordList {
         Record *head;
         Record **tail;
         uint64_t count;
 };
 
+/*
+ * A txn's reference to a record. hash is computed once, when the txn's keys 
+ * are complete (see HashBatch), and is used both to route the key to its CC 
+ * thread and to find it in that thread's partition. The hash fixes the key's 
+ * virtual partition, the CC thread that owns the partition may change from 
+ * one epoch to the next; threadId is the owner in the txn's epoch once the 
+ * distributor has seen the key.
+ */
 class CompositeKey {
  public:
         uint32_t tableId;
         uint64_t key;
+        uint64_t hash;
+        uint32_t vpart;
         uint32_t threadId;
         bool is_rmw;
+        bool is_delete;
+        bool is_incr;                   // RMW written as a delta
         MVRecord *value;
-        int next;
         bool initialized;
         
         CompositeKey() {
+                this->is_delete = false;
+                this->is_incr = false;
+                this->hash = 0;
                 this->value = NULL;
-                this->next = -1;
                 this->initialized = false;
         }
         
         CompositeKey(bool isRmw, uint32_t table, uint64_t key) {
                 this->is_rmw = isRmw;
+                this->is_delete = false;
+                this->is_incr = false;
                 this->tableId = table;
                 this->key = key;
+                this->hash = 0;
                 this->value = NULL;
-                this->next = -1;
                 this->initialized = false;
         }
   
         CompositeKey(bool isRmw) {
                 this->is_rmw = isRmw;
+                this->is_delete = false;
+                this->is_incr = false;
                 this->tableId = 0;
                 this->key = 0;
+                this->hash = 0;
                 this->value = NULL;
-                this->next = -1;
                 this->initialized = false;
         }
 
@@ -105,13 +234,68 @@ class CompositeKey {
         static inline uint64_t Hash(const CompositeKey *key) {
                 return Hash128to64(std::make_pair(key->key, (uint64_t)(key->tableId)));
         }
-  
-        static inline uint64_t HashKey(const CompositeKey *key) {
-                return Hash128to64(std::make_pair((uint64_t)key->tableId, key->key));
+
+        /* 
+         * CC thread that owns a key with the given hash. Partition indexes 
+         * use the hash's low bits for the bucket and its top bits as 
+         * fingerprints, so the owner is taken from the bits in between; 
+         * otherwise a partition would only see a fraction of its buckets.
+         */
+        static inline uint32_t Owner(uint64_t hash, uint32_t num_threads) {
+                return (uint32_t)((((hash >> 16) & 0xFFFFFFFF)*num_threads) >> 32);
         }
 
+        /* 
+         * Set hash, vpart and threadId of count keys. threadId is the owner 
+         * of vpart as virtual partitions are first laid out, one contiguous 
+         * run of them per CC thread.
+         */
+        static void HashBatch(CompositeKey *keys, uint32_t count);
+
 };// __attribute__((__packed__, __aligned__(64)));
 
+/* 
+ * Fixed-capacity array of a txn's keys, allocated from the batch's 
+ * ActionArena. Mirrors the parts of std::vector the engine uses.
+ */
+class KeyArray {
+ private:
+        CompositeKey *keys;
+        uint32_t count;
+        uint32_t capacity;
+
+ public:
+        KeyArray() {
+                this->keys = NULL;
+                this->count = 0;
+                this->capacity = 0;
+        }
+
+        void Init(CompositeKey *keys, uint32_t capacity) {
+                assert(this->count == 0);
+                this->keys = keys;
+                this->capacity = capacity;
+        }
+
+        inline uint32_t size() const {
+                return count;
+        }
+
+        inline CompositeKey& operator[](uint32_t index) {
+                assert(index < count);
+                return keys[index];
+        }
+
+        inline CompositeKey* data() {
+                return keys;
+        }
+
+        inline void push_back(const CompositeKey &key) {
+                assert(count < capacity);
+                keys[count++] = key;
+        }
+};
+
 class Action {
  protected:
         CompositeKey GenerateKey(bool is_rmw, uint32_t tableId, uint64_t key);
@@ -173,6 +357,8 @@ using namespace std;
 
 class mv_action : public translator {
         friend class Executor;
+        friend class CommandLog;
+        friend class ActionArena;
         
  private:
         mv_action(const mv_action&);
@@ -181,32 +367,91 @@ class mv_action : public translator {
  protected:
         uint32_t read_index;
         uint32_t write_index;
-        unordered_map<big_key, key_index> reverse_index;
+        uint32_t range_index;
         CompositeKey GenerateKey(bool is_rmw, uint32_t tableId, uint64_t key);
         Executor *exec;
         bool init;
+
+        /* 
+         * Event-driven wakeups. A txn blocked on an unfinished predecessor is 
+         * pushed onto the predecessor's waiters stack, linked through 
+         * next_waiter. On completion the predecessor closes the stack 
+         * (MV_WAITERS_CLOSED) and hands each waiter back to its home 
+         * executor. See Executor::Park and Executor::Substantiate.
+         */
+        mv_action *next_waiter;
+        Executor *home;
+        mv_action *blocker;             // Predecessor the last attempt hit
+        uint64_t wake_time;
+
+        /* Random numbers drawn so far, see rand(). */
+        uint32_t draws;
         
  public:
         uint64_t __version;
         uint64_t __combinedHash;
         bool __readonly;
-        std::vector<int> __write_starts;
-        std::vector<int> __read_starts;
-        std::vector<int> __nextAction;
-        std::vector<CompositeKey> __readset;
-        std::vector<CompositeKey> __writeset;
+        KeyArray __readset;
+        KeyArray __writeset;
+        MVRangeRead *__ranges;
+        uint32_t __numRanges;
+        uint32_t __numIncrs;
+
+        /* 
+         * Write the increments txns declare (see txn::num_incrs) as delta 
+         * versions rather than RMWs.
+         */
+        static bool INCR_DELTAS;
+
+        /* 
+         * A recon action only reads the txn's recon keys and runs its 
+         * recon(). The rest carries a restarted txn's RestartedTxn fields 
+         * over to its new incarnation.
+         */
+        bool __recon;
+        uint32_t __restarts;
+        uint32_t __firstEpoch;
+        uint64_t __firstAbort;
+
+        /* Run() returned false as a logic abort, see Executor::Rollback. */
+        bool __aborted;
+
+        /* 
+         * The txn was handed to a later batch (see Executor::Resubmit), whose 
+         * arena owns it from then on. 
+         */
+        bool __resubmitted;
+        mv_action *arena_next;
         
         volatile uint64_t __attribute__((aligned(CACHE_LINE))) __state;
+        volatile uint64_t waiters;
+
+        void* operator new(std::size_t sz, ActionArena *arena) {
+                return arena->Alloc(sz, CACHE_LINE);
+        }
 
         mv_action(txn *t);
 
-        void setup_reverse_index();
+        static mv_action* generate(txn *t, ActionArena *arena);
+
+        void alloc_keys(ActionArena *arena, uint32_t num_reads, 
+                        uint32_t num_writes);
+        void add_ranges(ActionArena *arena, struct big_range *ranges, 
+                        uint32_t num_ranges);
+        void hash_keys();
+        void setup_access();
         void* write_ref(uint64_t key, uint32_t table_id);
         void* read(uint64_t key, uint32_t table_id);
+        void* write_ref_at(uint32_t index, uint64_t key, uint32_t table_id);
+        void* read_at(uint32_t index, uint64_t key, uint32_t table_id);
+        uint32_t range_at(uint32_t index, uint64_t *OUT_KEYS, 
+                          void **OUT_VALUES);
         int rand();
+        void abort();
         bool Run();
         virtual void add_read_key(uint32_t tableId, uint64_t key);
         virtual void add_write_key(uint32_t tableId, uint64_t key, bool is_rmw);
+        void add_delete_key(uint32_t tableId, uint64_t key);
         bool initialized();
 };
 
@@ -0,0 +1,263 @@
+#ifndef         MV_INDEX_H_
+#define         MV_INDEX_H_
+
+#include <mv_record.h>
+#include <machine.h>
+#include <emmintrin.h>
+#include <cstring>
+#include <vector>
+
+/*
+ * Index types a MVTablePartition can be built with. CHAINED is the original
+ * layout: an array of slots, each the head of a list of MVRecords threaded
+ * through MVRecord::link. The FINGERPRINT variants use MVFingerprintIndex.
+ */
+enum MVIndexType {
+        MV_INDEX_CHAINED = 0,
+        MV_INDEX_FINGERPRINT8 = 1,
+        MV_INDEX_FINGERPRINT16 = 2,
+};
+
+/*
+ * A bucket fills exactly one cache line: the fingerprints and the number of
+ * occupied entries come first so a single 128-bit compare covers the whole
+ * bucket, followed by the head-of-chain pointers. 8-bit fingerprints leave
+ * room for 7 entries per bucket, 16-bit fingerprints for 6.
+ */
+template<typename tag_t>
+struct MVIndexBucket;
+
+template<>
+struct MVIndexBucket<uint8_t> {
+        static const uint32_t WIDTH = 7;
+        uint8_t tags[WIDTH];
+        uint8_t count;
+        MVRecord *heads[WIDTH];
+
+        /* Bitmask of occupied entries whose fingerprint equals tag. */
+        inline uint32_t Match(uint8_t tag) const {
+                __m128i tags_v, cmp_v;
+                tags_v = _mm_loadl_epi64((const __m128i*)this->tags);
+                cmp_v = _mm_cmpeq_epi8(tags_v, _mm_set1_epi8((char)tag));
+                return (uint32_t)_mm_movemask_epi8(cmp_v) & ((1<<count)-1);
+        }
+
+        static inline uint32_t Entry(uint32_t match) {
+                return (uint32_t)__builtin_ctz(match);
+        }
+
+        static inline uint32_t Next(uint32_t match) {
+                return match & (match - 1);
+        }
+} __attribute__((__aligned__(CACHE_LINE)));
+
+template<>
+struct MVIndexBucket<uint16_t> {
+        static const uint32_t WIDTH = 6;
+        uint16_t tags[WIDTH];
+        uint16_t count;
+        uint16_t pad;
+        MVRecord *heads[WIDTH];
+
+        /*
+         * _mm_movemask_epi8 yields two bits per 16-bit lane, so the mask is
+         * consumed two bits at a time.
+         */
+        inline uint32_t Match(uint16_t tag) const {
+                __m128i tags_v, cmp_v;
+                tags_v = _mm_load_si128((const __m128i*)this->tags);
+                cmp_v = _mm_cmpeq_epi16(tags_v, _mm_set1_epi16((short)tag));
+                return (uint32_t)_mm_movemask_epi8(cmp_v) & ((1<<(2*count))-1);
+        }
+
+        static inline uint32_t Entry(uint32_t match) {
+                return (uint32_t)__builtin_ctz(match) >> 1;
+        }
+
+        static inline uint32_t Next(uint32_t match) {
+                match &= match - 1;
+                return match & (match - 1);
+        }
+} __attribute__((__aligned__(CACHE_LINE)));
+
+/*
+ * Open-addressing index from a key to the newest MVRecord of its version chain.
+ * Buckets are probed linearly; the bucket is chosen by the low bits of the
+ * key's hash and the fingerprint is taken from the high bits, so a lookup
+ * normally touches one bucket and dereferences only the record whose
+ * fingerprint matches. A dead key's entry is released by setting its head to
+ * NULL (see MVTablePartition::ReclaimDeadKeys): it keeps its slot, which the
+ * next key inserted along its probe sequence reuses, so a slot once taken is
+ * never empty again. A probe therefore ends at the first bucket that is not
+ * full, or, once the table is full of live and released entries, when it
+ * wraps around to the home bucket.
+ *
+ * Single-writer, like the MVTablePartition that owns it.
+ */
+template<typename tag_t>
+class MVFingerprintIndex {
+ private:
+        typedef MVIndexBucket<tag_t> bucket_t;
+
+        bucket_t *buckets;
+        uint64_t mask;
+
+        static inline tag_t GetTag(uint64_t hash) {
+                return (tag_t)(hash >> (64 - 8*sizeof(tag_t)));
+        }
+
+ public:
+        void* operator new(std::size_t sz, int cpu) {
+                return alloc_mem(sz, cpu);
+        }
+
+        /*
+         * param size: Number of distinct keys the index must hold. Buckets are
+         * sized for a load factor of at most 3/4.
+         */
+        MVFingerprintIndex(uint64_t size, int cpu) {
+                uint64_t num_buckets, min_buckets;
+                assert(sizeof(bucket_t) == CACHE_LINE);
+                min_buckets = (4*size)/(3*bucket_t::WIDTH) + 1;
+                num_buckets = 1;
+                while (num_buckets < min_buckets)
+                        num_buckets <<= 1;
+                this->mask = num_buckets - 1;
+                this->buckets = (bucket_t*)alloc_mem(sizeof(bucket_t)*num_buckets,
+                                                     cpu);
+                assert(this->buckets != NULL);
+                memset(this->buckets, 0x0, sizeof(bucket_t)*num_buckets);
+        }
+
+        uint64_t NumBuckets() {
+                return mask + 1;
+        }
+
+        /*
+         * Append the heads of the bucket's entries that are in use. Like Find,
+         * safe to call concurrently with the owning CC thread.
+         */
+        inline void GetHeads(uint64_t index,
+                             std::vector<MVRecord*> *OUT_HEADS) {
+                bucket_t *bucket;
+                MVRecord *head;
+                uint32_t entry, count;
+
+                bucket = &buckets[index];
+                count = bucket->count;
+                for (entry = 0; entry < count; ++entry) {
+                        head = bucket->heads[entry];
+                        if (head != NULL)
+                                OUT_HEADS->push_back(head);
+                }
+        }
+
+        /* Group prefetching, stage one: the key's home bucket. */
+        inline void Prefetch(uint64_t hash) {
+                __builtin_prefetch(&buckets[hash & mask]);
+        }
+
+        /*
+         * Stage two: the record behind the first fingerprint match in the home
+         * bucket. Nothing is dereferenced, a miss or a stale match only costs
+         * a useless prefetch.
+         */
+        inline void PrefetchHead(uint64_t hash) {
+                bucket_t *bucket;
+                uint32_t match;
+
+                bucket = &buckets[hash & mask];
+                match = bucket->Match(GetTag(hash));
+                if (match != 0)
+                        __builtin_prefetch(bucket->heads[bucket_t::Entry(match)]);
+        }
+
+        /*
+         * Return a reference to key's head-of-chain pointer, NULL if the key
+         * has never been inserted. Snapshot readers call this concurrently
+         * with the owning CC thread, so an entry may be seen claimed before
+         * its head is set.
+         */
+        inline MVRecord** Find(uint64_t key, uint64_t hash) {
+                uint64_t index, start;
+                uint32_t match, entry;
+                bucket_t *bucket;
+                MVRecord *head;
+                tag_t tag;
+
+                tag = GetTag(hash);
+                start = index = hash & mask;
+                while (true) {
+                        bucket = &buckets[index];
+                        match = bucket->Match(tag);
+                        while (match != 0) {
+                                entry = bucket_t::Entry(match);
+                                head = bucket->heads[entry];
+                                if (head != NULL && head->key == key)
+                                        return &bucket->heads[entry];
+                                match = bucket_t::Next(match);
+                        }
+                        if (bucket->count < bucket_t::WIDTH)
+                                return NULL;
+                        index = (index + 1) & mask;
+                        if (index == start)
+                                return NULL;
+                }
+        }
+
+        /*
+         * Like Find, but claims an entry for key if it is absent: the first
+         * released entry along the key's probe sequence, or else a new one at
+         * its end. The head pointer of a newly claimed entry is NULL; the
+         * caller must set it before the next call into the index.
+         */
+        inline MVRecord** Upsert(uint64_t key, uint64_t hash) {
+                uint64_t index, start;
+                uint32_t match, entry;
+                bucket_t *bucket, *released;
+                MVRecord *head;
+                tag_t tag;
+
+                tag = GetTag(hash);
+                start = index = hash & mask;
+                while (true) {
+                        bucket = &buckets[index];
+                        match = bucket->Match(tag);
+                        while (match != 0) {
+                                entry = bucket_t::Entry(match);
+                                head = bucket->heads[entry];
+                                if (head != NULL && head->key == key)
+                                        return &bucket->heads[entry];
+                                match = bucket_t::Next(match);
+                        }
+                        if (bucket->count < bucket_t::WIDTH) 
+                                break;
+                        index = (index + 1) & mask;
+                        if (index == start) {
+                                bucket = NULL;          // Every bucket is full
+                                break;
+                        }
+                }
+
+                /* The key is absent, look for a released entry to reuse. */
+                for (index = start; ; index = (index + 1) & mask) {
+                        released = &buckets[index];
+                        for (entry = 0; entry < released->count; ++entry)
+                                if (released->heads[entry] == NULL)
+                                        break;
+                        if (entry < released->count || released == bucket)
+                                break;
+                        /* The index is full. */
+                        assert(((index + 1) & mask) != start);
+                }
+                released->tags[entry] = tag;
+                released->heads[entry] = NULL;
+                if (entry == released->count) {
+                        assert(released == bucket);
+                        bucket->count += 1;
+                }
+                return &released->heads[entry];
+        }
+};
+
+#endif          /* MV_INDEX_H_ */
@@ -0,0 +1,112 @@
+#ifndef         MV_ORDERED_INDEX_H_
+#define         MV_ORDERED_INDEX_H_
+
+#include <machine.h>
+#include <cpuinfo.h>
+#include <stdint.h>
+#include <cassert>
+
+#define MV_BTREE_LEAF_WIDTH 30
+#define MV_BTREE_INNER_WIDTH 31
+#define MV_BTREE_MAX_DEPTH 16
+#define MV_BTREE_CHUNK (1<<20)
+
+/*
+ * Nodes fill eight cache lines. A leaf keeps each key's hash next to it, so a
+ * scan can go straight to the key's version chain in the partition's hash
+ * index.
+ */
+struct MVBTreeHeader {
+        uint32_t count;
+        uint32_t isLeaf;
+};
+
+struct MVBTreeLeaf {
+        MVBTreeHeader header;
+        MVBTreeLeaf *next;
+        uint64_t keys[MV_BTREE_LEAF_WIDTH];
+        uint64_t hashes[MV_BTREE_LEAF_WIDTH];
+} __attribute__((__aligned__(CACHE_LINE)));
+
+/* children[i] holds the keys below keys[i], children[count] the rest. */
+struct MVBTreeInner {
+        MVBTreeHeader header;
+        uint64_t keys[MV_BTREE_INNER_WIDTH];
+        MVBTreeHeader *children[MV_BTREE_INNER_WIDTH+1];
+} __attribute__((__aligned__(CACHE_LINE)));
+
+/* Position in a leaf, see MVOrderedIndex::Seek. */
+struct MVBTreeCursor {
+        MVBTreeLeaf *leaf;
+        uint32_t pos;
+};
+
+/*
+ * B+tree over the keys of a table partition, kept alongside the hash index so
+ * the partition can serve range reads. A key is added when its first version
+ * is written and removed once the key is dead (see
+ * MVTablePartition::ReclaimDeadKeys). Nodes are never merged or freed, a leaf
+ * emptied by removals is skipped by Next. Nodes are carved out of chunks on
+ * the owning CC thread's node.
+ *
+ * Single-writer, like the MVTablePartition that owns it, and only read by the
+ * owning CC thread.
+ */
+class MVOrderedIndex {
+ private:
+        MVBTreeHeader *root;
+        uint32_t depth;
+        int cpu;
+        char *chunk;
+        uint64_t chunkUsed;
+        uint64_t numKeys;
+
+        void* AllocNode(uint64_t size);
+        MVBTreeLeaf* NewLeaf();
+        MVBTreeInner* NewInner();
+        MVBTreeHeader* InsertLeaf(MVBTreeLeaf *leaf, uint64_t key,
+                                  uint64_t hash, bool rightmost,
+                                  uint64_t *OUT_SEPARATOR);
+        MVBTreeHeader* InsertInner(MVBTreeInner *inner, uint32_t pos,
+                                   uint64_t separator, MVBTreeHeader *child,
+                                   bool rightmost, uint64_t *OUT_SEPARATOR);
+
+ public:
+        void* operator new(std::size_t sz, int cpu) {
+                return alloc_mem(sz, cpu);
+        }
+
+        MVOrderedIndex(int cpu);
+
+        /* Add a key, which must not be in the tree yet. */
+        void Insert(uint64_t key, uint64_t hash);
+
+        /* Remove a key, which must be in the tree. */
+        void Remove(uint64_t key);
+
+        /* Position the cursor at the first key not less than key. */
+        MVBTreeCursor Seek(uint64_t key);
+
+        /*
+         * Read the key under the cursor and advance it. Returns false once
+         * the cursor has run off the last leaf.
+         */
+        inline bool Next(MVBTreeCursor *cursor, uint64_t *OUT_KEY,
+                         uint64_t *OUT_HASH) {
+                while (cursor->leaf != NULL &&
+                       cursor->pos == cursor->leaf->header.count) {
+                        cursor->leaf = cursor->leaf->next;
+                        cursor->pos = 0;
+                }
+                if (cursor->leaf == NULL)
+                        return false;
+                *OUT_KEY = cursor->leaf->keys[cursor->pos];
+                *OUT_HASH = cursor->leaf->hashes[cursor->pos];
+                cursor->pos += 1;
+                return true;
+        }
+
+        uint64_t Size();
+};
+
+#endif          /* MV_ORDERED_INDEX_H_ */
@@ -5,6 +5,7 @@
 #include <cassert>
 #include <cstddef>
 #include <cpuinfo.h>
+#include <machine.h>
 #include <iostream>
 
 class mv_action;
@@ -14,29 +15,84 @@ extern uint64_t recordSize;
 
 typedef struct _MVRecord_ MVRecord;
 
+/* 
+ * A delta version holds an increment to the version it links to rather than 
+ * a value, until it is folded into one (see Executor::Fold). 
+ */
+enum DeltaState {
+        DELTA_NONE = 0,         // Holds a value: not a delta, or folded
+        DELTA_PENDING,
+        DELTA_FOLDING,
+};
+
+/* 
+ * Size of a version header with room for an inline payload, and the largest 
+ * payload stored there rather than in a Record allocated by an executor. 
+ */
+#define MV_INLINE_HEADER_SIZE (2*CACHE_LINE)
+#define MV_INLINE_SIZE (MV_INLINE_HEADER_SIZE - sizeof(MVRecord))
 
+/*
+ * The first cache line of a version header holds what CC threads touch when 
+ * walking a key's chain and what readers need to reach the version's value, 
+ * and ends with the allocator's bookkeeping. What executors check before 
+ * running or reading from the version follows. 
+ *
+ * If every table's payloads fit in MV_INLINE_SIZE bytes (INLINE_VALUES), 
+ * headers are MV_INLINE_HEADER_SIZE bytes apart and cache line aligned, and 
+ * a version's payload follows its header on the second line. Otherwise 
+ * headers are packed sizeof(MVRecord) bytes apart, and larger tables pay no 
+ * header memory for inline room they would never use.
+ */
 struct _MVRecord_ {
   
         static uint64_t INFINITY;        
 
+        /* Set once per run, before any allocator is created. */
+        static bool INLINE_VALUES;
+
         uint64_t createTimestamp;
         uint64_t deleteTimestamp;
         uint64_t key;
-        
+        MVRecord *link;        
+        MVRecord *recordLink;
+
+        // The actual value of the record: either inlineValue, or the payload 
+        // of a Record owned by the per-table RecordAllocator of executor 
+        // writingThread. NULL until the writer is executed, see 
+        // Executor::InstallPayloads.
+        void *value;        
+
+        MVRecord *allocLink;
+        uint32_t writingThread;
+
+        // The version deletes its key (see MVTablePartition::WriteNewVersion). 
+        // A tombstone never gets a value.
+        bool tombstone;
+
+        // A DeltaState, set with the version by the CC thread.
+        volatile uint8_t deltaState;
+
         // The transaction responsible for creating a value associated with the 
         // record.
         mv_action *writer;
-        
-        // The actual value of the record.
-        Record *value;        
-
-        MVRecord *link;        
-        MVRecord *recordLink;
         MVRecord *epoch_ancestor;
-        MVRecord *allocLink;
 
-        uint32_t writingThread;
-} __attribute__((__packed__));
+        /* Distance between two headers handed out by an allocator. */
+        static inline uint64_t HeaderSize() {
+                return INLINE_VALUES? MV_INLINE_HEADER_SIZE : sizeof(MVRecord);
+        }
+
+        /* Room for the payload, in headers allocated with INLINE_VALUES. */
+        inline void* InlineValue() {
+                assert(INLINE_VALUES);
+                return (void*)(this + 1);
+        }
+
+        inline bool IsInline() {
+                return INLINE_VALUES && value == (void*)(this + 1);
+        }
+};
 
 /*
  * MVRecords are returned to the allocator (defined below) in bulk using this 
@@ -61,6 +117,11 @@ class MVRecordAllocator {
   MVRecord *freeList;
   uint64_t count;
   uint64_t size;
+  uint64_t capacity;
+  int cpu;
+  uint64_t grown;
+
+  void AddChunk(uint64_t size);
  public:
 
   void* operator new(std::size_t sz, int cpu) {
@@ -68,7 +129,8 @@ class MVRecordAllocator {
   };
         
   // Constructor takes a size parameter, which is the total number of bytes 
-  // allocator can work with.
+  // allocator can work with. Only version headers come out of this space, 
+  // record payloads are allocated by executors.
   MVRecordAllocator(uint64_t size, int cpu, int worker_start, int worker_end);
         
   // 
@@ -76,9 +138,25 @@ class MVRecordAllocator {
   void ReturnMVRecords(MVRecordList recordList);  
   void WriteAllocator();
 
+  // Add an eighth of the initial size in version headers. The initial size 
+  // is a soft limit: a CC thread whose garbage comes back too slowly grows 
+  // its allocator rather than stall the pipeline (see 
+  // MVScheduler::RefillVersions).
+  void Grow();
+
+  // Bytes added by Grow.
+  inline uint64_t Grown() {
+    return grown;
+  }
+
   inline bool Warning() {
     return count < 128;
   }
+
+  // Versions handed out and not yet returned.
+  inline uint64_t Live() {
+    return capacity - count;
+  }
 };
 
 #endif          /* MV_RECORD_H_ */
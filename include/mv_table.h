@@ -3,11 +3,25 @@
 
 #include <mv_record.h>
 #include <mv_action.h>
+#include <mv_index.h>
+#include <mv_ordered_index.h>
+#include <deque>
+#include <vector>
 
+#define MV_SCAN_WINDOW 16
+
+/* A tombstone at the head of its key's chain, see ReclaimDeadKeys. */
+struct MVDeadKey {
+  MVRecord *tombstone;
+  uint64_t timestamp;
+  uint64_t key;
+  uint64_t hash;
+};
 
 /*
- * Single-writer hash table. Each scheduler thread contains a unique 
- * MVTablePartition for every table in the system.
+ * Single-writer hash table. Each virtual partition has a unique 
+ * MVTablePartition for every table in the system, written only by the 
+ * scheduler thread that currently owns the virtual partition.
  */
 class MVTablePartition {
         
@@ -15,6 +29,18 @@ class MVTablePartition {
   MVRecordAllocator *allocator;
   uint64_t numSlots;
   MVRecord **tableSlots;
+  MVIndexType indexType;
+  MVFingerprintIndex<uint8_t> *index8;
+  MVFingerprintIndex<uint16_t> *index16;
+  MVOrderedIndex *ordered;
+
+  // Tombstones in timestamp order, and tombstones unlinked from the index 
+  // in the order they were unlinked, timestamp set to the epoch they were 
+  // unlinked in.
+  std::deque<MVDeadKey> deadKeys;
+  std::deque<MVDeadKey> unlinkedKeys;
+
+  MVRecord** GetHeadRef(uint64_t key, uint64_t hash, bool insert);
         
  public:
 
@@ -23,9 +49,14 @@ class MVTablePartition {
       }
   // Constructor. 
   //
-  // param size: Number of slots in the hash table.
+  // param size: Number of slots in the hash table. For the fingerprint 
+  //             indexes, the number of distinct keys.
   // param alloc: Allocator to use for creating MVRecords.
-  MVTablePartition(uint64_t size, int cpu, MVRecordAllocator *alloc);     
+  // param indexType: Layout of the key to version chain index.
+  // param ordered: Also keep the keys in order, for ScanRange.
+  MVTablePartition(uint64_t size, int cpu, MVRecordAllocator *alloc,
+                   MVIndexType indexType = MV_INDEX_CHAINED, 
+                   bool ordered = false);     
         
   // Get the latest version for the given primary key. If we're unable to find
   // a live instance of the record, return false. Otherwise, return true.
@@ -46,9 +77,80 @@ class MVTablePartition {
   // return value: true if the write is successful, false otherwise. 
   bool WriteNewVersion(CompositeKey &pkey, mv_action *action, uint64_t version);
 
+  // Same as above, for callers that already hold the key's hash (see 
+  // KeyStream). The new version is returned through OUT_RECORD. A write 
+  // inserts the key if it is absent. With KEY_STREAM_DELETE in flags the 
+  // version is a tombstone, which deletes the key. An RMW (KEY_STREAM_RMW) 
+  // of an absent or deleted key has nothing to modify, so its version is a 
+  // tombstone too. Otherwise, an increment (KEY_STREAM_INCR) is a delta.
+  bool WriteNewVersion(uint64_t key, uint64_t hash, mv_action *action, 
+                       uint64_t version, MVRecord **OUT_RECORD,
+                       uint8_t flags = KEY_STREAM_WRITE);
 
   MVRecord* GetMVRecord(const CompositeKey &pkey, uint64_t version);
 
+  MVRecord* GetMVRecord(uint64_t key, uint64_t hash, uint64_t version);
+
+  // Resolve a range read against this partition: the versions visible at 
+  // the given timestamp of its first limit keys in [start, end), in key 
+  // order. Requires the ordered index.
+  //
+  // return value: The number of versions stored in OUT_VERSIONS.
+  uint32_t ScanRange(uint64_t start, uint64_t end, uint32_t limit, 
+                     uint64_t version, MVRecord **OUT_VERSIONS);
+
+  // Number of positions in the key index: hash slots for the chained index, 
+  // buckets for the fingerprint indexes.
+  uint64_t IndexSize();
+
+  // Append the newest version of every key indexed at positions [start, end) 
+  // to OUT_HEADS, for walking the whole partition a slice at a time. Like 
+  // GetMVRecord, this may be called by threads other than the owning CC 
+  // thread.
+  void GetHeads(uint64_t start, uint64_t end, 
+                std::vector<MVRecord*> *OUT_HEADS);
+
+  // Give dead keys' index entries and tombstones back once the low watermark 
+  // shows nobody can read them any more. Called by the owning CC thread 
+  // before it schedules epoch.
+  //
+  // return value: The number of keys removed from the index.
+  uint32_t ReclaimDeadKeys(uint32_t low_watermark, uint32_t epoch);
+
+  // Allocator new versions come from: that of the CC thread that owns the 
+  // partition, which changes when it moves to another CC thread between 
+  // epochs (see MVScheduler::AdoptPartitions).
+  MVRecordAllocator* Allocator() {
+    return allocator;
+  }
+
+  void SetAllocator(MVRecordAllocator *alloc) {
+    allocator = alloc;
+  }
+
+  // Software prefetching for batched lookups. Prefetch pulls in the index 
+  // entry key hashes to, PrefetchHead the newest version it points at. Both 
+  // are hints only, but PrefetchHead reads the index entry, so callers issue 
+  // it a window of keys after Prefetch, once the entry has arrived (see 
+  // MVScheduler::ScheduleStream).
+  inline void Prefetch(uint64_t hash) {
+    if (indexType == MV_INDEX_FINGERPRINT8)
+      index8->Prefetch(hash);
+    else if (indexType == MV_INDEX_FINGERPRINT16)
+      index16->Prefetch(hash);
+    else
+      __builtin_prefetch(&tableSlots[hash % numSlots]);
+  }
+
+  inline void PrefetchHead(uint64_t hash) {
+    if (indexType == MV_INDEX_FINGERPRINT8)
+      index8->PrefetchHead(hash);
+    else if (indexType == MV_INDEX_FINGERPRINT16)
+      index16->PrefetchHead(hash);
+    else
+      __builtin_prefetch(tableSlots[hash % numSlots]);
+  }
+
   
   
   //  void WritePartition();
@@ -2,6 +2,7 @@
 #define PREPROCESSOR_H_
 
 #include <sstream>
+#include <vector>
 
 #include <mv_action.h>
 #include <runnable.hh>
@@ -12,6 +13,15 @@
 
 extern uint64_t recordSize;
 
+/* Epochs between a txn's recon or abort and its next incarnation. */
+#define MV_RESTART_DELAY 4
+
+/* 
+ * Imbalance, in percent of the average keys per CC thread, the busiest CC 
+ * thread may carry before virtual partitions are moved off it. 
+ */
+#define MV_REPARTITION_SLACK 10
+
 class CompositeKey;
 class mv_action;
 class MVRecordAllocator;
@@ -33,7 +43,12 @@ struct MVActionDistributorConfig {
  * Its job is to take incoming batches and assign transactions to a
  * concurrency control worker thread (or virtual partition)
  *
- * The number of virtual partitions is fixed for now
+ * Keys hash to a fixed number of virtual partitions (NUM_VPARTS). The 
+ * distributor that takes batches off the input queue decides which CC thread 
+ * owns each of them, per batch, and moves partitions from busy CC threads to 
+ * idle ones every repartitionInterval batches (see Repartition). A CC thread 
+ * takes over the partitions a batch assigns it before scheduling the batch; 
+ * the CC threads finish a batch before any of them starts the next.
  */
 
 class MVActionDistributor : public Runnable {
@@ -43,18 +58,50 @@ class MVActionDistributor : public Runnable {
 
     static uint32_t GetCCThread(CompositeKey& key);
 
+    /* 
+     * Txns to submit again, see InjectRestarts. Only the distributor that 
+     * takes batches off the input queue injects them; epoch is that of its 
+     * next batch.
+     */
+    volatile uint32_t *lowWaterMark;
+    SimpleQueue<RestartedTxn> *restartQueues;
+    uint32_t numRestartQueues;
+    std::vector<RestartedTxn> restarts;
+    uint32_t epoch;
+
+    void DrainRestarts();
+    bool InjectRestarts(ActionBatch *batch);
+
+    /* 
+     * Owner of each virtual partition for the batches to come, and the keys 
+     * each partition saw in the batches since the last repartitioning, 
+     * which are counted in epoch order. Kept by the same distributor.
+     */
+    uint32_t *owners;
+    uint64_t *loads;
+    uint32_t repartitionInterval;
+    uint32_t numCounted;
+    bool loaded;
+
+    void AssignOwners(ActionBatch *batch);
+    void CountLoads(const ActionBatch &batch);
+    void Repartition();
+
   protected:
 
     virtual void Init();
     virtual void StartWorking();
-    void ProcessAction(mv_action * action, int* lastActions, mv_action** batch, int index);
+    void BuildStreams(ActionBatch *batch);
     bool leader;
 
   public:
     void* operator new(std::size_t sz, int cpu);
 
     MVActionDistributor(MVActionDistributorConfig config);
-  static uint32_t NUM_CC_THREADS;
+    void SetRestarts(volatile uint32_t *lowWaterMark, 
+                     SimpleQueue<RestartedTxn> *queues, uint32_t numQueues);
+    void SetRepartitioning(uint32_t interval);
+    static uint32_t NUM_CC_THREADS;
 };
 
 
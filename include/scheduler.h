@@ -20,7 +20,12 @@ struct MVSchedulerConfig {
   uint32_t threadId;            // The scheduler thread ID [0..NUM_CC_THREADS]
   size_t allocatorSize;         // Scheduler thread's local sticky allocator
   uint32_t numTables;           // Number of tables in the system
-  size_t *tblPartitionSizes;    // Size of each table's partition
+  size_t *tblPartitionSizes;    // Size of each table's virtual partitions
+  uint32_t numVParts;           // Virtual partitions of every table
+  MVTablePartition **partitions;        // Shared, [vpart*numTables + table]
+  MVIndexType indexType;        // Layout of each partition's index
+  uint32_t prefetchWindow;      // Keys looked up together, <= 1 disables
+  bool rangeIndex;              // Keep keys in order for range reads
   
   uint32_t numOutputs;
         
@@ -37,6 +42,24 @@ struct MVSchedulerConfig {
   int worker_end;
 };
 
+/*
+ * Per-epoch broadcast costs observed by a CC thread, in cycles. fanout_cycles 
+ * is time spent handing each batch to the thread's children in the broadcast 
+ * tree, fanin_cycles is time spent waiting on the children after the thread 
+ * has scheduled its own keys. The database load batch is not counted.
+ */
+struct MVSchedulerStats {
+        uint64_t batches;
+        uint64_t keys;
+        uint64_t fanout_cycles;
+        uint64_t sched_cycles;
+        uint64_t fanin_cycles;
+        uint64_t dead_keys;             // Index entries of dead keys released
+        uint64_t vparts_adopted;        // Virtual partitions taken over
+        uint64_t version_grows;         // Allocator grown, GC behind
+        uint64_t grow_lag_max;          // Most epochs GC was behind at one
+};
+
 /*
  * MVScheduler implements scheduling logic. The scheduler is partitioned across 
  * several physical cores.
@@ -50,19 +73,36 @@ class MVScheduler : public Runnable {
     MVSchedulerConfig config;
     MVRecordAllocator *alloc;
 
+    /* 
+     * Every CC thread's partitions. This thread creates those of the virtual 
+     * partitions it starts out with, and writes to those the current batch 
+     * assigns it (see MVActionDistributor).
+     */
     MVTablePartition **partitions;
 
-    uint32_t epoch;
+    uint32_t epoch;                     // Of the batch being scheduled
     uint32_t txnCounter;
+    volatile uint32_t *lowWaterMarkPtr;
     uint64_t txnMask;
 
     uint32_t threadId;
+    MVSchedulerStats stats;
 
  protected:
         virtual void StartWorking();
-        void ScheduleTransaction(mv_action *action);
+        void ScheduleStream(ActionBatch *batch);
+        void PrefetchEntries(KeyStream *stream, uint32_t start, uint32_t end);
+        void ScheduleKey(ActionBatch *batch, KeyStream *stream, uint32_t i);
     virtual void Init();
     virtual void Recycle();
+    void RefillVersions();
+    void AdoptPartitions(const ActionBatch &batch);
+    void ReclaimDeadKeys(const ActionBatch &batch);
+
+    inline MVTablePartition* Partition(uint64_t hash, uint32_t table) {
+            return partitions[CompositeKey::Owner(hash, config.numVParts)*
+                              config.numTables + table];
+    }
  public:
     
     void* operator new (std::size_t sz, int cpu) {
@@ -71,6 +111,11 @@ class MVScheduler : public Runnable {
 
     static uint32_t NUM_CC_THREADS;
     MVScheduler(MVSchedulerConfig config);
+    MVSchedulerStats GetStats();
+    uint64_t LiveVersions();
+    uint64_t GrownVersions();
+    MVTablePartition* GetPartition(uint32_t vpart, uint32_t tableId);
+    void SetWatermark(volatile uint32_t *lowWaterMarkPtr);
 };
 
 
@@ -23,6 +23,10 @@ struct SmallBankRecord {
 
 namespace SmallBank {
 
+        /* 
+         * Balances are drawn from a hash of the customer id, so that a 
+         * replay of the command log starts from the same database.
+         */
         class LoadCustomerRange : public txn {
         private:
                 std::vector<long> balances;
@@ -45,6 +49,10 @@ namespace SmallBank {
                 virtual bool Run();
                 virtual uint32_t num_reads();
                 virtual void get_reads(struct big_key *array);
+                virtual uint32_t log_proc();
+                virtual uint32_t log_size();
+                virtual void log_params(char *buf);
+                static txn* from_log(const char *params, uint32_t size);
         };
 
         class DepositChecking : public txn {
@@ -56,7 +64,12 @@ namespace SmallBank {
                 DepositChecking(uint64_t customer, long amount);               
                 virtual bool Run();
                 virtual uint32_t num_rmws();
+                virtual uint32_t num_incrs();
                 virtual void get_rmws(struct big_key *array);
+                virtual uint32_t log_proc();
+                virtual uint32_t log_size();
+                virtual void log_params(char *buf);
+                static txn* from_log(const char *params, uint32_t size);
         };
 
         class TransactSaving : public txn {    
@@ -68,7 +81,12 @@ namespace SmallBank {
                 TransactSaving(uint64_t customer, long amount);
                 virtual bool Run();
                 virtual uint32_t num_rmws();
+                virtual uint32_t num_incrs();
                 virtual void get_rmws(struct big_key *array);
+                virtual uint32_t log_proc();
+                virtual uint32_t log_size();
+                virtual void log_params(char *buf);
+                static txn* from_log(const char *params, uint32_t size);
         };
 
         class Amalgamate : public txn {
@@ -80,20 +98,34 @@ namespace SmallBank {
                 virtual bool Run();
                 virtual uint32_t num_rmws();
                 virtual void get_rmws(struct big_key *array);
+                virtual uint32_t log_proc();
+                virtual uint32_t log_size();
+                virtual void log_params(char *buf);
+                static txn* from_log(const char *params, uint32_t size);
         };
   
+        /* 
+         * A check that overdraws the customer's accounts costs a penalty of 
+         * 1, or with overdraft_abort set, aborts the txn (see txn::abort).
+         */
         class WriteCheck : public txn {
         private:
                 long check_amount;
                 uint64_t customer_id;
+                bool overdraft_abort;
         public:
-                WriteCheck(uint64_t customer, long check_amount);
+                WriteCheck(uint64_t customer, long check_amount, 
+                           bool overdraft_abort);
                 virtual bool Run();
 
                 virtual uint32_t num_reads();
                 virtual uint32_t num_rmws();
                 virtual void get_reads(struct big_key *array);
                 virtual void get_rmws(struct big_key *array);
+                virtual uint32_t log_proc();
+                virtual uint32_t log_size();
+                virtual void log_params(char *buf);
+                static txn* from_log(const char *params, uint32_t size);
         };  
 };
 
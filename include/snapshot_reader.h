@@ -0,0 +1,85 @@
+#ifndef         SNAPSHOT_READER_H_
+#define         SNAPSHOT_READER_H_
+
+#include <mv_action.h>
+#include <mv_table.h>
+#include <runnable.hh>
+#include <concurrent_queue.h>
+
+#define READER_WINDOW 16
+
+/* A reader's pinned snapshot epoch, 0 while it holds none. */
+struct ReaderPin {
+        volatile uint64_t epoch;
+} __attribute__((__aligned__(CACHE_LINE)));
+
+/*
+ * Epochs shared by the snapshot readers and executor 0, which advances them
+ * behind the low watermark (see Executor::AdvanceReaders). readEpoch is the
+ * snapshot readers pin, every epoch up to it has been executed. No reader is
+ * pinned to a snapshot older than safeEpoch, so garbage collection is held
+ * back to safeEpoch rather than the low watermark while readers exist. The
+ * checkpointer pins its epoch the same way, through the last of the
+ * numReaders pins (see Checkpointer).
+ */
+struct ReaderEpochs {
+        volatile uint64_t __attribute__((aligned(CACHE_LINE))) readEpoch;
+        volatile uint32_t __attribute__((aligned(CACHE_LINE))) safeEpoch;
+        uint32_t numReaders;
+        ReaderPin *pins;
+};
+
+struct SnapshotReaderConfig {
+        uint32_t threadId;
+        int cpu;
+        uint32_t numTables;
+        MVTablePartition **partitions;  // [vpart*numTables + table]
+        ReaderEpochs *epochs;
+        SimpleQueue<ActionBatch> *inputQueue;
+        SimpleQueue<ActionBatch> *outputQueue;
+};
+
+/*
+ * snapshot_lag sums, over every txn, the epochs between the snapshot its
+ * batch would have read in the executors (the epoch preceding the batch) and
+ * the snapshot it read; it is negative if readers ran behind. pins counts the
+ * times a reader moved to a newer snapshot.
+ */
+struct SnapshotReaderStats {
+        uint64_t txns;
+        uint64_t pins;
+        int64_t snapshot_lag;
+};
+
+/*
+ * Runs read-only txns outside the CC and execution stages. A reader resolves
+ * every key of a txn itself, by walking the version chain in the owning CC
+ * thread's partition back to the newest fully executed epoch, and runs the
+ * txn against that snapshot. Each reader gets its own batches, whose arenas it
+ * releases once it has run them.
+ */
+class SnapshotReader : public Runnable {
+ private:
+        SnapshotReaderConfig config;
+        uint64_t pinned;
+        SnapshotReaderStats stats;
+
+        uint64_t Pin();
+        void Unpin();
+        void Resolve(mv_action *action, uint64_t snapshot);
+        void RunBatch(const ActionBatch &batch);
+
+ protected:
+        virtual void StartWorking();
+        virtual void Init();
+
+ public:
+        void* operator new(std::size_t sz, int cpu) {
+                return alloc_mem(sz, cpu);
+        }
+
+        SnapshotReader(SnapshotReaderConfig config);
+        SnapshotReaderStats GetStats();
+};
+
+#endif          /* SNAPSHOT_READER_H_ */
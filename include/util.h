@@ -33,6 +33,28 @@ cmp_and_swap(volatile uint64_t *to_write,
   return out == to_cmp;
 }
 
+inline bool
+cmp_and_swap_byte(volatile uint8_t *to_write,
+                  uint8_t to_cmp,
+                  uint8_t new_value) {
+  volatile uint8_t out;
+  asm volatile("lock; cmpxchgb %2, %1"
+               : "=a" (out), "+m"(*to_write)
+               : "q" (new_value), "0"(to_cmp));
+  return out == to_cmp;
+}
+
+inline bool
+cmp_and_swap_int(volatile uint32_t *to_write,
+                 uint32_t to_cmp,
+                 uint32_t new_value) {
+  volatile uint32_t out;
+  asm volatile("lock; cmpxchgl %2, %1"
+               : "=a" (out), "+m"(*to_write)
+               : "q" (new_value), "0"(to_cmp));
+  return out == to_cmp;
+}
+
 inline uint64_t
 xchgq(volatile uint64_t *addr, uint64_t new_val)
 {
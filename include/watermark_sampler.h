@@ -0,0 +1,37 @@
+#ifndef         WATERMARK_SAMPLER_H_
+#define         WATERMARK_SAMPLER_H_
+
+#include <executor.h>
+#include <runnable.hh>
+
+struct WatermarkSamplerConfig {
+        int cpu;
+        EpochTree *epochs;
+        uint32_t intervalMs;
+};
+
+/*
+ * Reports how far garbage collection trails execution while a run is going:
+ * every intervalMs milliseconds, one line on stderr with the time since the
+ * sampler started, the newest epoch an executor has finished, the low
+ * watermark and the gap between the two. The executors' own lag counters
+ * (see WatermarkStats) only give the average and the maximum at the end of
+ * the run.
+ */
+class WatermarkSampler : public Runnable {
+ private:
+        WatermarkSamplerConfig config;
+
+ protected:
+        virtual void StartWorking();
+        virtual void Init();
+
+ public:
+        void* operator new(std::size_t sz, int cpu) {
+                return alloc_mem(sz, cpu);
+        }
+
+        WatermarkSampler(WatermarkSamplerConfig config);
+};
+
+#endif          /* WATERMARK_SAMPLER_H_ */
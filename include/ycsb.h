@@ -31,6 +31,10 @@ class ycsb_readonly : public txn {
         virtual bool Run();
         virtual uint32_t num_reads();
         virtual void get_reads(struct big_key *array);
+        virtual uint32_t log_proc();
+        virtual uint32_t log_size();
+        virtual void log_params(char *buf);
+        static txn* from_log(const char *params, uint32_t size);
 };
 
 class ycsb_rmw : public txn {
@@ -45,6 +49,89 @@ class ycsb_rmw : public txn {
         virtual uint32_t num_rmws();
         virtual void get_reads(struct big_key *array);
         virtual void get_rmws(struct big_key *array);
+        virtual uint32_t log_proc();
+        virtual uint32_t log_size();
+        virtual void log_params(char *buf);
+        static txn* from_log(const char *params, uint32_t size);
+};
+
+/* 
+ * Deletes some records and inserts others, and updates the rest like 
+ * ycsb_rmw. An update of a record that is currently deleted does nothing. 
+ */
+class ycsb_churn : public txn {
+ private:
+        vector<uint64_t> rmws;
+        vector<uint64_t> inserts;
+        vector<uint64_t> deletes;
+
+ public:
+        ycsb_churn(vector<uint64_t> rmws, vector<uint64_t> inserts, 
+                   vector<uint64_t> deletes);
+        virtual bool Run();
+        virtual uint32_t num_rmws();
+        virtual uint32_t num_writes();
+        virtual uint32_t num_deletes();
+        virtual void get_rmws(struct big_key *array);
+        virtual void get_writes(struct big_key *array);
+        virtual void get_deletes(struct big_key *array);
+        virtual uint32_t log_proc();
+        virtual uint32_t log_size();
+        virtual void log_params(char *buf);
+        static txn* from_log(const char *params, uint32_t size);
+};
+
+/* 
+ * Reads the first limit records at or after start, and sums their first 
+ * field. 
+ */
+class ycsb_scan : public txn {
+ private:
+        volatile uint64_t accumulated;
+        uint64_t start;
+        uint64_t end;
+        uint32_t limit;
+        vector<uint64_t> keys;
+        vector<void*> values;
+
+ public:
+        ycsb_scan(uint64_t start, uint64_t end, uint32_t limit);
+        virtual bool Run();
+        virtual uint32_t num_ranges();
+        virtual void get_ranges(struct big_range *array);
+        virtual uint32_t log_proc();
+        virtual uint32_t log_size();
+        virtual void log_params(char *buf);
+        static txn* from_log(const char *params, uint32_t size);
+};
+
+/* 
+ * Updates the records a few index records point to, which it only learns by 
+ * reading them (see txn::needs_recon). The first field of each lookup record 
+ * names a record, modulo the table size. The first lookup record is updated 
+ * as well, which moves its pointer on by one, so txns that followed it in 
+ * between restart. Other updates leave the first field alone.
+ */
+class ycsb_ollp : public txn {
+ private:
+        vector<uint64_t> lookups;
+        vector<uint64_t> rmws;          // Predicted, sorted
+        uint64_t num_records;
+        bool predicted;
+
+        void follow(vector<uint64_t> *OUT_RMWS);
+
+ public:
+        ycsb_ollp(vector<uint64_t> lookups, uint64_t num_records);
+        virtual bool Run();
+        virtual bool needs_recon();
+        virtual uint32_t num_recon_reads();
+        virtual void get_recon_reads(struct big_key *array);
+        virtual void recon();
+        virtual uint32_t num_reads();
+        virtual uint32_t num_rmws();
+        virtual void get_reads(struct big_key *array);
+        virtual void get_rmws(struct big_key *array);
 };
 
 #endif // YCSB_H_
@@ -0,0 +1,401 @@
+#include <checkpoint.h>
+#include <util.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <cstdio>
+#include <cstring>
+#include <sstream>
+#include <algorithm>
+
+Checkpointer::Checkpointer(CheckpointConfig cfg) : Runnable(cfg.cpu)
+{
+        std::stringstream msg;
+        msg << "Checkpointer " << cfg.threadId << " started on cpu " << cfg.cpu << "\n";
+        std::cout << msg.str();
+
+        this->config = cfg;
+        this->used = 0;
+        this->fd = -1;
+        this->lastEpoch = 0;
+        memset(&this->stats, 0x0, sizeof(CheckpointStats));
+        this->buffer = (char*)alloc_mem(CHECKPOINT_BUFFER, cfg.cpu);
+        assert(this->buffer != NULL);
+}
+
+void Checkpointer::Init()
+{
+}
+
+CheckpointStats Checkpointer::GetStats()
+{
+        return stats;
+}
+
+std::string Checkpointer::Path(const char *dir, uint32_t epoch, uint32_t file)
+{
+        std::stringstream path;
+        path << dir << "/checkpoint." << epoch << "." << file;
+        return path.str();
+}
+
+/*
+ * Pin the newest executed epoch once interval epochs have passed since the
+ * last checkpoint, the same way SnapshotReader::Pin does.
+ */
+uint32_t Checkpointer::Pin()
+{
+        ReaderPin *pin;
+        uint64_t snapshot;
+
+        pin = &config.epochs->pins[config.pinId];
+        do {
+                do {
+                        snapshot = config.epochs->readEpoch;
+                } while (snapshot == 0 ||
+                         snapshot < (uint64_t)lastEpoch + config.interval);
+                xchgq(&pin->epoch, snapshot);
+        } while (config.epochs->readEpoch != snapshot);
+        return (uint32_t)snapshot;
+}
+
+void Checkpointer::Unpin()
+{
+        barrier();
+        config.epochs->pins[config.pinId].epoch = 0;
+        barrier();
+}
+
+static void write_all(int fd, const char *data, uint64_t size)
+{
+        uint64_t written;
+        ssize_t ret;
+
+        for (written = 0; written < size; written += ret) {
+                ret = write(fd, &data[written], size - written);
+                if (ret < 0) {
+                        std::cerr << "Checkpoint write failed\n";
+                        exit(-1);
+                }
+        }
+}
+
+void Checkpointer::Flush()
+{
+        write_all(fd, buffer, used);
+        stats.bytes += used;
+        used = 0;
+}
+
+void Checkpointer::Append(uint64_t key, uint32_t table, const void *value,
+                          uint32_t size)
+{
+        CheckpointEntry entry;
+
+        assert(sizeof(CheckpointEntry) + size <= CHECKPOINT_BUFFER);
+        if (used + sizeof(CheckpointEntry) + size > CHECKPOINT_BUFFER)
+                Flush();
+        entry.key = key;
+        entry.table = table;
+        entry.size = size;
+        memcpy(&buffer[used], &entry, sizeof(CheckpointEntry));
+        memcpy(&buffer[used + sizeof(CheckpointEntry)], value, size);
+        used += sizeof(CheckpointEntry) + size;
+        stats.records += 1;
+}
+
+/*
+ * The newest version that is visible at the end of epoch. Versions up to the
+ * pinned epoch are executed, and none of them is collected before the pin is
+ * dropped, nor is any version written since.
+ */
+static MVRecord* visible_at(MVRecord *version, uint32_t epoch)
+{
+        while (version != NULL && (version->createTimestamp >> 32) > epoch)
+                version = version->epoch_ancestor;
+        return version;
+}
+
+/*
+ * Write the slice of every partition's index that belongs to this thread: an
+ * equal share of its positions, so each file covers every partition.
+ */
+void Checkpointer::WriteFile(uint32_t epoch)
+{
+        std::vector<MVRecord*> heads;
+        std::string path;
+        CheckpointFileHeader header;
+        MVTablePartition *partition;
+        MVRecord *version;
+        uint64_t size, start, end, slice, bytes, records, begin;
+        uint32_t i, j, table;
+
+        begin = rdtsc();
+        bytes = stats.bytes;
+        records = stats.records;
+        path = Path(config.dir, epoch, config.threadId);
+        fd = open(path.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (fd < 0) {
+                std::cerr << "Couldn't open checkpoint file " << path << "\n";
+                exit(-1);
+        }
+        memset(buffer, 0x0, sizeof(CheckpointFileHeader));
+        used = sizeof(CheckpointFileHeader);
+        for (i = 0; i < config.numPartitions*config.numTables; ++i) {
+                partition = config.partitions[i];
+                table = i % config.numTables;
+                size = partition->IndexSize();
+                start = size*config.threadId/config.numThreads;
+                end = size*(config.threadId + 1)/config.numThreads;
+                for (; start < end; start += slice) {
+                        slice = std::min((uint64_t)CHECKPOINT_SLICE,
+                                         end - start);
+                        heads.clear();
+                        partition->GetHeads(start, start + slice, &heads);
+                        for (j = 0; j < heads.size(); ++j) {
+                                version = visible_at(heads[j], epoch);
+                                if (version == NULL || version->tombstone)
+                                        continue;
+                                assert(version->value != NULL);
+                                Append(version->key, table, version->value,
+                                       (uint32_t)config.recordSizes[table]);
+                        }
+                }
+        }
+        Flush();
+
+        header.magic = CHECKPOINT_MAGIC;
+        header.epoch = epoch;
+        header.fileId = config.threadId;
+        header.pad = 0;
+        header.numEntries = stats.records - records;
+        header.size = stats.bytes - bytes;
+        if (pwrite(fd, &header, sizeof(CheckpointFileHeader), 0) !=
+            sizeof(CheckpointFileHeader) || fdatasync(fd) != 0) {
+                std::cerr << "Couldn't write checkpoint file " << path << "\n";
+                exit(-1);
+        }
+        close(fd);
+        fd = -1;
+        stats.write_cycles += rdtsc() - begin;
+}
+
+/* Replace the manifest atomically, see CheckpointManifest. */
+void Checkpointer::WriteManifest(uint32_t epoch)
+{
+        CheckpointManifest manifest;
+        std::string path, tmp;
+        int manifest_fd, dir_fd;
+
+        path = std::string(config.dir) + "/checkpoint.manifest";
+        tmp = path + ".tmp";
+        manifest.magic = CHECKPOINT_MAGIC;
+        manifest.epoch = epoch;
+        manifest.numFiles = config.numThreads;
+        manifest.pad = 0;
+        manifest_fd = open(tmp.c_str(), O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (manifest_fd < 0) {
+                std::cerr << "Couldn't open checkpoint manifest " << tmp << "\n";
+                exit(-1);
+        }
+        write_all(manifest_fd, (const char*)&manifest,
+                  sizeof(CheckpointManifest));
+        if (fdatasync(manifest_fd) != 0 ||
+            rename(tmp.c_str(), path.c_str()) != 0) {
+                std::cerr << "Couldn't install checkpoint manifest\n";
+                exit(-1);
+        }
+        close(manifest_fd);
+        dir_fd = open(config.dir, O_RDONLY);
+        if (dir_fd >= 0) {
+                fsync(dir_fd);
+                close(dir_fd);
+        }
+}
+
+void Checkpointer::RemoveFiles(uint32_t epoch)
+{
+        uint32_t i;
+
+        for (i = 0; i < config.numThreads; ++i)
+                unlink(Path(config.dir, epoch, i).c_str());
+}
+
+/*
+ * Thread 0 pins the epoch and starts the round, every thread writes its
+ * file, and thread 0 puts the manifest in place once all of them are
+ * durable. Only then is the pin dropped and the previous checkpoint removed.
+ */
+void Checkpointer::StartWorking()
+{
+        uint64_t round, begin;
+        uint32_t epoch;
+
+        round = 0;
+        begin = 0;
+        while (true) {
+                if (config.threadId == 0) {
+                        epoch = Pin();
+                        begin = rdtsc();
+                        config.round->epoch = epoch;
+                        barrier();
+                        config.round->round = round + 1;
+                        barrier();
+                } else {
+                        while (config.round->round == round)
+                                ;
+                }
+                round += 1;
+                epoch = config.round->epoch;
+                WriteFile(epoch);
+                fetch_and_increment(&config.round->finished);
+                if (config.threadId != 0)
+                        continue;
+
+                while (config.round->finished < round*config.numThreads)
+                        ;
+                WriteManifest(epoch);
+                Unpin();
+                if (lastEpoch != 0)
+                        RemoveFiles(lastEpoch);
+                lastEpoch = epoch;
+                stats.checkpoints += 1;
+                stats.epoch = epoch;
+                stats.cycles += rdtsc() - begin;
+        }
+}
+
+bool Checkpointer::ReadManifest(const char *dir,
+                                CheckpointManifest *OUT_MANIFEST)
+{
+        std::string path;
+        int manifest_fd;
+        ssize_t ret;
+
+        path = std::string(dir) + "/checkpoint.manifest";
+        manifest_fd = open(path.c_str(), O_RDONLY);
+        if (manifest_fd < 0)
+                return false;
+        ret = read(manifest_fd, OUT_MANIFEST, sizeof(CheckpointManifest));
+        close(manifest_fd);
+        return ret == sizeof(CheckpointManifest) &&
+                OUT_MANIFEST->magic == CHECKPOINT_MAGIC;
+}
+
+void Checkpointer::RemoveManifest(const char *dir)
+{
+        unlink((std::string(dir) + "/checkpoint.manifest").c_str());
+}
+
+CheckpointLoad::CheckpointLoad(const std::vector<const CheckpointEntry*> &entries)
+{
+        this->entries = entries;
+}
+
+bool CheckpointLoad::Run()
+{
+        const CheckpointEntry *entry;
+        uint32_t i;
+        void *record_ptr;
+
+        for (i = 0; i < entries.size(); ++i) {
+                entry = entries[i];
+                record_ptr = get_write_at(i, entry->key, entry->table);
+                memcpy(record_ptr, &entry[1], entry->size);
+        }
+        return true;
+}
+
+uint32_t CheckpointLoad::num_writes()
+{
+        return entries.size();
+}
+
+void CheckpointLoad::get_writes(struct big_key *array)
+{
+        uint32_t i;
+
+        for (i = 0; i < entries.size(); ++i) {
+                array[i].key = entries[i]->key;
+                array[i].table_id = entries[i]->table;
+        }
+}
+
+CheckpointReader::CheckpointReader(CheckpointReaderConfig cfg)
+        : Runnable(cfg.cpu)
+{
+        this->config = cfg;
+        this->bytes = 0;
+        this->done = 0;
+}
+
+void CheckpointReader::Init()
+{
+}
+
+void CheckpointReader::StartWorking()
+{
+        std::vector<const CheckpointEntry*> entries;
+        CheckpointFileHeader header;
+        const CheckpointEntry *entry;
+        std::string path;
+        struct stat st;
+        uint64_t offset, i;
+        char *data;
+        ssize_t ret;
+        int file_fd;
+
+        path = Checkpointer::Path(config.dir, config.epoch, config.fileId);
+        file_fd = open(path.c_str(), O_RDONLY);
+        if (file_fd < 0 || fstat(file_fd, &st) != 0) {
+                std::cerr << "Couldn't open checkpoint file " << path << "\n";
+                exit(-1);
+        }
+        data = (char*)alloc_mem(st.st_size + 1, config.cpu);
+        assert(data != NULL);
+        for (offset = 0; offset < (uint64_t)st.st_size; offset += ret) {
+                ret = read(file_fd, &data[offset], st.st_size - offset);
+                assert(ret > 0);
+        }
+        close(file_fd);
+        bytes = st.st_size;
+
+        memcpy(&header, data, sizeof(CheckpointFileHeader));
+        if (header.magic != CHECKPOINT_MAGIC || header.epoch != config.epoch ||
+            header.fileId != config.fileId || header.size != bytes) {
+                std::cerr << "Bad checkpoint file " << path << "\n";
+                exit(-1);
+        }
+        offset = sizeof(CheckpointFileHeader);
+        for (i = 0; i < header.numEntries; ++i) {
+                entry = (const CheckpointEntry*)&data[offset];
+                offset += sizeof(CheckpointEntry) + entry->size;
+                assert(offset <= bytes);
+                entries.push_back(entry);
+                if (entries.size() == CHECKPOINT_LOAD_KEYS) {
+                        loads.push_back(new CheckpointLoad(entries));
+                        entries.clear();
+                }
+        }
+        if (entries.size() > 0)
+                loads.push_back(new CheckpointLoad(entries));
+        barrier();
+        done = 1;
+        barrier();
+}
+
+void CheckpointReader::WaitDone()
+{
+        while (done == 0)
+                ;
+}
+
+const std::vector<txn*>& CheckpointReader::GetLoads()
+{
+        return loads;
+}
+
+uint64_t CheckpointReader::Bytes()
+{
+        return bytes;
+}
@@ -0,0 +1,185 @@
+#include <command_log.h>
+#include <util.h>
+#include <city.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/stat.h>
+#include <cstring>
+#include <sstream>
+
+CommandLog::CommandLog(CommandLogConfig cfg) : Runnable(cfg.cpu)
+{
+        std::stringstream msg;
+        msg << "Command log started on cpu " << cfg.cpu << "\n";
+        std::cout << msg.str();
+
+        this->config = cfg;
+        this->durableEpoch = 0;
+        memset(&this->stats, 0x0, sizeof(CommandLogStats));
+        this->fd = open(cfg.path, O_WRONLY | O_CREAT | O_TRUNC, 0644);
+        if (this->fd < 0) {
+                std::cerr << "Couldn't open command log " << cfg.path << "\n";
+                exit(-1);
+        }
+}
+
+void CommandLog::Init()
+{
+}
+
+CommandLogStats CommandLog::GetStats()
+{
+        return stats;
+}
+
+/*
+ * Lay the txns of batch out after an epoch header, in timestamp order, and
+ * hand the epoch to the log thread.
+ */
+void CommandLog::Append(uint32_t epoch, const ActionBatch &batch)
+{
+        CommandLogRecord record;
+        CommandLogHeader header;
+        CommandLogTxn entry;
+        uint64_t size, offset;
+        uint32_t i;
+        txn *t;
+
+        size = sizeof(CommandLogHeader);
+        for (i = 0; i < batch.numActions; ++i)
+                size += sizeof(CommandLogTxn) +
+                        batch.actionBuf[i]->t->log_size();
+        record.epoch = epoch;
+        record.size = size;
+        record.data = (char*)malloc(size);
+        assert(record.data != NULL);
+
+        offset = sizeof(CommandLogHeader);
+        for (i = 0; i < batch.numActions; ++i) {
+                t = batch.actionBuf[i]->t;
+                entry.proc = t->log_proc();
+                entry.size = t->log_size();
+                assert(entry.proc != PROC_NONE);
+                memcpy(&record.data[offset], &entry, sizeof(CommandLogTxn));
+                offset += sizeof(CommandLogTxn);
+                t->log_params(&record.data[offset]);
+                offset += entry.size;
+        }
+        assert(offset == size);
+        header.magic = COMMAND_LOG_MAGIC;
+        header.epoch = epoch;
+        header.numTxns = batch.numActions;
+        header.size = (uint32_t)size;
+        header.checksum =
+                CityHash64(&record.data[sizeof(CommandLogHeader)],
+                           size - sizeof(CommandLogHeader));
+        memcpy(record.data, &header, sizeof(CommandLogHeader));
+        stats.txns += batch.numActions;
+        config.inputQueue->EnqueueBlocking(record);
+}
+
+void CommandLog::Write(const CommandLogRecord &record)
+{
+        uint64_t written;
+        ssize_t ret;
+
+        for (written = 0; written < record.size; written += ret) {
+                ret = write(fd, &record.data[written], record.size - written);
+                if (ret < 0) {
+                        std::cerr << "Command log write failed\n";
+                        exit(-1);
+                }
+        }
+        stats.bytes += record.size;
+        stats.epochs += 1;
+        free(record.data);
+}
+
+/*
+ * Group commit: every epoch appended while the last fdatasync was in flight
+ * is written out and made durable by the next one.
+ */
+void CommandLog::StartWorking()
+{
+        CommandLogRecord record;
+        uint32_t last;
+        uint64_t start;
+
+        last = 1;
+        while (true) {
+                record = config.inputQueue->DequeueBlocking();
+                do {
+                        assert(record.epoch == last + 1);
+                        last = record.epoch;
+                        Write(record);
+                } while (config.inputQueue->Dequeue(&record));
+                start = rdtsc();
+                if (fdatasync(fd) != 0) {
+                        std::cerr << "Command log fdatasync failed\n";
+                        exit(-1);
+                }
+                stats.sync_cycles += rdtsc() - start;
+                stats.syncs += 1;
+                barrier();
+                durableEpoch = last;
+                barrier();
+        }
+}
+
+void CommandLog::WaitDurable(uint32_t epoch)
+{
+        uint64_t start;
+
+        if (durableEpoch >= epoch)
+                return;
+        start = rdtsc();
+        while (durableEpoch < epoch)
+                ;
+        stats.release_waits += 1;
+        stats.release_wait_cycles += rdtsc() - start;
+}
+
+std::vector<CommandLogRecord> CommandLog::Read(const char *path)
+{
+        std::vector<CommandLogRecord> epochs;
+        CommandLogRecord record;
+        CommandLogHeader header;
+        struct stat st;
+        uint64_t offset;
+        char *data;
+        ssize_t ret;
+        int log_fd;
+
+        log_fd = open(path, O_RDONLY);
+        if (log_fd < 0 || fstat(log_fd, &st) != 0) {
+                std::cerr << "Couldn't open command log " << path << "\n";
+                exit(-1);
+        }
+        data = (char*)malloc(st.st_size + 1);
+        assert(data != NULL);
+        for (offset = 0; offset < (uint64_t)st.st_size; offset += ret) {
+                ret = read(log_fd, &data[offset], st.st_size - offset);
+                assert(ret > 0);
+        }
+        close(log_fd);
+
+        /* The load is epoch 1, logged epochs start right after it. */
+        offset = 0;
+        while (offset + sizeof(CommandLogHeader) <= (uint64_t)st.st_size) {
+                memcpy(&header, &data[offset], sizeof(CommandLogHeader));
+                if (header.magic != COMMAND_LOG_MAGIC ||
+                    header.epoch != epochs.size() + 2 ||
+                    header.size < sizeof(CommandLogHeader) ||
+                    offset + header.size > (uint64_t)st.st_size ||
+                    header.checksum !=
+                    CityHash64(&data[offset + sizeof(CommandLogHeader)],
+                               header.size - sizeof(CommandLogHeader)))
+                        break;
+                record.epoch = header.epoch;
+                record.size = header.size;
+                record.data = &data[offset];
+                epochs.push_back(record);
+                offset += header.size;
+        }
+        return epochs;
+}
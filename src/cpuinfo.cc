@@ -205,3 +205,23 @@ void* alloc_interleaved_all(size_t size) {
 
   return buf;
 }
+
+void* alloc_on_node(size_t size, int node) {
+  if (TESTING) {
+    return malloc(size);
+  }
+  numa_set_strict(1);
+  return numa_alloc_onnode(size, node);
+}
+
+/*
+ * NUMA node of the page holding each address, -1 where it is unknown (e.g. the
+ * page has not been touched yet).
+ */
+void get_mem_nodes(void **addrs, uint64_t count, int *OUT_NODES) {
+  if (numa_move_pages(0, count, addrs, NULL, OUT_NODES, 0) != 0) {
+    for (uint64_t i = 0; i < count; ++i) {
+      OUT_NODES[i] = -1;
+    }
+  }
+}
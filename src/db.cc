@@ -1,14 +1,42 @@
 #include <db.h>
 #include <cassert>
 
+void* translator::read_at(__attribute__((unused)) uint32_t index,
+                          uint64_t key, uint32_t table)
+{
+        return read(key, table);
+}
+
+void* translator::write_ref_at(__attribute__((unused)) uint32_t index,
+                               uint64_t key, uint32_t table)
+{
+        return write_ref(key, table);
+}
+
+uint32_t translator::range_at(__attribute__((unused)) uint32_t index,
+                              __attribute__((unused)) uint64_t *OUT_KEYS,
+                              __attribute__((unused)) void **OUT_VALUES)
+{
+        assert(false);
+        return 0;
+}
+
+void translator::abort()
+{
+}
+
 txn::txn()
 {
         this->trans = NULL;
 }
 
+txn::~txn()
+{
+}
+
+/* A restarted txn gets a new translator for each incarnation. */
 void txn::set_translator(translator *trans)
 {
-        assert(this->trans == NULL);
         this->trans = trans;
 }
 
@@ -22,6 +50,22 @@ void* txn::get_read_ref(uint64_t key, uint32_t table_id)
         return trans->read(key, table_id);
 }
 
+void* txn::get_read_at(uint32_t index, uint64_t key, uint32_t table_id)
+{
+        return trans->read_at(index, key, table_id);
+}
+
+void* txn::get_write_at(uint32_t index, uint64_t key, uint32_t table_id)
+{
+        return trans->write_ref_at(index, key, table_id);
+}
+
+uint32_t txn::get_range_at(uint32_t index, uint64_t *OUT_KEYS, 
+                          void **OUT_VALUES)
+{
+        return trans->range_at(index, OUT_KEYS, OUT_VALUES);
+}
+
 uint32_t txn::num_reads()
 {
         return 0;
@@ -37,6 +81,31 @@ uint32_t txn::num_rmws()
         return 0;
 }
 
+uint32_t txn::num_incrs()
+{
+        return 0;
+}
+
+uint32_t txn::num_ranges()
+{
+        return 0;
+}
+
+void txn::get_ranges(__attribute__((unused)) struct big_range *array)
+{
+        return;
+}
+
+uint32_t txn::num_deletes()
+{
+        return 0;
+}
+
+void txn::get_deletes(__attribute__((unused)) struct big_key *array)
+{
+        return;
+}
+
 void txn::get_reads(__attribute__((unused)) struct big_key *array)
 {
         return;
@@ -52,8 +121,49 @@ void txn::get_rmws(__attribute__((unused)) struct big_key *array)
         return;
 }
 
+bool txn::needs_recon()
+{
+        return false;
+}
+
+uint32_t txn::num_recon_reads()
+{
+        return 0;
+}
+
+void txn::get_recon_reads(__attribute__((unused)) struct big_key *array)
+{
+        return;
+}
+
+void txn::recon()
+{
+        assert(false);
+}
+
+uint32_t txn::log_proc()
+{
+        return PROC_NONE;
+}
+
+uint32_t txn::log_size()
+{
+        return 0;
+}
+
+void txn::log_params(__attribute__((unused)) char *buf)
+{
+        return;
+}
+
 int txn::txn_rand()
 {
         return trans->rand();
 }
 
+/* Logic abort, see txn. Use as return abort(); in Run(). */
+bool txn::abort()
+{
+        trans->abort();
+        return false;
+}
@@ -2,7 +2,8 @@
 #include <sstream>
 #include <algorithm>
 
-extern uint32_t GLOBAL_RECORD_SIZE;
+#define EXEC_DEQUE_SIZE 1024
+#define EXEC_ARENA_RING 256
 
 PendingActionList::PendingActionList(uint32_t freeListSize) 
 {
@@ -116,68 +117,503 @@ Executor::Executor(ExecutorConfig cfg) : Runnable (cfg.cpu)
 
         this->config = cfg;
         this->counter = 0;
+        this->readyQueue = 0;
+        this->numWaiting = 0;
+        memset(&this->stats, 0x0, sizeof(ExecutorStats));
+        this->epoch = 0;
+        this->victim = config.threadId;
+        this->slices = NULL;
+        if (config.sliceSize > 0)
+                this->slices = new (config.cpu) 
+                        WorkStealingDeque<ExecSlice>(EXEC_DEQUE_SIZE, config.cpu);
+        this->retiredArenas = NULL;
+        this->retiredHead = 0;
+        this->retiredTail = 0;
+        if (config.threadId == 0) 
+                this->retiredArenas = (RetiredArena*)
+                        alloc_mem(sizeof(RetiredArena)*EXEC_ARENA_RING, 
+                                  config.cpu);
+        this->deferred = NULL;
+        this->deferredHead = 0;
+        this->numDeferred = 0;
+        this->forcing = false;
+        if (config.lazyDepth > 0)
+                this->deferred = (ActionBatch*)
+                        alloc_mem(sizeof(ActionBatch)*config.lazyDepth, 
+                                  config.cpu);
         this->pendingList = new (config.cpu) PendingActionList(1000);
         this->garbageBin = new (config.cpu) GarbageBin(config.garbageConfig);
+        this->node = numa_available() < 0? 0 : numa_node_of_cpu(config.cpu);
+        SetupAllocators();
+}
+
+/*
+ * Under PAYLOAD_CC, a node's pool starts out with the share of each table's 
+ * payloads that belongs to the CC threads on the node.
+ */
+void Executor::SetupAllocators()
+{
+        uint32_t i, j, num_cc, pool, pool_cc[MAX_NUMA_NODES];
+        RecordAllocator *alloc;
+        uint64_t size;
+        int alloc_node;
+
+        num_cc = config.garbageConfig.numCCThreads;
+        numPools = 1;
+        memset(pool_cc, 0x0, sizeof(pool_cc));
+        if (config.placement == PAYLOAD_CC) {
+                for (i = 0; i < num_cc; ++i) {
+                        assert(config.ccNodes[i] < MAX_NUMA_NODES);
+                        if ((uint32_t)config.ccNodes[i] + 1 > numPools)
+                                numPools = config.ccNodes[i] + 1;
+                        pool_cc[config.ccNodes[i]] += 1;
+                }
+        } else {
+                pool_cc[0] = num_cc;
+        }
+        this->allocators = (RecordAllocator**)
+                alloc_mem(sizeof(RecordAllocator*)*numPools*config.numTables,
+                          config.cpu);
+        assert(this->allocators != NULL);
+        for (pool = 0; pool < numPools; ++pool) {
+                if (config.placement == PAYLOAD_CC)
+                        alloc_node = pool;
+                else if (config.placement == PAYLOAD_INTERLEAVED)
+                        alloc_node = -1;
+                else
+                        alloc_node = node;
+                for (j = 0; j < config.numTables; ++j) {
+                        alloc = NULL;
+                        size = config.allocatorSizes[j]*pool_cc[pool]/num_cc;
+                        if (pool_cc[pool] > 0)
+                                alloc = new (config.cpu) 
+                                        RecordAllocator(config.recordSizes[j],
+                                                        size, alloc_node,
+                                                        config.threadId, j,
+                                                        pool);
+                        allocators[pool*config.numTables + j] = alloc;
+                }
+        }
 }
 
 void Executor::Init() 
 {
 }
 
-/* Adjusts the low watermark of completed epoch#s across execution threads */
-void Executor::adjust_lowwatermark()
+/* Raise an epoch slot to epoch, unless it is already there. */
+static bool raise_epoch(volatile uint64_t *slot, uint64_t epoch)
+{
+        uint64_t cur;
+
+        while ((cur = *slot) < epoch)
+                if (cmp_and_swap(slot, cur, epoch))
+                        return true;
+        return false;
+}
+
+static bool raise_watermark(volatile uint32_t *watermark, uint32_t epoch)
 {
+        uint32_t cur;
+
+        while ((cur = *watermark) < epoch)
+                if (cmp_and_swap_int(watermark, cur, epoch))
+                        return true;
+        return false;
+}
+
+/* 
+ * Publish epoch as finished by this executor and carry it up the EpochTree. 
+ * Every write to the tree is a locked instruction, so of two executors that 
+ * finish concurrently, at least one reads the other's slot after it was 
+ * written, and no epoch is left behind without an executor to advance it.
+ */
+void Executor::PublishEpoch(uint32_t epoch)
+{
+        EpochTree *tree;
+        uint64_t lag;
+
+        tree = config.epochs;
+        xchgq(&tree->executors[config.threadId].epoch, epoch);
+        raise_epoch(&tree->currentEpoch, epoch);
+        if (AdvanceWatermark())
+                stats.wm.advances += 1;
+        barrier();
+        lag = tree->currentEpoch - tree->lowWatermark;
+        barrier();
+        stats.wm.lag_sum += lag;
+        if (lag > stats.wm.lag_max)
+                stats.wm.lag_max = lag;
+}
+
+/* 
+ * Raise this executor's group slot to its members' oldest epoch, then the low 
+ * watermark to the groups' oldest. A group at the watermark is the one holding 
+ * it back, so its members don't look at the other groups.
+ */
+bool Executor::AdvanceWatermark()
+{
+        EpochTree *tree;
+        uint64_t min_epoch, temp;
+        uint32_t group, i;
+
+        tree = config.epochs;
+        group = tree->groupOf[config.threadId];
+        min_epoch = ~(uint64_t)0;
+        for (i = tree->groupStart[group]; i < tree->groupStart[group + 1]; 
+             ++i) {
+                temp = tree->executors[tree->members[i]].epoch;
+                if (temp < min_epoch)
+                        min_epoch = temp;
+        }
+        raise_epoch(&tree->groups[group].epoch, min_epoch);
+        barrier();
+        if (tree->groups[group].epoch <= tree->lowWatermark)
+                return false;
+        barrier();
+
+        min_epoch = ~(uint64_t)0;
+        for (i = 0; i < tree->numGroups; ++i) {
+                temp = tree->groups[i].epoch;
+                if (temp < min_epoch)
+                        min_epoch = temp;
+        }
+        return raise_watermark(&tree->lowWatermark, (uint32_t)min_epoch);
+}
+
+/* 
+ * Executor 0 keeps the snapshot readers and the arenas of processed batches 
+ * moving behind the low watermark, whoever advanced it.
+ */
+void Executor::FollowWatermark()
+{
+        uint32_t low_watermark;
+
         assert(config.threadId == 0);
-        
-        volatile uint32_t min_epoch;
-        uint32_t i, temp;
+        barrier();
+        low_watermark = *config.lowWaterMarkPtr;
+        barrier();
+        if (config.readers != NULL)
+                AdvanceReaders(low_watermark);
+        ReclaimArenas(low_watermark);
+}
 
-        min_epoch = *config.epochPtr;
-        for (i = 0; i < config.numExecutors; ++i) {
+/*
+ * Move the snapshot readers along behind the low watermark. safeEpoch is 
+ * raised to readEpoch only once no reader is pinned to an older snapshot. A 
+ * reader pinning concurrently publishes its pin before re-checking readEpoch, 
+ * and readEpoch is published with a full barrier before the pins are next 
+ * scanned, so the reader is either seen here or pins a snapshot at least as 
+ * new as the one scanned against (see SnapshotReader::Pin).
+ */
+void Executor::AdvanceReaders(uint32_t low_watermark)
+{
+        ReaderEpochs *readers;
+        uint64_t read_epoch, pin;
+        uint32_t i;
+
+        assert(config.threadId == 0);
+        readers = config.readers;
+        read_epoch = readers->readEpoch;
+        for (i = 0; i < readers->numReaders; ++i) {
                 barrier();
-                temp = config.epochPtr[i];
+                pin = readers->pins[i].epoch;
                 barrier();
-                
-                if (temp < min_epoch) {
-                        min_epoch = temp;
-                }                
-        }        
-        
+                if (pin != 0 && pin < read_epoch)
+                        return;
+        }
         barrier();
-        *config.lowWaterMarkPtr = min_epoch;
+        readers->safeEpoch = (uint32_t)read_epoch;
         barrier();
+        if (low_watermark > read_epoch)
+                xchgq(&readers->readEpoch, low_watermark);
+}
+
+void Executor::RetireArena(ActionArena *arena)
+{
+        RetiredArena *retired;
+
+        assert(config.threadId == 0);
+        assert(retiredTail - retiredHead < EXEC_ARENA_RING);
+        retired = &retiredArenas[retiredTail % EXEC_ARENA_RING];
+        retired->arena = arena;
+        retired->epoch = epoch;
+        retired->releaseEpoch = 0;
+        retiredTail += 1;
+}
+
+/* 
+ * Release the arenas of epochs that are safely behind every executor. Passing 
+ * the low watermark isn't enough: an executor that read an older low 
+ * watermark may still dereference the epoch's actions (see get_writer), but 
+ * only until it finishes the epoch it is in. So an arena is released once the 
+ * low watermark also passes every epoch in progress when it became eligible.
+ */
+void Executor::ReclaimArenas(uint32_t low_watermark)
+{
+        uint32_t i, max_epoch;
+        RetiredArena *retired;
+
+        assert(config.threadId == 0);
+        for (i = retiredHead; i != retiredTail; ++i) {
+                retired = &retiredArenas[i % EXEC_ARENA_RING];
+                if (retired->epoch > low_watermark)
+                        break;
+                if (retired->releaseEpoch != 0)
+                        continue;
+                barrier();
+                max_epoch = (uint32_t)config.epochs->currentEpoch;
+                barrier();
+                retired->releaseEpoch = max_epoch + 1;
+        }
+
+        while (retiredHead != retiredTail) {
+                retired = &retiredArenas[retiredHead % EXEC_ARENA_RING];
+                if (retired->releaseEpoch == 0 || 
+                    retired->releaseEpoch > low_watermark)
+                        break;
+                retired->arena->Release();
+                retiredHead += 1;
+        }
+}
+
+/* 
+ * The txn that wrote version, or NULL if it is known to have been executed. 
+ * Versions of epochs at or below the low watermark are, and their batch's 
+ * arena may already be gone, so the writer must not be dereferenced.
+ */
+inline mv_action* Executor::get_writer(MVRecord *version, 
+                                       uint32_t low_watermark)
+{
+        if ((version->createTimestamp >> 32) <= low_watermark)
+                return NULL;
+        return version->writer;
+}
+
+/* 
+ * The txn a read of version still waits for, or NULL once the version's value 
+ * can be read. Its writer must have been executed and, while it is an 
+ * unfolded delta, so must the writers of the versions it applies to (see 
+ * Fold). Writers that haven't been are executed right away if possible, as in 
+ * check_ready. Deltas at or below the low watermark have all been folded.
+ */
+mv_action* Executor::unwritten(MVRecord *version, uint32_t low_watermark)
+{
+        mv_action *depend_action;
+
+        for (; version != NULL; version = version->recordLink) {
+                depend_action = get_writer(version, low_watermark);
+                if (depend_action == NULL)
+                        return NULL;
+                if (depend_action->__state != SUBSTANTIATED &&
+                    !ProcessSingle(depend_action))
+                        return depend_action;
+                if (version->deltaState == DELTA_NONE)
+                        return NULL;
+        }
+        return NULL;
+}
+
+/*
+ * Turn a delta into a value by adding the value of the version it applies to, 
+ * word by word, folding that one first if it is a delta too. The chain is 
+ * folded oldest first, one version at a time; a version another executor is 
+ * folding is waited for, which never takes long. unwritten must have found 
+ * the version readable. Returns the number of deltas folded here.
+ */
+uint32_t Executor::Fold(MVRecord *version, uint32_t table)
+{
+        uint64_t *value, *prev;
+        uint32_t i, j, num_words, folded;
+
+        assert(config.recordSizes[table] % sizeof(uint64_t) == 0);
+        num_words = config.recordSizes[table] / sizeof(uint64_t);
+        foldChain.clear();
+        for (; version->deltaState != DELTA_NONE; 
+             version = version->recordLink)
+                foldChain.push_back(version);
+        folded = 0;
+        for (i = foldChain.size(); i > 0; --i) {
+                version = foldChain[i-1];
+                if (!cmp_and_swap_byte(&version->deltaState, DELTA_PENDING, 
+                                       DELTA_FOLDING)) {
+                        while (version->deltaState != DELTA_NONE)
+                                ;
+                        continue;
+                }
+                value = (uint64_t*)version->value;
+                prev = (uint64_t*)version->recordLink->value;
+                for (j = 0; j < num_words; ++j)
+                        value[j] += prev[j];
+                barrier();
+                version->deltaState = DELTA_NONE;
+                barrier();
+                folded += 1;
+        }
+        if (folded > stats.deltas.fold_chain_max)
+                stats.deltas.fold_chain_max = folded;
+        return folded;
+}
+
+/* Fold a version a txn is about to read, if it is a delta. */
+inline void Executor::FoldRead(MVRecord *version, uint32_t table)
+{
+        if (version->deltaState != DELTA_NONE)
+                stats.deltas.read_folds += Fold(version, table);
+}
+
+/* 
+ * Fold the deltas written by this executor's share of the batch, the txns it 
+ * runs unless they are stolen, that no reader has folded yet, and give up the 
+ * versions they applied to. Every delta is thus folded before its epoch is 
+ * published, and its predecessor collected along with the epoch's other 
+ * garbage, as an RMW's would be.
+ */
+void Executor::FoldDeltas(const ActionBatch &batch)
+{
+        mv_action *action;
+        CompositeKey *write;
+        uint32_t i, j, num_writes, low_watermark;
+
+        for (i = config.threadId; i < batch.numActions; 
+             i += config.numExecutors) {
+                action = batch.actionBuf[i];
+                if (action->__numIncrs == 0)
+                        continue;
+                num_writes = action->__writeset.size();
+                for (j = 0; j < num_writes; ++j) {
+                        write = &action->__writeset[j];
+                        if (!write->is_incr || write->value->tombstone)
+                                continue;
+                        do {
+                                barrier();
+                                low_watermark = *config.lowWaterMarkPtr;
+                                barrier();
+                        } while (unwritten(write->value, low_watermark) != 
+                                 NULL);
+                        Fold(write->value, write->tableId);
+                        garbageBin->AddMVRecord(write->threadId, 
+                                                write->value->recordLink);
+                }
+        }
 }
 
 void Executor::StartWorking() 
 {
-        uint32_t epoch = 1;
         ActionBatch batch;
 
+        epoch = 1;
         while (true) {
 
-                if (config.threadId == 0) {
-                        while (!config.inputQueue->Dequeue(&batch)) {
-                                adjust_lowwatermark();
+                /* 
+                 * Keep releasing garbage while waiting for input: with bounded 
+                 * version allocators, the CC threads may be waiting for it 
+                 * before they can hand over the next batch.
+                 */
+                while (!config.inputQueue->Dequeue(&batch)) {
+                        if (numDeferred > 0) {
+                                stats.lazy.idle_drains += 1;
+                                Drain();
+                                continue;
                         }
-                        ProcessBatch(batch);
-                } else {
-                        batch = config.inputQueue->DequeueBlocking();
-                        ProcessBatch(batch);    
+                        if (config.threadId == 0)
+                                FollowWatermark();
+                        if (epoch > 1) 
+                                garbageBin->FinishEpoch(epoch - 1);
+                        RecycleData();
                 }
 
-                barrier();
-                *config.epochPtr = epoch;
-                barrier();
-    
-                // If this is the leader thread, try to advance the low-water mark to 
-                // trigger garbage collection
-                if (config.threadId == 0) 
-                        adjust_lowwatermark();
+                /* The load always runs right away. */
+                if (config.lazyDepth > 0 && epoch + numDeferred > 1) {
+                        Defer(batch);
+                        continue;
+                }
+                ProcessBatch(batch);
+                ActionBatch dummy = {NULL, 0, NULL, NULL, NULL, NULL, NULL};
+                config.outputQueue->EnqueueBlocking(dummy);  
+                FinishBatch(batch);
+        }
+}
+
+/* Publish a batch as executed, and release what it no longer needs. */
+void Executor::FinishBatch(const ActionBatch &batch)
+{
+        if (config.threadId == 0 && batch.arena != NULL)
+                RetireArena(batch.arena);
+
+        PublishEpoch(epoch);
+        if (config.threadId == 0) 
+                FollowWatermark();
+
+        /* 
+         * Try to return records that are no longer visible to their owners. 
+         * Txns of deferred batches may already have been forced, so the 
+         * pending garbage belongs to the newest batch received.
+         */
+        garbageBin->FinishEpoch(epoch + numDeferred);
+        RecycleData();
+        if (epoch == 1)
+                memset(&stats, 0x0, sizeof(ExecutorStats));
+        epoch += 1;
+}
+
+/* 
+ * Lazy mode: acknowledge a batch without executing it. Only its read-only 
+ * txns in this executor's share are evaluated now, which forces the deferred 
+ * txns they read from (see run_readonly), and through check_ready the ones 
+ * those depend on. The rest waits in the ring until the executor runs out of 
+ * input, or the ring is full.
+ */
+void Executor::Defer(const ActionBatch &batch)
+{
+        if (numDeferred == config.lazyDepth) {
+                stats.lazy.full_drains += 1;
+                Drain();
+        }
+        ForceReads(batch);
+        ActionBatch dummy = {NULL, 0, NULL, NULL, NULL, NULL, NULL};
+        config.outputQueue->EnqueueBlocking(dummy);  
+        deferred[(deferredHead + numDeferred) % config.lazyDepth] = batch;
+        numDeferred += 1;
+        stats.lazy.deferred += 1;
+        stats.lazy.deferred_sum += numDeferred;
+        if (numDeferred > stats.lazy.deferred_max)
+                stats.lazy.deferred_max = numDeferred;
+}
+
+/* 
+ * Evaluate the read-only txns of a batch. Their dependencies are never 
+ * parked on, so a txn that is held by another executor is simply retried.
+ */
+void Executor::ForceReads(const ActionBatch &batch)
+{
+        mv_action *action;
+        uint32_t i;
 
-                // Try to return records that are no longer visible to their owners
-                garbageBin->FinishEpoch(epoch);
-                epoch += 1;
+        forcing = true;
+        for (i = config.threadId; i < batch.numActions; 
+             i += config.numExecutors) {
+                action = batch.actionBuf[i];
+                if (!action->__readonly)
+                        continue;
+                action->home = this;
+                while (!ProcessSingle(action))
+                        ;
+                stats.lazy.reads += 1;
         }
+        forcing = false;
+}
+
+/* Execute the oldest deferred batch, see Defer. */
+void Executor::Drain()
+{
+        ActionBatch batch;
+
+        assert(numDeferred > 0);
+        batch = deferred[deferredHead];
+        deferredHead = (deferredHead + 1) % config.lazyDepth;
+        numDeferred -= 1;
+        ProcessBatch(batch);
+        FinishBatch(batch);
 }
 
 // Check if other worker threads have returned data to be recycled.
@@ -192,102 +628,321 @@ void Executor::RecycleData()
                         // Use non-blocking dequeue
                         while (config.recycleQueues[i*numQueues+j].Dequeue(&recycled)) {
                                 //        std::cout << "Received " << recycled.count << " records\n";
-                                allocators[i]->Recycle(recycled);
+                                if (numPools == 1)
+                                        allocators[i]->Recycle(recycled);
+                                else
+                                        RecyclePools(recycled);
                         }
                 }
         }
 }
 
+/* A list of recycled payloads of one table may span pools, sort them out. */
+void Executor::RecyclePools(RecordList recycled)
+{
+        Record *cur, *next;
+
+        for (cur = recycled.head; cur != NULL; cur = next) {
+                next = cur->next;
+                allocators[cur->pool*config.numTables + cur->tableId]->FreeSingle(cur);
+        }
+}
+
+/* 
+ * Retry txns whose execution was held up by another executor. Each is taken 
+ * off the list once per call, ScheduleOwn puts it back if it's still held. 
+ */
 void Executor::ExecPending() 
 {
-        pendingList->ResetCursor();
-        for (ActionListNode *node = pendingList->GetNext(); node != NULL; 
-             node = pendingList->GetNext()) {
-                if (ProcessSingle(node->action)) {
-                        pendingList->DequeuePending(node);
-                }
+        ActionListNode *node;
+        mv_action *action;
+        uint32_t i, num_pending;
+
+        num_pending = pendingList->Size();
+        for (i = 0; i < num_pending; ++i) {
+                pendingList->ResetCursor();
+                node = pendingList->GetNext();
+                assert(node != NULL);
+                action = node->action;
+                pendingList->DequeuePending(node);
+                if (ScheduleOwn(action))
+                        numWaiting -= 1;
         }
 }
 
-/* Process a single batch of transactions. */
-void Executor::ProcessBatch(const ActionBatch &batch) 
+/* 
+ * Retry txns handed back by their predecessors on completion. Returns false if 
+ * there were none.
+ */
+bool Executor::RunReady()
 {
-        for (int i = config.threadId; i < (int)batch.numActions;
-             i += config.numExecutors) {
-                while (pendingList->Size() > 0) {
-                        ExecPending();
-                }
+        mv_action *action, *next;
+        uint64_t now;
 
-                mv_action *cur = batch.actionBuf[i];
-                if (!ProcessSingle(cur)) {
-                        pendingList->EnqueuePending(cur);
-                }
+        barrier();
+        if (readyQueue == 0)
+                return false;
+        barrier();
+        action = (mv_action*)xchgq(&readyQueue, 0);
+        now = rdtsc();
+        while (action != NULL) {
+                next = action->next_waiter;
+                stats.wakeups += 1;
+                stats.wakeup_cycles += now - action->wake_time;
+                if (ScheduleOwn(action))
+                        numWaiting -= 1;
+                action = next;
         }
+        return true;
+}
 
-        while (!pendingList->IsEmpty()) {
-                ExecPending();
+/* Called by other executors, hand a parked txn back to this one. */
+void Executor::Wake(mv_action *action)
+{
+        uint64_t head;
+
+        action->wake_time = rdtsc();
+        while (true) {
+                barrier();
+                head = readyQueue;
+                barrier();
+                action->next_waiter = (mv_action*)head;
+                if (cmp_and_swap(&readyQueue, head, (uint64_t)action))
+                        break;
         }
+}
 
-        ActionBatch dummy = {NULL, 0};
-        config.outputQueue->EnqueueBlocking(dummy);  
+/* 
+ * Register action as a waiter of blocker. Returns false if blocker has already 
+ * completed, in which case action can be retried right away.
+ */
+bool Executor::Park(mv_action *action, mv_action *blocker)
+{
+        uint64_t head;
+
+        while (true) {
+                barrier();
+                head = blocker->waiters;
+                barrier();
+                if (head == MV_WAITERS_CLOSED)
+                        return false;
+                action->next_waiter = (mv_action*)head;
+                if (cmp_and_swap(&blocker->waiters, head, (uint64_t)action))
+                        return true;
+        }
 }
 
-// Returns the epoch of the oldest pending record.
-uint32_t Executor::DoPendingGC() 
+/* Mark a txn complete, and hand each of its waiters back to their executor. */
+void Executor::Substantiate(mv_action *action)
+{
+        mv_action *waiter, *next;
+
+        xchgq(&action->__state, SUBSTANTIATED);
+        waiter = (mv_action*)xchgq(&action->waiters, MV_WAITERS_CLOSED);
+        while (waiter != NULL) {
+                next = waiter->next_waiter;
+                waiter->home->Wake(waiter);
+                waiter = next;
+        }
+}
+
+/* 
+ * Try to execute one of this executor's own txns. If an unfinished 
+ * predecessor blocks it, park it on that predecessor until woken. If another 
+ * executor holds it, put it on the pending list. Returns true if the txn has 
+ * been executed.
+ */
+bool Executor::ScheduleOwn(mv_action *action)
 {
-        static uint64_t mask = 0xFFFFFFFF00000000;
-        pendingGC->ResetCursor();
-        for (ActionListNode *node = pendingGC->GetNext(); node != NULL; 
-             node = pendingGC->GetNext()) {
-                assert(node->action != NULL);
-                if (ProcessSingleGC(node->action)) {      
-                        pendingGC->DequeuePending(node);
+        mv_action *blocker;
+
+        action->home = this;
+        while (true) {
+                action->blocker = NULL;
+                if (ProcessSingle(action))
+                        return true;
+                barrier();
+                blocker = action->blocker;
+                barrier();
+                if (blocker == NULL) {
+                        pendingList->EnqueuePending(action);
+                        return false;
+                }
+                if (Park(action, blocker)) {
+                        stats.parks += 1;
+                        return false;
                 }
         }
+}
 
-        if (pendingGC->IsEmpty()) {
-                return 0xFFFFFFFF;
+ExecutorStats Executor::GetStats()
+{
+        return stats;
+}
+
+/* The watermark garbage is held back to, see SetupExec. */
+volatile uint32_t* Executor::GCWatermark()
+{
+        return config.garbageConfig.lowWaterMarkPtr;
+}
+
+/* Every epoch up to the low watermark has been executed. */
+volatile uint32_t* Executor::Watermark()
+{
+        return config.lowWaterMarkPtr;
+}
+
+/* The watermark's tree, whose epochs may be read at any time for GC lag. */
+EpochTree* Executor::Epochs()
+{
+        return config.epochs;
+}
+
+void Executor::SetRestartQueue(SimpleQueue<RestartedTxn> *queue)
+{
+        config.restartQueue = queue;
+}
+
+GarbageBinStats Executor::GetGCStats()
+{
+        return garbageBin->GetStats();
+}
+
+uint64_t Executor::LivePayloads()
+{
+        uint64_t live;
+        uint32_t i;
+
+        live = 0;
+        for (i = 0; i < numPools*config.numTables; ++i)
+                if (allocators[i] != NULL)
+                        live += allocators[i]->Live();
+        return live;
+}
+
+WorkStealingDeque<ExecSlice>* Executor::GetSlices()
+{
+        return slices;
+}
+
+/* 
+ * Split the batch into slices of consecutive txns, and deal them out 
+ * round-robin: this executor's share goes onto its deque. The slices are 
+ * pushed back to front, so the owner works through its share in timestamp 
+ * order while thieves take the latest txns, which are the least likely to be 
+ * depended upon soon. Large batches (the database load) use larger slices to 
+ * fit in the deque.
+ */
+void Executor::PushSlices(const ActionBatch &batch)
+{
+        uint32_t slice_size, num_slices, start;
+        int64_t i;
+        ExecSlice slice;
+
+        assert(slices->IsEmpty());
+        slice_size = config.sliceSize;
+        if (batch.numActions / slice_size >= 
+            EXEC_DEQUE_SIZE*config.numExecutors)
+                slice_size = 
+                        batch.numActions / (EXEC_DEQUE_SIZE*config.numExecutors) + 1;
+        num_slices = (batch.numActions + slice_size - 1) / slice_size;
+        slice.epoch = epoch;
+        for (i = (int64_t)num_slices - 1; i >= 0; --i) {
+                if (i % config.numExecutors != config.threadId)
+                        continue;
+                start = i*slice_size;
+                slice.actions = &batch.actionBuf[start];
+                slice.count = std::min(slice_size, batch.numActions - start);
+                slices->Push(slice);
         }
-        else {
-                pendingGC->ResetCursor();
-                ActionListNode *node = pendingGC->GetNext();
-                assert(node != NULL && node->action != NULL);
-                return ((node->action->__version & mask) >> 32);
+}
+
+void Executor::RunOwn(mv_action *action)
+{
+        if (!ScheduleOwn(action))
+                numWaiting += 1;
+        stats.txns += 1;
+        stats.waiting_sum += numWaiting;
+        if (numWaiting > stats.max_waiting)
+                stats.max_waiting = numWaiting;
+}
+
+void Executor::RunSlice(const ExecSlice &slice)
+{
+        uint32_t i;
+
+        for (i = 0; i < slice.count; ++i) {
+                RunReady();
+                RunOwn(slice.actions[i]);
         }
 }
 
-bool Executor::ProcessSingleGC(mv_action *action) 
+/* 
+ * Try to take a slice of the current batch from another executor, visiting 
+ * each of them once starting after the last successful victim. Stolen txns 
+ * become this executor's own: it parks them and gets their wakeups.
+ */
+bool Executor::Steal(ExecSlice *OUT_SLICE)
 {
-        assert(action->__state == SUBSTANTIATED);
-        uint32_t numWrites = action->__writeset.size();
-        bool ret = true;
+        uint32_t i, cur_epoch;
+        WorkStealingDeque<ExecSlice> *deque;
 
-        // Garbage collect the previous versions
-        for (uint32_t i = 0; i < numWrites; ++i) {
-                MVRecord *previous = action->__writeset[i].value->recordLink;
-                if (previous != NULL) {
-                        ret &= (previous->writer == NULL || 
-                                previous->writer->__state == SUBSTANTIATED);
+        cur_epoch = epoch;
+        for (i = 0; i < config.numExecutors; ++i) {
+                victim = (victim + 1) % config.numExecutors;
+                if (victim == config.threadId)
+                        continue;
+                deque = config.peers[victim]->GetSlices();
+                if (deque->Steal(OUT_SLICE, [cur_epoch](const ExecSlice &s) {
+                                        return s.epoch == cur_epoch;
+                                })) {
+                        stats.steals += 1;
+                        return true;
                 }
         }
-  
-        if (ret) {
-                for (uint32_t i = 0; i < numWrites; ++i) {
-                        MVRecord *previous = action->__writeset[i].value->recordLink;
-                        if (previous != NULL) {
-        
-                                // Since the previous txn has been substantiated, the record's value 
-                                // shouldn't be NULL.
-                                assert(previous->value != NULL);
-                                garbageBin->AddRecord(previous->writingThread, 
-                                                      action->__writeset[i].tableId,
-                                                      previous->value);
-                                //        garbageBin->AddMVRecord(action->__writeset[i].threadId, previous);
-                        }
+        return false;
+}
+
+/* 
+ * Process a single batch of transactions. Txns that can't run yet are parked 
+ * and the executor moves on. Once it is out of txns of its own, it steals 
+ * slices from other executors while waiting for its parked txns.
+ */
+void Executor::ProcessBatch(const ActionBatch &batch) 
+{
+        ExecSlice slice;
+        uint64_t start;
+        bool worked;
+
+        assert(numWaiting == 0);
+        if (slices != NULL) {
+                PushSlices(batch);
+                while (slices->Pop(&slice)) 
+                        RunSlice(slice);
+        } else {
+                for (int i = config.threadId; i < (int)batch.numActions;
+                     i += config.numExecutors) {
+                        RunReady();
+                        RunOwn(batch.actionBuf[i]);
                 }
         }
-  
-        return ret;
+
+        while (true) {
+                start = rdtsc();
+                worked = RunReady();
+                if (!pendingList->IsEmpty())
+                        ExecPending();
+                if (slices != NULL && Steal(&slice)) {
+                        RunSlice(slice);
+                        worked = true;
+                } else if (numWaiting == 0) {
+                        break;
+                }
+                if (!worked)
+                        stats.idle_cycles += rdtsc() - start;
+        }
+        if (mv_action::INCR_DELTAS)
+                FoldDeltas(batch);
 }
 
 /* Take ownership of a transaction's execution. */
@@ -316,19 +971,52 @@ bool Executor::ProcessSingle(mv_action *action)
         }
 }
 
+/*
+ * Every version a range read resolved to must have been written. Ranges
+ * already found ready are skipped, within a range the versions of writers
+ * that have since been substantiated are cheap to check again.
+ */
+bool Executor::check_ranges(mv_action *action, uint32_t low_watermark)
+{
+        MVRangeRead *range;
+        mv_action *depend_action;
+        MVRecord *version;
+        uint32_t i, j;
+
+        for (; action->range_index < action->__numRanges; 
+             action->range_index += 1) {
+                range = &action->__ranges[action->range_index];
+                for (i = 0; i < NUM_CC_THREADS; ++i) {
+                        for (j = 0; j < range->counts[i]; ++j) {
+                                version = range->versions[i*range->limit + j];
+                                depend_action = unwritten(version, 
+                                                          low_watermark);
+                                if (depend_action != NULL) {
+                                        action->blocker = depend_action;
+                                        return false;
+                                }
+                                FoldRead(version, range->tableId);
+                        }
+                }
+        }
+        return true;
+}
+
 /* 
  * Check whether all of a transaction's conflicting ancestors have finished 
  * executing.
  */
 bool Executor::check_ready(mv_action *action)
 {
-        uint32_t num_reads, num_writes, i;
+        uint32_t num_reads, num_writes, i, low_watermark;
         bool ready;
         mv_action *depend_action;
         MVRecord *prev;
-        void *new_data, *old_data;
         uint32_t *read_index, *write_index;
 
+        barrier();
+        low_watermark = *config.lowWaterMarkPtr;
+        barrier();
         ready = true;
         num_reads = action->__readset.size();
         num_writes = action->__writeset.size();
@@ -337,46 +1025,132 @@ bool Executor::check_ready(mv_action *action)
         for (; *read_index < num_reads; *read_index += 1) {
                 i = *read_index;
 
-                assert(action->__readset[i].value != NULL);
-                depend_action = action->__readset[i].value->writer;
-                if (depend_action != NULL &&
-                    depend_action->__state != SUBSTANTIATED &&
-                    !ProcessSingle(depend_action)) {
+                /* The key is absent, there is no writer to wait for. */
+                if (action->__readset[i].value == NULL)
+                        continue;
+                depend_action = unwritten(action->__readset[i].value, 
+                                          low_watermark);
+                if (depend_action != NULL) {
+                        action->blocker = depend_action;
                         ready = false;
                         break;
                 }
+                FoldRead(action->__readset[i].value, 
+                         action->__readset[i].tableId);
         }
+        if (ready && !check_ranges(action, low_watermark))
+                ready = false;
         for (; *write_index < num_writes; *write_index += 1) {
                 i = *write_index;
                 assert(action->__writeset[i].value != NULL);
-                if (action->__writeset[i].is_rmw) {
+                /* An increment doesn't wait for the value it adds to. */
+                if (action->__writeset[i].is_rmw && 
+                    !action->__writeset[i].is_incr &&
+                    !action->__writeset[i].value->tombstone) {
                         prev = action->__writeset[i].value->recordLink;
                         assert(prev != NULL);
-                        depend_action = prev->writer;
-                        if (depend_action != NULL &&
-                            depend_action->__state != SUBSTANTIATED && 
-                            !ProcessSingle(depend_action)) {
+                        depend_action = unwritten(prev, low_watermark);
+                        if (depend_action != NULL) {
+                                action->blocker = depend_action;
                                 ready = false;
                                 break;
-                        } else if (action->__writeset[i].initialized == false) {
-                                /* 
-                                 * XXX This is super hacky. Need to separate 
-                                 * record allocation from version allocation to 
-                                 * make it work -- "engineering work". 
-                                 */
-                                new_data = action->__writeset[i].value->value;
-                                old_data = prev->value;
-                                memcpy(new_data, old_data, GLOBAL_RECORD_SIZE);
-                                action->__writeset[i].initialized = true;
                         }
+                        FoldRead(prev, action->__writeset[i].tableId);
                 }
         }
         return ready;
 }
 
+/* 
+ * Get a payload for a new version of a record in the given table. Payloads 
+ * superseded at least one GC epoch ago come back from other executors through 
+ * the recycle queues; only if there are none does the allocator grow.
+ */
+Record* Executor::AllocPayload(uint32_t pool, uint32_t tableId)
+{
+        RecordAllocator *alloc;
+        Record *ret;
+
+        alloc = allocators[pool*config.numTables + tableId];
+        assert(alloc != NULL);
+        if (alloc->GetRecord(&ret))
+                return ret;
+        RecycleData();
+        if (alloc->GetRecord(&ret))
+                return ret;
+        alloc->Grow();
+        if (!alloc->GetRecord(&ret))
+                assert(false);
+        return ret;
+}
+
+/* The pool payloads of keys owned by ccThread come from. */
+uint32_t Executor::PayloadPool(uint32_t ccThread)
+{
+        if (config.placement == PAYLOAD_CC)
+                return config.ccNodes[ccThread];
+        return 0;
+}
+
+void Executor::CountPayload(Record *payload)
+{
+        stats.payload_accesses += 1;
+        if (payload->node >= 0 && payload->node != node)
+                stats.payload_remote += 1;
+}
+
+/*
+ * Give each version the txn writes a payload of its table's record size. 
+ * With MVRecord::INLINE_VALUES, payloads live in the version header itself. 
+ * An RMW starts from a copy of the previous version, which check_ready has 
+ * established is substantiated, an increment from zero (see Fold). Tombstones 
+ * get no payload.
+ */
+void Executor::InstallPayloads(mv_action *action)
+{
+        uint32_t num_writes, i, table;
+        MVRecord *version, *prev;
+        Record *payload;
+        void *value;
+
+        num_writes = action->__writeset.size();
+        for (i = 0; i < num_writes; ++i) {
+                version = action->__writeset[i].value;
+                table = action->__writeset[i].tableId;
+                assert(version->value == NULL);
+                if (version->tombstone) {
+                        version->writingThread = config.threadId;
+                        continue;
+                }
+                if (MVRecord::INLINE_VALUES) {
+                        value = version->InlineValue();
+                } else {
+                        payload = AllocPayload(PayloadPool(action->__writeset[i].threadId),
+                                               table);
+                        CountPayload(payload);
+                        value = payload->value;
+                }
+                if (action->__writeset[i].is_incr) {
+                        memset(value, 0x0, config.recordSizes[table]);
+                        action->__writeset[i].initialized = true;
+                        stats.deltas.writes += 1;
+                } else if (action->__writeset[i].is_rmw) {
+                        prev = version->recordLink;
+                        assert(prev != NULL && prev->value != NULL);
+                        if (!prev->IsInline())
+                                CountPayload(payload_record(prev->value));
+                        memcpy(value, prev->value, config.recordSizes[table]);
+                        action->__writeset[i].initialized = true;
+                }
+                version->writingThread = config.threadId;
+                version->value = value;
+        }
+}
+
 /* 
  * Run a read-only transaction against an epoch which immediately precedes that 
- * of the transaction. 
+ * of the transaction. Writers of the snapshot that haven't been executed yet 
+ * are executed first, as in check_ready.
 */
 bool Executor::run_readonly(mv_action *action)
 {
@@ -385,33 +1159,120 @@ bool Executor::run_readonly(mv_action *action)
         assert(action->__readonly == true);
         assert(action->__writeset.size() == 0);
         
-        uint32_t num_reads, i;
+        uint32_t num_reads, i, low_watermark;
         uint64_t read_epoch;
         MVRecord *rec, *snapshot;
-        void *value_ptr;
+        mv_action *depend_action;
 
+        barrier();
+        low_watermark = *config.lowWaterMarkPtr;
+        barrier();
         read_epoch = GET_MV_EPOCH(action->__version);
         num_reads = action->__readset.size();
         for (i = 0; i < num_reads; ++i) {
                 rec = action->__readset[i].value;
-                if (read_epoch == GET_MV_EPOCH(rec->createTimestamp)) 
+                if (rec != NULL && 
+                    read_epoch == GET_MV_EPOCH(rec->createTimestamp)) 
                         snapshot = rec->epoch_ancestor;
                 else 
                         snapshot = rec;
+                if (snapshot == NULL)
+                        continue;
 
                 barrier();
-                value_ptr = snapshot->value;
+                depend_action = unwritten(snapshot, low_watermark);
                 barrier();
-                if (value_ptr == NULL)
+                if (depend_action != NULL) {
+                        action->blocker = depend_action;
                         return false;
+                }
+                FoldRead(snapshot, action->__readset[i].tableId);
         }
         action->exec = this;
         action->Run();
-        xchgq(&action->__state, SUBSTANTIATED);
+        if (action->__recon)
+                Resubmit(action);
+        Substantiate(action);
         return true;
         
 }
 
+/*
+ * Hand the txn to the distributor, to be submitted again in a later epoch 
+ * (see MVActionDistributor::InjectRestarts): after its recon, or after its 
+ * Run() found the predicted sets stale. A restarted txn writes only through 
+ * RMWs, so its versions hold the copies of their predecessors InstallPayloads 
+ * made. This happens before the txn is substantiated, so the txn is in the 
+ * queue once its epoch passes the low watermark.
+ */
+void Executor::Resubmit(mv_action *action)
+{
+        RestartedTxn restart;
+        uint32_t num_writes, i;
+
+        assert(config.restartQueue != NULL);
+        restart.t = action->t;
+        restart.timestamp = action->__version;
+        restart.restarts = action->__restarts;
+        restart.firstEpoch = action->__firstEpoch;
+        restart.firstAbort = action->__firstAbort;
+        if (action->__recon) {
+                stats.restarts.recons += 1;
+        } else {
+                num_writes = action->__writeset.size();
+                for (i = 0; i < num_writes; ++i)
+                        assert(action->__writeset[i].is_rmw && 
+                               !action->__writeset[i].is_delete);
+                if (restart.restarts == 0) {
+                        restart.firstEpoch = 
+                                (uint32_t)(action->__version >> 32);
+                        restart.firstAbort = rdtsc();
+                }
+                restart.restarts += 1;
+                stats.restarts.restarts += 1;
+        }
+        action->__resubmitted = true;
+        config.restartQueue->EnqueueBlocking(restart);
+}
+
+/*
+ * Undo a logic abort (see txn::abort): the txn's versions are reset to the 
+ * copies of their predecessors InstallPayloads made, and its deltas to zero, 
+ * so its dependents read what they would have read had it written nothing. 
+ * The versions themselves stay in place, the CC stage has already chained 
+ * them in.
+ */
+void Executor::Rollback(mv_action *action)
+{
+        uint32_t num_writes, i, table;
+        MVRecord *version;
+
+        num_writes = action->__writeset.size();
+        for (i = 0; i < num_writes; ++i) {
+                assert(action->__writeset[i].is_rmw && 
+                       !action->__writeset[i].is_delete);
+                version = action->__writeset[i].value;
+                if (version->tombstone)
+                        continue;
+                table = action->__writeset[i].tableId;
+                if (action->__writeset[i].is_incr)
+                        memset(version->value, 0x0, config.recordSizes[table]);
+                else
+                        memcpy(version->value, version->recordLink->value, 
+                               config.recordSizes[table]);
+        }
+        stats.aborts.procs[action->t->log_proc()] += 1;
+}
+
+/* Account for the extra latency of a restarted txn that made it. */
+void Executor::CountCommit(mv_action *action)
+{
+        stats.restarts.restarted += 1;
+        stats.restarts.restart_epochs += 
+                (uint32_t)(action->__version >> 32) - action->__firstEpoch;
+        stats.restarts.restart_cycles += rdtsc() - action->__firstAbort;
+}
+
 /* 
  * Check that a transaction's conflicting predecessors have finished executing, 
  * and then execute the transaction. 
@@ -429,14 +1290,33 @@ bool Executor::ProcessTxn(mv_action *action)
         if (check_ready(action) == false)
                 return false;
         
+        InstallPayloads(action);
         action->exec = this;
-        action->Run();
-        xchgq(&action->__state, SUBSTANTIATED);
+        if (action->Run()) {
+                if (action->__restarts > 0)
+                        CountCommit(action);
+        } else if (action->__aborted) {
+                Rollback(action);
+        } else {
+                Resubmit(action);
+        }
+        Substantiate(action);
+        if (forcing)
+                stats.lazy.forced += 1;
 
-        /* Register over-written versions for garbage collection */
+        /* 
+         * Register over-written versions for garbage collection. Their 
+         * payloads are split off when the GC epoch is released (see 
+         * GarbageBin::CollectPayloads); a blind write's predecessor may not 
+         * even have one yet. A delta's predecessor is needed until the delta 
+         * is folded, see FoldDeltas.
+         */
         num_writes = action->__writeset.size();
         for (i = 0; i < num_writes; ++i) {
                 pred_version = action->__writeset[i].value->recordLink;
+                if (action->__writeset[i].is_incr && 
+                    !action->__writeset[i].value->tombstone)
+                        continue;
                 if (pred_version != NULL) {
                         garbageBin->AddMVRecord(action->__writeset[i].threadId, pred_version);
                 }
@@ -449,6 +1329,7 @@ GarbageBin::GarbageBin(GarbageBinConfig config)
         assert(sizeof(MVRecordList) == sizeof(RecordList));
         this->config = config;
         this->snapshotEpoch = 0;
+        memset(&this->stats, 0x0, sizeof(GarbageBinStats));
 
         // total number of structs
         uint32_t numStructs = 
@@ -471,7 +1352,7 @@ GarbageBin::GarbageBin(GarbageBinConfig config)
   
         this->curRecords = (RecordList*)((char*)data + 2*ccOffset);
         this->snapshotRecords = (RecordList*)((char*)data + 2*ccOffset+workerOffset);
-        for (uint32_t i = 0; i < 2*config.numWorkers; ++i) {
+        for (uint32_t i = 0; i < 2*config.numWorkers*config.numTables; ++i) {
                 curRecords[i].tail = &curRecords[i].head;
                 curRecords[i].head = NULL;
                 curRecords[i].count = 0;
@@ -488,17 +1369,54 @@ void GarbageBin::AddMVRecord(uint32_t ccThread, MVRecord *rec)
         assert(curStickies[ccThread].head != NULL);
 }
 
-void GarbageBin::AddRecord(uint32_t workerThread, uint32_t tableId, 
-                           Record *rec) 
+/*
+ * Move the payloads of a list of released versions to the record lists of the 
+ * executors that own them. Every writer in the list has been executed by now. 
+ * The versions' value is cleared, so a list whose return to its CC thread 
+ * fails can be walked again.
+ */
+void GarbageBin::CollectPayloads(MVRecordList stickies)
 {
-        //  rec->next = NULL;
-        *(curRecords[workerThread*config.numTables+tableId].tail) = rec;
-        curRecords[workerThread*config.numTables+tableId].tail = &rec->next;  
-        curRecords[workerThread*config.numTables+tableId].count += 1;
+        MVRecord *cur;
+        Record *payload;
+        uint32_t index;
+
+        for (cur = stickies.head; cur != NULL; cur = cur->allocLink) {
+                if (cur->value == NULL)
+                        continue;
+                if (cur->IsInline()) {
+                        cur->value = NULL;
+                        continue;
+                }
+                payload = payload_record(cur->value);
+                index = payload->owner*config.numTables + payload->tableId;
+                *(snapshotRecords[index].tail) = payload;
+                snapshotRecords[index].tail = &payload->next;
+                snapshotRecords[index].count += 1;
+                payload->next = NULL;
+                cur->value = NULL;
+                stats.payloads += 1;
+        }
 }
 
 void GarbageBin::ReturnGarbage() 
 {
+        uint32_t numRecordLists = config.numWorkers*config.numTables;
+        for (uint32_t i = 0; i < config.numCCThreads; ++i) 
+                CollectPayloads(snapshotStickies[i]);
+        for (uint32_t i = 0; i < numRecordLists; ++i) {
+                if (snapshotRecords[i].head != NULL &&
+                    !config.workerChannels[i]->Enqueue(snapshotRecords[i])) {
+                        *(curRecords[i].tail) = snapshotRecords[i].head;
+                        curRecords[i].tail = snapshotRecords[i].tail;
+                        curRecords[i].count += snapshotRecords[i].count;
+                }
+                snapshotRecords[i] = curRecords[i];
+                curRecords[i].head = NULL;
+                curRecords[i].tail = &curRecords[i].head;
+                curRecords[i].count = 0;
+        }
+
         for (uint32_t i = 0; i < config.numCCThreads; ++i) {
                 // *curStickies[i].tail = NULL;
 
@@ -511,7 +1429,7 @@ void GarbageBin::ReturnGarbage()
                                 curStickies[i].count += snapshotStickies[i].count;
                         }
                         else {
-                                //        std::cout << "Recycle!\n";
+                                stats.versions += snapshotStickies[i].count;
                         }
                 }
                 snapshotStickies[i] = curStickies[i];
@@ -529,24 +1447,86 @@ void GarbageBin::FinishEpoch(uint32_t epoch)
   
         if (lowWatermark >= snapshotEpoch) {
                 ReturnGarbage();
+                if (epoch > snapshotEpoch) {
+                        stats.releases += 1;
+                        stats.lag_sum += epoch - snapshotEpoch;
+                        if (epoch - snapshotEpoch > stats.max_lag)
+                                stats.max_lag = epoch - snapshotEpoch;
+                }
                 snapshotEpoch = epoch;
                 //    std::cout << "Success: " << epoch << "\n";
         }
 }
 
+GarbageBinStats GarbageBin::GetStats()
+{
+        return stats;
+}
+
 RecordAllocator::RecordAllocator(size_t recordSize, uint32_t numRecords, 
-                                 int cpu) 
+                                 int node, uint32_t owner, uint32_t tableId,
+                                 uint32_t pool) 
 {
-        char *data = 
-                (char*)alloc_mem(numRecords*(sizeof(Record)+recordSize), cpu);
-        memset(data, 0x00, numRecords*(sizeof(Record)+recordSize));
+        this->freeList = NULL;
+        this->recordSize = recordSize;
+        this->node = node;
+        this->owner = owner;
+        this->tableId = tableId;
+        this->pool = pool;
+        this->chunkSize = numRecords/8 > 1024? numRecords/8 : 1024;
+        this->numRecords = 0;
+        this->numFree = 0;
+        if (numRecords > 0)
+                AddChunk(numRecords);
+}
+
+/* 
+ * An interleaved chunk's pages are placed round-robin, so each payload's node 
+ * is looked up once the chunk has been touched.
+ */
+void RecordAllocator::AddChunk(uint32_t numRecords)
+{
+        size_t sz = sizeof(Record)+recordSize;
+        char *data;
+        void **addrs;
+        int *nodes;
+
+        if (node >= 0)
+                data = (char*)alloc_on_node(numRecords*sz, node);
+        else
+                data = (char*)alloc_interleaved_all(numRecords*sz);
+        assert(data != NULL);
+        memset(data, 0x00, numRecords*sz);
+        nodes = (int*)malloc(sizeof(int)*numRecords);
+        assert(nodes != NULL);
+        if (node >= 0) {
+                for (uint32_t i = 0; i < numRecords; ++i)
+                        nodes[i] = node;
+        } else {
+                addrs = (void**)malloc(sizeof(void*)*numRecords);
+                assert(addrs != NULL);
+                for (uint32_t i = 0; i < numRecords; ++i)
+                        addrs[i] = data + i*sz;
+                get_mem_nodes(addrs, numRecords, nodes);
+                free(addrs);
+        }
         for (uint32_t i = 0; i < numRecords; ++i) {
-                ((Record*)(data + i*(sizeof(Record)+recordSize)))->next = 
-                        (Record*)(data + (i+1)*(sizeof(Record)+recordSize));
+                ((Record*)(data + i*sz))->next = (Record*)(data + (i+1)*sz);
+                ((Record*)(data + i*sz))->owner = owner;
+                ((Record*)(data + i*sz))->tableId = tableId;
+                ((Record*)(data + i*sz))->pool = pool;
+                ((Record*)(data + i*sz))->node = nodes[i];
         }
-        ((Record*)(data + (numRecords-1)*(sizeof(Record)+recordSize)))->next = NULL;
-        //  data[numRecords-1].next = NULL;
+        free(nodes);
+        ((Record*)(data + (numRecords-1)*sz))->next = freeList;
         freeList = (Record*)data;
+        this->numRecords += numRecords;
+        this->numFree += numRecords;
+}
+
+void RecordAllocator::Grow()
+{
+        AddChunk(chunkSize);
 }
 
 bool RecordAllocator::GetRecord(Record **OUT_REC) 
@@ -556,6 +1536,7 @@ bool RecordAllocator::GetRecord(Record **OUT_REC)
                 freeList = freeList->next;
                 temp->next = NULL;
                 *OUT_REC = temp;    
+                numFree -= 1;
                 return true;
         }
         else {
@@ -568,10 +1549,18 @@ void RecordAllocator::FreeSingle(Record *rec)
 {
         rec->next = freeList;
         freeList = rec;
+        numFree += 1;
 }
 
 void RecordAllocator::Recycle(RecordList recList) 
 {
         *(recList.tail) = freeList;
         freeList = recList.head;
+        numFree += recList.count;
+}
+
+/* Payloads handed out and not yet recycled. */
+uint64_t RecordAllocator::Live()
+{
+        return numRecords - numFree;
 }
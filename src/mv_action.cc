@@ -1,9 +1,13 @@
 #include <mv_action.h>
 #include <table.h>
 #include <executor.h>
+#include <algorithm>
+#include <immintrin.h>
 
 extern Table** mv_tables;
 
+bool mv_action::INCR_DELTAS = false;
+
 Action::Action()
 {
         this->__version = 0;
@@ -19,13 +23,71 @@ Action::Action()
 CompositeKey Action::GenerateKey(bool is_rmw, uint32_t tableId, uint64_t key)
 {
         CompositeKey toAdd(is_rmw, tableId, key);
-        uint32_t threadId =
-                CompositeKey::HashKey(&toAdd) % NUM_CC_THREADS;
-        toAdd.threadId = threadId;
-        this->__combinedHash |= ((uint64_t)1) << threadId;
+        toAdd.hash = CompositeKey::Hash(&toAdd);
+        toAdd.vpart = CompositeKey::Owner(toAdd.hash, NUM_VPARTS);
+        toAdd.threadId = CompositeKey::Owner(toAdd.hash, NUM_CC_THREADS);
+        this->__combinedHash |= ((uint64_t)1) << toAdd.threadId;
         return toAdd;
 }
 
+/* 
+ * CityHash's Hash128to64 of (key, tableId), four keys at a time. AVX2 has no 
+ * 64-bit multiply, each product is assembled from three 32-bit ones.
+ */
+#define HASH_MUL 0x9ddfea08eb382d69ULL
+
+__attribute__((target("avx2")))
+static inline __m256i mul_hash_mul(__m256i x)
+{
+        __m256i mul_lo, mul_hi, lo, cross;
+
+        mul_lo = _mm256_set1_epi64x(HASH_MUL & 0xFFFFFFFF);
+        mul_hi = _mm256_set1_epi64x(HASH_MUL >> 32);
+        lo = _mm256_mul_epu32(x, mul_lo);
+        cross = _mm256_add_epi64(_mm256_mul_epu32(_mm256_srli_epi64(x, 32), 
+                                                  mul_lo),
+                                 _mm256_mul_epu32(x, mul_hi));
+        return _mm256_add_epi64(lo, _mm256_slli_epi64(cross, 32));
+}
+
+__attribute__((target("avx2")))
+static uint32_t hash_batch_avx2(CompositeKey *keys, uint32_t count)
+{
+        __m256i lo, hi, a, b;
+        uint64_t hashes[4];
+        uint32_t i, j;
+
+        for (i = 0; i + 4 <= count; i += 4) {
+                lo = _mm256_set_epi64x(keys[i+3].key, keys[i+2].key, 
+                                       keys[i+1].key, keys[i].key);
+                hi = _mm256_set_epi64x(keys[i+3].tableId, keys[i+2].tableId,
+                                       keys[i+1].tableId, keys[i].tableId);
+                a = mul_hash_mul(_mm256_xor_si256(lo, hi));
+                a = _mm256_xor_si256(a, _mm256_srli_epi64(a, 47));
+                b = mul_hash_mul(_mm256_xor_si256(hi, a));
+                b = _mm256_xor_si256(b, _mm256_srli_epi64(b, 47));
+                b = mul_hash_mul(b);
+                _mm256_storeu_si256((__m256i*)hashes, b);
+                for (j = 0; j < 4; ++j)
+                        keys[i+j].hash = hashes[j];
+        }
+        return i;
+}
+
+void CompositeKey::HashBatch(CompositeKey *keys, uint32_t count)
+{
+        static bool use_avx2 = __builtin_cpu_supports("avx2");
+        uint32_t i;
+
+        i = use_avx2? hash_batch_avx2(keys, count) : 0;
+        for (; i < count; ++i) 
+                keys[i].hash = Hash(&keys[i]);
+        for (i = 0; i < count; ++i) {
+                keys[i].vpart = Owner(keys[i].hash, NUM_VPARTS);
+                keys[i].threadId = Owner(keys[i].hash, NUM_CC_THREADS);
+        }
+}
+
 void* Action::Read(uint32_t index)
 {
         //        uint64_t key = __readset[index].key;
@@ -224,22 +286,14 @@ bool RMWAction::Run()
         uint64_t counter = 0;
         for (i = 0; i < num_reads; ++i) {
                 char *field_ptr = (char*)Read(i);
-                if (SMALL_RECORDS) {
-                        counter += *((uint64_t*)field_ptr);
-                } else {
-                        for (j = 0; j < num_fields; ++j) 
-                                counter += *((uint64_t*)&field_ptr[j*100]);
-                }
+                for (j = 0; j < num_fields; ++j) 
+                        counter += *((uint64_t*)&field_ptr[j*100]);
         }
         for (i = 0; i < num_writes; ++i) {
                 if (__writeset[i].is_rmw) {
                         char *field_ptr = (char*)ReadWrite(i);
-                        if (SMALL_RECORDS) {
-                                counter += *((uint64_t*)field_ptr);
-                        } else {
-                                for (j = 0; j < num_fields; ++j)
-                                        counter += *((uint64_t*)&field_ptr[j*100]);
-                        }
+                        for (j = 0; j < num_fields; ++j)
+                                counter += *((uint64_t*)&field_ptr[j*100]);
                 }
         }
 
@@ -247,34 +301,102 @@ bool RMWAction::Run()
                 assert(__writeset[i].is_rmw);
                 char *read_ptr = (char*)ReadWrite(i);
                 char *write_ptr = (char*)GetWriteRef(i);
-                if (SMALL_RECORDS) {
-                        *((uint64_t*)write_ptr) =
-                                counter + *((uint64_t*)read_ptr);
-                } else {
-                        memcpy(write_ptr, read_ptr, YCSB_RECORD_SIZE);
-                        for (j = 0; j < num_fields; ++j)
-                                *((uint64_t*)&write_ptr[j*100]) += j+1+counter;
-                        //              *((uint64_t*)&read_ptr[j*100]);
-                }
+                memcpy(write_ptr, read_ptr, YCSB_RECORD_SIZE);
+                for (j = 0; j < num_fields; ++j)
+                        *((uint64_t*)&write_ptr[j*100]) += j+1+counter;
         }
 
         return true;
 }
 
+ActionArena::ActionArena(uint64_t size)
+{
+        assert(size > 0);
+        this->chunks = NULL;
+        this->chunkSize = size;
+        this->actions = NULL;
+        AddChunk(size);
+}
+
+void ActionArena::AddChunk(uint64_t size)
+{
+        Chunk *chunk;
+
+        chunk = (Chunk*)malloc(sizeof(Chunk) + size);
+        assert(chunk != NULL);
+        chunk->next = chunks;
+        chunk->size = size;
+        chunk->used = 0;
+        chunks = chunk;
+}
+
+void* ActionArena::Alloc(uint64_t size, uint64_t alignment)
+{
+        uint64_t offset;
+        uintptr_t base;
+
+        assert(alignment > 0 && (alignment & (alignment - 1)) == 0);
+        base = (uintptr_t)chunks->data;
+        offset = ((base + chunks->used + alignment - 1) & ~(alignment - 1)) - 
+                base;
+        if (offset + size > chunks->size) {
+                AddChunk(std::max(chunkSize/8, size + alignment));
+                base = (uintptr_t)chunks->data;
+                offset = ((base + alignment - 1) & ~(alignment - 1)) - base;
+        }
+        chunks->used = offset + size;
+        return chunks->data + offset;
+}
+
+/* Called by the single thread building the batch. */
+void ActionArena::AddAction(mv_action *action)
+{
+        action->arena_next = actions;
+        actions = action;
+}
+
+void ActionArena::Release()
+{
+        mv_action *action;
+        Chunk *next;
+
+        for (action = actions; action != NULL; action = action->arena_next)
+                if (!action->__resubmitted)
+                        delete(action->t);
+        while (chunks != NULL) {
+                next = chunks->next;
+                free(chunks);
+                chunks = next;
+        }
+        delete(this);
+}
+
 mv_action::mv_action(txn *t) : translator(t)
 {
         this->__version = 0;
         this->__combinedHash = 0;
         this->__readonly = false;
         this->__state = STICKY;
-        for (uint32_t i = 0; i < NUM_CC_THREADS; ++i) {
-                this->__write_starts.push_back(-1);
-                this->__nextAction.push_back(-1);
-                this->__read_starts.push_back(-1);
-        }
         this->init = false;
         this->read_index = 0;
         this->write_index = 0;
+        this->range_index = 0;
+        this->__ranges = NULL;
+        this->__numRanges = 0;
+        this->__numIncrs = 0;
+        this->__recon = false;
+        this->__restarts = 0;
+        this->__firstEpoch = 0;
+        this->__firstAbort = 0;
+        this->__aborted = false;
+        this->__resubmitted = false;
+        this->arena_next = NULL;
+        this->next_waiter = NULL;
+        this->home = NULL;
+        this->blocker = NULL;
+        this->wake_time = 0;
+        this->draws = 0;
+        this->waiters = 0;
 }
 
 bool mv_action::initialized()
@@ -282,150 +404,335 @@ bool mv_action::initialized()
         return init;
 }
 
-static struct big_key get_key(CompositeKey k)
+/* 
+ * Give the txn room for its read- and write-sets in the batch's arena. Must be 
+ * called before any keys are added.
+ */
+void mv_action::alloc_keys(ActionArena *arena, uint32_t num_reads, 
+                           uint32_t num_writes)
 {
-        struct big_key ret;
-        ret.key = k.key;
-        ret.table_id = k.tableId;
-        return ret;
+        CompositeKey *keys;
+
+        keys = (CompositeKey*)arena->Alloc(sizeof(CompositeKey)*
+                                           (num_reads + num_writes), 
+                                           sizeof(uint64_t));
+        __readset.Init(keys, num_reads);
+        __writeset.Init(&keys[num_reads], num_writes);
 }
 
-/*
- * Assumes that all the entries in the transaction's read- and write-sets are 
- * initialized.
+/* 
+ * Give the txn its range reads, with room for every CC thread's share of each 
+ * range's result. 
  */
-void mv_action::setup_reverse_index()
+void mv_action::add_ranges(ActionArena *arena, struct big_range *ranges, 
+                           uint32_t num_ranges)
 {
-        uint32_t num_reads, num_writes, i;
-        struct big_key key;
-        struct key_index index;
+        MVRangeRead *range;
+        uint32_t i;
+
+        assert(__numRanges == 0);
+        if (num_ranges == 0)
+                return;
+        __ranges = (MVRangeRead*)arena->Alloc(sizeof(MVRangeRead)*num_ranges,
+                                              sizeof(uint64_t));
+        for (i = 0; i < num_ranges; ++i) {
+                range = &__ranges[i];
+                range->start = ranges[i].start;
+                range->end = ranges[i].end;
+                range->tableId = ranges[i].table_id;
+                range->limit = ranges[i].limit;
+                range->counts = (uint32_t*)
+                        arena->Alloc(sizeof(uint32_t)*NUM_CC_THREADS, 
+                                     sizeof(uint32_t));
+                memset(range->counts, 0x0, sizeof(uint32_t)*NUM_CC_THREADS);
+                range->versions = (MVRecord**)
+                        arena->Alloc(sizeof(MVRecord*)*NUM_CC_THREADS*
+                                     range->limit, sizeof(uint64_t));
+        }
+        __numRanges = num_ranges;
+}
+
+/* 
+ * Hash the complete read- and write-sets, and note which CC threads they hit. 
+ * Range reads hit all of them.
+ */
+void mv_action::hash_keys()
+{
+        uint32_t i, num_reads, num_writes;
 
-        assert(init == false);
         num_reads = __readset.size();
         num_writes = __writeset.size();
+        CompositeKey::HashBatch(__readset.data(), num_reads);
+        CompositeKey::HashBatch(__writeset.data(), num_writes);
+        for (i = 0; i < num_reads; ++i)
+                __combinedHash |= ((uint64_t)1) << __readset[i].threadId;
+        for (i = 0; i < num_writes; ++i)
+                __combinedHash |= ((uint64_t)1) << __writeset[i].threadId;
+        if (__numRanges > 0)
+                __combinedHash |= ~((uint64_t)0) >> (64 - NUM_CC_THREADS);
+}
 
-        /* Initialize reverse index to items in the write-set. */
-        for (i = 0; i < num_writes; ++i) {
-                key = get_key(__writeset[i]);
-                index.index = i;
-                index.initialized = false;
-                if (__writeset[i].is_rmw == true)
-                        index.use = RMW;
-                else
-                        index.use = WRITE;
-                assert(reverse_index.count(key) == 0);
-                reverse_index[key] = index;
-        }
+/*
+ * Assumes that all the entries in the transaction's read- and write-sets are
+ * initialized.
+ */
+void mv_action::setup_access()
+{
+        assert(init == false);
 
-        /* Initialize reverse index to items in the read-set. */
-        for (i = 0; i < num_reads; ++i) {
-                key = get_key(__readset[i]);
-                index.index = i;
-                index.initialized = true;
-                index.use = READ;
-                assert(reverse_index.count(key) == 0);
-                reverse_index[key] = index;
-        }
+        hash_keys();
 
-        /* Optimize read-only txns in the execution phase. */
-        if (num_writes == 0)
+        /* 
+         * Optimize read-only txns in the execution phase. A range is 
+         * resolved at the txn's own timestamp rather than against the 
+         * previous epoch, so txns with ranges wait on their versions' writers 
+         * like any other.
+         */
+        if (__writeset.size() == 0 && __numRanges == 0)
                 __readonly = true;
         else
                 __readonly = false;
         init = true;
 }
 
+/* 
+ * Scratch space to copy a txn's keys out of, per thread: batches are built by 
+ * the input stage, restarted txns by the distributor that injects them.
+ */
+static __thread struct big_key *key_scratch = NULL;
+static __thread uint32_t key_scratch_size = 0;
+
+static __thread struct big_range *range_scratch = NULL;
+static __thread uint32_t range_scratch_size = 0;
+
+static void reserve_key_scratch(uint32_t num_entries)
+{
+        if (num_entries > key_scratch_size) {
+                free(key_scratch);
+                key_scratch_size = 2*num_entries;
+                key_scratch = (struct big_key*)
+                        malloc(sizeof(struct big_key)*key_scratch_size);
+                assert(key_scratch != NULL);
+        }
+}
+
+static void convert_ranges(mv_action *action, txn *txn, ActionArena *arena)
+{
+        uint32_t num_ranges;
+
+        num_ranges = txn->num_ranges();
+        if (num_ranges == 0)
+                return;
+        if (num_ranges > range_scratch_size) {
+                free(range_scratch);
+                range_scratch_size = 2*num_ranges;
+                range_scratch = (struct big_range*)
+                        malloc(sizeof(struct big_range)*range_scratch_size);
+                assert(range_scratch != NULL);
+        }
+        txn->get_ranges(range_scratch);
+        action->add_ranges(arena, range_scratch, num_ranges);
+}
+
+static void convert_keys(mv_action *action, txn *txn, ActionArena *arena)
+{
+        uint32_t i, num_reads, num_rmws, num_writes, num_deletes, num_incrs;
+
+        /* Size the scratch array to poke txn information. */
+        num_reads = txn->num_reads();
+        num_rmws = txn->num_rmws();
+        num_writes = txn->num_writes();
+        num_deletes = txn->num_deletes();
+        reserve_key_scratch(std::max(std::max(num_reads, num_rmws), 
+                                     std::max(num_writes, num_deletes)));
+        action->alloc_keys(arena, num_reads, 
+                           num_writes + num_rmws + num_deletes);
+                
+        /* Handle writes. */
+        txn->get_writes(key_scratch);
+        for (i = 0; i < num_writes; ++i)
+                action->add_write_key(key_scratch[i].table_id, 
+                                      key_scratch[i].key, false);
+
+        /* Handle rmws, the increments among them come last. */
+        num_incrs = mv_action::INCR_DELTAS? txn->num_incrs() : 0;
+        assert(num_incrs <= num_rmws);
+        txn->get_rmws(key_scratch);
+        for (i = 0; i < num_rmws; ++i)
+                action->add_write_key(key_scratch[i].table_id, 
+                                      key_scratch[i].key, true);
+        for (i = num_writes + num_rmws - num_incrs; i < num_writes + num_rmws;
+             ++i)
+                action->__writeset[i].is_incr = true;
+        action->__numIncrs = num_incrs;
+
+        /* Handle deletes. */
+        txn->get_deletes(key_scratch);
+        for (i = 0; i < num_deletes; ++i)
+                action->add_delete_key(key_scratch[i].table_id, 
+                                       key_scratch[i].key);
+        
+        /* Handle reads. */
+        txn->get_reads(key_scratch);
+        for (i = 0; i < num_reads; ++i)
+                action->add_read_key(key_scratch[i].table_id, 
+                                     key_scratch[i].key);
+        if (num_rmws == 0 && num_writes == 0 && num_deletes == 0)
+                action->__readonly = true;
+}
+
+static void convert_recon_keys(mv_action *action, txn *txn, ActionArena *arena)
+{
+        uint32_t i, num_reads;
+
+        num_reads = txn->num_recon_reads();
+        reserve_key_scratch(num_reads);
+        action->alloc_keys(arena, num_reads, 0);
+        txn->get_recon_reads(key_scratch);
+        for (i = 0; i < num_reads; ++i)
+                action->add_read_key(key_scratch[i].table_id, 
+                                     key_scratch[i].key);
+        action->__recon = true;
+}
+
+/* 
+ * Build the mv_action of a txn's next incarnation in arena: a recon action 
+ * while the txn needs recon, one covering its declared sets otherwise. 
+ */
+mv_action* mv_action::generate(txn *t, ActionArena *arena)
+{
+        mv_action *action;
+
+        action = new (arena) mv_action(t);
+        arena->AddAction(action);
+        t->set_translator(action);
+        if (t->needs_recon()) {
+                convert_recon_keys(action, t, arena);
+        } else {
+                convert_keys(action, t, arena);
+                convert_ranges(action, t, arena);
+        }
+        action->setup_access();
+        return action;        
+}
+
 bool mv_action::Run()
 {
+        if (__recon) {
+                t->recon();
+                return true;
+        }
+        __aborted = false;
         return t->Run();
 }
 
+/*
+ * A txn's sets are laid out in the order its stored procedure declared them
+ * (see convert_keys), so a position is a direct index into them and needs no
+ * per-txn lookup structure. A key that is absent or deleted reads as NULL, 
+ * and so does an RMW of one (see MVTablePartition::WriteNewVersion).
+ */
+void* mv_action::write_ref_at(uint32_t index, uint64_t key, uint32_t table_id)
+{
+        CompositeKey *write;
+
+        assert(init == true);
+        assert(index < this->__writeset.size());
+        write = &this->__writeset[index];
+        assert(write->key == key && write->tableId == table_id);
+        assert(!write->is_delete);
+        if (write->value->tombstone)
+                return NULL;
+        assert(!write->is_rmw || write->initialized == true);
+        return write->value->value;
+}
+
+void* mv_action::read_at(uint32_t index, uint64_t key, uint32_t table_id)
+{
+        MVRecord *record;
+
+        assert(init == true);
+        assert(index < this->__readset.size());
+        assert(this->__readset[index].key == key &&
+               this->__readset[index].tableId == table_id);
+        record = this->__readset[index].value;
+        if (record != NULL && this->__readonly == true &&
+            GET_MV_EPOCH(this->__version) ==
+            GET_MV_EPOCH(record->createTimestamp))
+                record = record->epoch_ancestor;
+        if (record == NULL || record->tombstone)
+                return NULL;
+        return (void*)record->value;
+}
+
+/* 
+ * Merge the CC threads' shares of the range, each in key order, and keep the 
+ * first limit. 
+ */
+uint32_t mv_action::range_at(uint32_t index, uint64_t *OUT_KEYS, 
+                             void **OUT_VALUES)
+{
+        uint32_t pos[NUM_CC_THREADS], i, count, best;
+        MVRangeRead *range;
+        MVRecord *rec, *best_rec;
+
+        assert(init == true);
+        assert(index < __numRanges);
+        range = &__ranges[index];
+        memset(pos, 0x0, sizeof(pos));
+        for (count = 0; count < range->limit; ++count) {
+                best_rec = NULL;
+                best = 0;
+                for (i = 0; i < NUM_CC_THREADS; ++i) {
+                        if (pos[i] == range->counts[i])
+                                continue;
+                        rec = range->versions[i*range->limit + pos[i]];
+                        if (best_rec == NULL || rec->key < best_rec->key) {
+                                best_rec = rec;
+                                best = i;
+                        }
+                }
+                if (best_rec == NULL)
+                        break;
+                pos[best] += 1;
+                if (OUT_KEYS != NULL)
+                        OUT_KEYS[count] = best_rec->key;
+                OUT_VALUES[count] = best_rec->value;
+        }
+        return count;
+}
+
+/* Key-based access, for procedures that do not track positions. */
 void* mv_action::write_ref(uint64_t key, uint32_t table_id)
 {
-        //        struct big_key bkey;
-        //        struct key_index index;
         uint32_t num_writes, i;
         
-        assert(init == true);
         num_writes = this->__writeset.size();
-        //        assert(num_writes < 10);
-        for (i = 0; i < num_writes; ++i) {
+        for (i = 0; i < num_writes; ++i) 
                 if (this->__writeset[i].key == key &&
-                    this->__writeset[i].tableId == table_id) {
-                        assert(!this->__writeset[i].is_rmw || 
-                               this->__writeset[i].initialized == true);
-                        return this->__writeset[i].value->value;
-                }
-        }
+                    this->__writeset[i].tableId == table_id)
+                        return write_ref_at(i, key, table_id);
         assert(false);
         return NULL;
 }
 
 void* mv_action::read(uint64_t key, uint32_t table_id)
 {
-        //        struct big_key bkey;
-        //        struct key_index index;
-        MVRecord *record, *snapshot;
-        uint32_t i, num_reads;
-        void *ret;
+        uint32_t num_reads, i;
         
-        assert(init == true);
-        record = NULL;
         num_reads = this->__readset.size();
-        //        assert(num_reads < 10);
-        for (i = 0; i < num_reads; ++i) {
+        for (i = 0; i < num_reads; ++i) 
                 if (this->__readset[i].key == key &&
-                    this->__readset[i].tableId == table_id) {
-                        record = this->__readset[i].value;
-                        break;
-                }
-        }
-        assert(record != NULL);
-        if (this->__readonly == true &&
-            (
-             GET_MV_EPOCH(this->__version) ==
-             GET_MV_EPOCH(record->createTimestamp)
-             )) {
-                snapshot = record->epoch_ancestor;
-                ret = (void*)snapshot->value;
-        } else {
-                ret = (void*)record->value;
-        }
-        return ret;
-
-        /*
-        bkey.key = key;
-        bkey.table_id = table_id;
-        assert(reverse_index.count(bkey) == 1);
-        index = reverse_index[bkey];
-        assert(index.use == READ || index.use == RMW);
-        if (index.use == READ) {
-                record = __readset[index.index].value;
-                if (__readonly == true &&
-                    (
-                     GET_MV_EPOCH(__version) ==
-                     GET_MV_EPOCH(record->createTimestamp)
-                     )) {
-                        snapshot = record->epoch_ancestor;
-                        ret = (void*)snapshot->value;
-                } else {
-                        ret = (void*)__readset[index.index].value->value;
-                }
-        } else {	// index.use == RMW
-                assert(__readonly == false);
-                ret = __writeset[index.index].value->value;
-        }
-        return ret;
-        */
+                    this->__readset[i].tableId == table_id)
+                        return read_at(i, key, table_id);
+        assert(false);
+        return NULL;
 }
 
+/* The key's hash and owner are filled in by hash_keys. */
 CompositeKey mv_action::GenerateKey(bool is_rmw, uint32_t tableId, uint64_t key)
 {
         CompositeKey toAdd(is_rmw, tableId, key);
-        uint32_t threadId =
-                CompositeKey::HashKey(&toAdd) % NUM_CC_THREADS;
-        toAdd.threadId = threadId;
-        this->__combinedHash |= ((uint64_t)1) << threadId;
         return toAdd;
 }
 
@@ -447,7 +754,30 @@ void mv_action::add_write_key(uint32_t tableId, uint64_t key, bool is_rmw)
         __readonly = false;
 }
 
+/* Deletes follow the txn's writes and rmws in its write-set. */
+void mv_action::add_delete_key(uint32_t tableId, uint64_t key)
+{
+        CompositeKey to_add;
+        assert(tableId == 0 || tableId == 1);
+        to_add = GenerateKey(false, tableId, key);
+        to_add.is_delete = true;
+        __writeset.push_back(to_add);
+        __readonly = false;
+}
+
+/* 
+ * A function of the txn's timestamp and the number of draws, rather than of 
+ * the executor that happens to run the txn, so a replayed txn draws the same 
+ * numbers (see txn::log_params). 
+ */
 int mv_action::rand()
 {
-        return exec->gen_random();
+        draws += 1;
+        return (int)(Hash128to64(std::make_pair(__version, (uint64_t)draws)) 
+                     >> 33);
+}
+
+void mv_action::abort()
+{
+        __aborted = true;
 }
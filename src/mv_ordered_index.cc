@@ -0,0 +1,244 @@
+#include <mv_ordered_index.h>
+#include <algorithm>
+#include <cstring>
+
+MVOrderedIndex::MVOrderedIndex(int cpu)
+{
+        this->cpu = cpu;
+        this->chunk = NULL;
+        this->chunkUsed = MV_BTREE_CHUNK;
+        this->numKeys = 0;
+        this->depth = 0;
+        this->root = &NewLeaf()->header;
+}
+
+void* MVOrderedIndex::AllocNode(uint64_t size)
+{
+        void *ret;
+
+        size = (size + CACHE_LINE - 1) & ~((uint64_t)CACHE_LINE - 1);
+        assert(size <= MV_BTREE_CHUNK);
+        if (chunkUsed + size > MV_BTREE_CHUNK) {
+                chunk = (char*)alloc_mem(MV_BTREE_CHUNK, cpu);
+                assert(chunk != NULL);
+                chunkUsed = 0;
+        }
+        ret = &chunk[chunkUsed];
+        chunkUsed += size;
+        memset(ret, 0x0, size);
+        return ret;
+}
+
+MVBTreeLeaf* MVOrderedIndex::NewLeaf()
+{
+        MVBTreeLeaf *leaf;
+
+        leaf = (MVBTreeLeaf*)AllocNode(sizeof(MVBTreeLeaf));
+        leaf->header.isLeaf = 1;
+        return leaf;
+}
+
+MVBTreeInner* MVOrderedIndex::NewInner()
+{
+        return (MVBTreeInner*)AllocNode(sizeof(MVBTreeInner));
+}
+
+uint64_t MVOrderedIndex::Size()
+{
+        return numKeys;
+}
+
+static inline void leaf_put(MVBTreeLeaf *leaf, uint32_t pos, uint64_t key,
+                            uint64_t hash)
+{
+        uint32_t count;
+
+        count = leaf->header.count;
+        memmove(&leaf->keys[pos+1], &leaf->keys[pos],
+                sizeof(uint64_t)*(count - pos));
+        memmove(&leaf->hashes[pos+1], &leaf->hashes[pos],
+                sizeof(uint64_t)*(count - pos));
+        leaf->keys[pos] = key;
+        leaf->hashes[pos] = hash;
+        leaf->header.count = count + 1;
+}
+
+/*
+ * Add key to the leaf. If the leaf is full it is split, and the new right
+ * sibling is returned along with its first key. A full leaf at the right
+ * edge of the tree that is appended to keeps all its keys, so keys added in
+ * increasing order (e.g. by a load) fill leaves up completely.
+ */
+MVBTreeHeader* MVOrderedIndex::InsertLeaf(MVBTreeLeaf *leaf, uint64_t key,
+                                          uint64_t hash, bool rightmost,
+                                          uint64_t *OUT_SEPARATOR)
+{
+        MVBTreeLeaf *sibling;
+        uint32_t pos, half;
+
+        pos = std::lower_bound(leaf->keys, leaf->keys + leaf->header.count,
+                               key) - leaf->keys;
+        assert(pos == leaf->header.count || leaf->keys[pos] != key);
+        if (leaf->header.count < MV_BTREE_LEAF_WIDTH) {
+                leaf_put(leaf, pos, key, hash);
+                return NULL;
+        }
+
+        sibling = NewLeaf();
+        if (rightmost && pos == leaf->header.count) {
+                leaf_put(sibling, 0, key, hash);
+        } else {
+                half = MV_BTREE_LEAF_WIDTH/2;
+                sibling->header.count = MV_BTREE_LEAF_WIDTH - half;
+                memcpy(sibling->keys, &leaf->keys[half],
+                       sizeof(uint64_t)*sibling->header.count);
+                memcpy(sibling->hashes, &leaf->hashes[half],
+                       sizeof(uint64_t)*sibling->header.count);
+                leaf->header.count = half;
+                if (pos <= half)
+                        leaf_put(leaf, pos, key, hash);
+                else
+                        leaf_put(sibling, pos - half, key, hash);
+        }
+        sibling->next = leaf->next;
+        leaf->next = sibling;
+        *OUT_SEPARATOR = sibling->keys[0];
+        return &sibling->header;
+}
+
+/*
+ * Add separator at pos, with child to its right. A full node is split like a
+ * leaf, the key between the two halves moves up and is returned through
+ * OUT_SEPARATOR.
+ */
+MVBTreeHeader* MVOrderedIndex::InsertInner(MVBTreeInner *inner, uint32_t pos,
+                                           uint64_t separator,
+                                           MVBTreeHeader *child,
+                                           bool rightmost,
+                                           uint64_t *OUT_SEPARATOR)
+{
+        uint64_t keys[MV_BTREE_INNER_WIDTH+1];
+        MVBTreeHeader *children[MV_BTREE_INNER_WIDTH+2];
+        MVBTreeInner *sibling;
+        uint32_t count, mid;
+
+        count = inner->header.count;
+        if (count < MV_BTREE_INNER_WIDTH) {
+                memmove(&inner->keys[pos+1], &inner->keys[pos],
+                        sizeof(uint64_t)*(count - pos));
+                memmove(&inner->children[pos+2], &inner->children[pos+1],
+                        sizeof(MVBTreeHeader*)*(count - pos));
+                inner->keys[pos] = separator;
+                inner->children[pos+1] = child;
+                inner->header.count = count + 1;
+                return NULL;
+        }
+
+        sibling = NewInner();
+        if (rightmost && pos == count) {
+                sibling->children[0] = child;
+                *OUT_SEPARATOR = separator;
+                return &sibling->header;
+        }
+        memcpy(keys, inner->keys, sizeof(uint64_t)*pos);
+        keys[pos] = separator;
+        memcpy(&keys[pos+1], &inner->keys[pos], sizeof(uint64_t)*(count - pos));
+        memcpy(children, inner->children, sizeof(MVBTreeHeader*)*(pos + 1));
+        children[pos+1] = child;
+        memcpy(&children[pos+2], &inner->children[pos+1],
+               sizeof(MVBTreeHeader*)*(count - pos));
+
+        mid = (MV_BTREE_INNER_WIDTH + 1)/2;
+        inner->header.count = mid;
+        memcpy(inner->keys, keys, sizeof(uint64_t)*mid);
+        memcpy(inner->children, children, sizeof(MVBTreeHeader*)*(mid + 1));
+        sibling->header.count = MV_BTREE_INNER_WIDTH - mid;
+        memcpy(sibling->keys, &keys[mid+1],
+               sizeof(uint64_t)*sibling->header.count);
+        memcpy(sibling->children, &children[mid+1],
+               sizeof(MVBTreeHeader*)*(sibling->header.count + 1));
+        *OUT_SEPARATOR = keys[mid];
+        return &sibling->header;
+}
+
+void MVOrderedIndex::Insert(uint64_t key, uint64_t hash)
+{
+        MVBTreeInner *path[MV_BTREE_MAX_DEPTH], *inner, *new_root;
+        uint32_t slots[MV_BTREE_MAX_DEPTH], level;
+        bool rightmost[MV_BTREE_MAX_DEPTH+1];
+        MVBTreeHeader *node, *split;
+        uint64_t separator;
+
+        node = root;
+        rightmost[0] = true;
+        for (level = 0; level < depth; ++level) {
+                inner = (MVBTreeInner*)node;
+                path[level] = inner;
+                slots[level] = std::upper_bound(inner->keys,
+                                                inner->keys + inner->header.count,
+                                                key) - inner->keys;
+                rightmost[level+1] = rightmost[level] &&
+                        slots[level] == inner->header.count;
+                node = inner->children[slots[level]];
+        }
+        assert(node->isLeaf);
+        split = InsertLeaf((MVBTreeLeaf*)node, key, hash, rightmost[depth],
+                           &separator);
+        while (split != NULL && level > 0) {
+                level -= 1;
+                split = InsertInner(path[level], slots[level], separator, split,
+                                    rightmost[level], &separator);
+        }
+        if (split != NULL) {
+                assert(depth + 1 < MV_BTREE_MAX_DEPTH);
+                new_root = NewInner();
+                new_root->header.count = 1;
+                new_root->keys[0] = separator;
+                new_root->children[0] = root;
+                new_root->children[1] = split;
+                root = &new_root->header;
+                depth += 1;
+        }
+        numKeys += 1;
+}
+
+void MVOrderedIndex::Remove(uint64_t key)
+{
+        MVBTreeCursor cursor;
+        MVBTreeLeaf *leaf;
+        uint32_t count;
+
+        cursor = Seek(key);
+        leaf = cursor.leaf;
+        count = leaf->header.count;
+        assert(cursor.pos < count && leaf->keys[cursor.pos] == key);
+        memmove(&leaf->keys[cursor.pos], &leaf->keys[cursor.pos+1],
+                sizeof(uint64_t)*(count - cursor.pos - 1));
+        memmove(&leaf->hashes[cursor.pos], &leaf->hashes[cursor.pos+1],
+                sizeof(uint64_t)*(count - cursor.pos - 1));
+        leaf->header.count = count - 1;
+        numKeys -= 1;
+}
+
+MVBTreeCursor MVOrderedIndex::Seek(uint64_t key)
+{
+        MVBTreeHeader *node;
+        MVBTreeInner *inner;
+        MVBTreeLeaf *leaf;
+        MVBTreeCursor cursor;
+        uint32_t pos;
+
+        node = root;
+        while (!node->isLeaf) {
+                inner = (MVBTreeInner*)node;
+                pos = std::upper_bound(inner->keys,
+                                       inner->keys + inner->header.count,
+                                       key) - inner->keys;
+                node = inner->children[pos];
+        }
+        leaf = (MVBTreeLeaf*)node;
+        cursor.leaf = leaf;
+        cursor.pos = std::lower_bound(leaf->keys, leaf->keys + leaf->header.count,
+                                      key) - leaf->keys;
+        return cursor;
+}
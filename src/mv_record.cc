@@ -2,55 +2,55 @@
 #include <cstdlib>
 #include <cpuinfo.h>
 #include <iostream>
+#include <algorithm>
 
 uint64_t _MVRecord_::INFINITY = 0xFFFFFFFFFFFFFFFF;
+bool _MVRecord_::INLINE_VALUES = false;
 
 MVRecordAllocator::MVRecordAllocator(uint64_t size, int cpu, int worker_start, int worker_end) {
         //  std::cout << "NUMA node: " << numa_node_of_cpu(cpu) << "\n";
         worker_start += 1;
         worker_end += 1;
-  if (size < 1) {
-    size = 1;
+  if (size < MVRecord::HeaderSize()) {
+    size = MVRecord::HeaderSize();
   }
-  MVRecord *data = (MVRecord*)alloc_mem(size, cpu);
-  assert(data != NULL);
-  memset(data, 0x0, size);
+  assert(offsetof(MVRecord, writer) == CACHE_LINE);
+  assert(sizeof(MVRecord) <= MV_INLINE_HEADER_SIZE);
         
   this->size = size;
   this->count = 0;
-  uint64_t numRecords = size/sizeof(MVRecord);
-  
-  uint64_t recordDataSize = recordSize*numRecords;
-  //  std::cout << "Record size: " << recordSize << "\nRecord data size: " << recordDataSize << "\n";
-  //  std::cout << "Worker start:" << worker_start << " Worker end: " << worker_end << "\n";
-  //  std::cout << "Cpus: " << numa_num_configured_cpus() << "\n";
-  //    char *recordData = NULL;
-  //  int cntr = 0;
-  //  while (recordData == NULL) {
-  //          recordData = (char*)alloc_interleaved(recordDataSize, worker_start, worker_end+cntr*10);
-  //          ++cntr;
-  //  }
-  //  char *recordData = (char*)alloc_interleaved(recordDataSize, worker_start+10, 79);
+  this->capacity = 0;
+  this->cpu = cpu;
+  this->grown = 0;
+  this->freeList = NULL;
+  AddChunk(size);
+}
 
-  //  char *recordData = (char*)alloc_mem(recordDataSize, 19);
+void MVRecordAllocator::AddChunk(uint64_t size) {
+  char *data = (char*)alloc_mem(size, cpu);
+  assert(data != NULL);
+  memset(data, 0x0, size);
+  uint64_t stride = MVRecord::HeaderSize();
+  uint64_t numRecords = size/stride;
+  assert(numRecords > 0);
   
-    char *recordData = (char*)alloc_interleaved_all(recordDataSize);
-  //char *recordData = (char*)alloc_mem(recordDataSize, recordCpu);
-
-  //  char *recordData = (char*)alloc_interleaved(recordDataSize, worker_start, 79);
-    assert(recordData != NULL);
-    memset(recordData, 0xA3, recordDataSize);
-  //  std::cout << "Done initializing record data\n";
-  //  uint64_t endIndex = numRecords-1;
+  // Headers are stride bytes apart, see MVRecord::HeaderSize.
   for (uint64_t i = 0; i < numRecords; ++i) {
-    data[i].allocLink = &data[i+1];
-    //data[i].value = NULL;
-    data[i].value = (Record*)(&recordData[i*recordSize]);
-    data[i].writer = NULL;
-    this->count += 1;
+    MVRecord *rec = (MVRecord*)&data[i*stride];
+    rec->allocLink = (MVRecord*)&data[(i+1)*stride];
+    rec->value = NULL;
+    rec->writer = NULL;
   }
-  data[numRecords-1].allocLink = NULL;
-  freeList = data;
+  ((MVRecord*)&data[(numRecords-1)*stride])->allocLink = freeList;
+  freeList = (MVRecord*)data;
+  this->count += numRecords;
+  this->capacity += numRecords;
+}
+
+void MVRecordAllocator::Grow() {
+  uint64_t chunk = std::max(size/8, 1024*MVRecord::HeaderSize());
+  AddChunk(chunk);
+  this->grown += chunk;
 }
 
 void MVRecordAllocator::WriteAllocator() {
@@ -84,7 +84,9 @@ bool MVRecordAllocator::GetRecord(MVRecord **OUT_recordPtr) {
   ret->allocLink = NULL;
   ret->epoch_ancestor = NULL;
   ret->writer = NULL;
-  //  ret->value = NULL;
+  ret->value = NULL;
+  ret->tombstone = false;
+  ret->deltaState = DELTA_NONE;
   *OUT_recordPtr = ret;
   count -= 1;
   return true;
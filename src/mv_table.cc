@@ -36,12 +36,31 @@ bool MVTable::WriteNewVersion(uint32_t partition, CompositeKey &pkey,
 
 MVTablePartition::MVTablePartition(uint64_t size, 
                                    int cpu,
-                                   MVRecordAllocator *alloc) {
+                                   MVRecordAllocator *alloc,
+                                   MVIndexType indexType,
+                                   bool ordered) {
   if (size < 1) {
     size = 1;
   }
   this->numSlots = size;
   this->allocator = alloc;
+  this->indexType = indexType;
+  this->tableSlots = NULL;
+  this->index8 = NULL;
+  this->index16 = NULL;
+  this->ordered = NULL;
+  if (ordered) {
+    this->ordered = new (cpu) MVOrderedIndex(cpu);
+  }
+
+  if (indexType == MV_INDEX_FINGERPRINT8) {
+    this->index8 = new (cpu) MVFingerprintIndex<uint8_t>(size, cpu);
+    return;
+  } else if (indexType == MV_INDEX_FINGERPRINT16) {
+    this->index16 = new (cpu) MVFingerprintIndex<uint16_t>(size, cpu);
+    return;
+  }
+  assert(indexType == MV_INDEX_CHAINED);
         
   // Allocate a contiguous chunk of memory in which to store the table's slots
   this->tableSlots = (MVRecord**)alloc_mem(sizeof(MVRecord*)*size, cpu);
@@ -53,29 +72,196 @@ MVTablePartition::MVTablePartition(uint64_t size,
 
 MVRecord* MVTablePartition::GetMVRecord(const CompositeKey &pkey, 
                                         uint64_t version) {
-  // Get the slot number the record hashes to, and try to find if a previous
-  // version of the record already exists.
-  uint64_t slotNumber = CompositeKey::Hash(&pkey) % numSlots;
-  MVRecord *cur = tableSlots[slotNumber];
+  return GetMVRecord(pkey.key, CompositeKey::Hash(&pkey), version);
+}
 
+/*
+ * Return a reference to the pointer holding key's newest version. If the key 
+ * is absent, return NULL, or if insert is set, a reference to a NULL pointer 
+ * where the key's first version should be installed.
+ */
+MVRecord** MVTablePartition::GetHeadRef(uint64_t key, uint64_t hash, 
+                                        bool insert) {
+  if (indexType == MV_INDEX_FINGERPRINT8) {
+    return insert? index8->Upsert(key, hash) : index8->Find(key, hash);
+  } else if (indexType == MV_INDEX_FINGERPRINT16) {
+    return insert? index16->Upsert(key, hash) : index16->Find(key, hash);
+  }
+
+  uint64_t slotNumber = hash % numSlots;
+  MVRecord **prev = &tableSlots[slotNumber];
+  MVRecord *cur = *prev;
   while (cur != NULL) {
-                
-    // We found the record. Link to the old record.
-    if (cur->key == pkey.key) {
-      while (cur != NULL && cur->deleteTimestamp > version) {
-        // Found a valid version
-        if (cur->createTimestamp <= version && cur->deleteTimestamp > version) {
-          return cur;
-        }
-        cur = cur->recordLink;
-      }
-      break;
+    if (cur->key == key) {
+      return prev;
     }
+    prev = &cur->link;
     cur = cur->link;
   }
+  return insert? prev : NULL;
+}
+
+MVRecord* MVTablePartition::GetMVRecord(uint64_t key, uint64_t hash, 
+                                        uint64_t version) {
+  // Find the newest version of the record, then walk back to the version 
+  // visible at the given timestamp.
+  MVRecord **head = GetHeadRef(key, hash, false);
+  MVRecord *cur = head == NULL? NULL : *head;
+
+  while (cur != NULL && cur->deleteTimestamp > version) {
+    // Found a valid version
+    if (cur->createTimestamp <= version && cur->deleteTimestamp > version) {
+      return cur;
+    }
+    cur = cur->recordLink;
+  }
   return NULL;
 }
 
+/*
+ * A dead key's index entry goes in two steps. Once the low watermark has 
+ * passed the tombstone's epoch, every txn and snapshot reader that could 
+ * still see an older version is done, and the key is unlinked from the index 
+ * (and the ordered index): from then on it is absent rather than deleted. 
+ * Txns scheduled before that may still hold the tombstone in their read-sets, 
+ * so it goes back to the allocator only once the watermark has passed the 
+ * epoch it was unlinked in too. A tombstone that has been superseded by a 
+ * later write is left alone, it is collected as that write's predecessor.
+ */
+uint32_t MVTablePartition::ReclaimDeadKeys(uint32_t low_watermark, 
+                                           uint32_t epoch) {
+  MVRecordList freed;
+  MVDeadKey dead;
+  MVRecord **head;
+  uint32_t count;
+
+  freed.head = NULL;
+  freed.tail = &freed.head;
+  freed.count = 0;
+  while (!unlinkedKeys.empty() && 
+         (unlinkedKeys.front().timestamp >> 32) <= low_watermark) {
+    dead = unlinkedKeys.front();
+    unlinkedKeys.pop_front();
+    dead.tombstone->allocLink = NULL;
+    *freed.tail = dead.tombstone;
+    freed.tail = &dead.tombstone->allocLink;
+    freed.count += 1;
+  }
+  if (freed.count > 0) {
+    allocator->ReturnMVRecords(freed);
+  }
+
+  count = 0;
+  while (!deadKeys.empty() && 
+         (deadKeys.front().timestamp >> 32) <= low_watermark) {
+    dead = deadKeys.front();
+    deadKeys.pop_front();
+
+    // The version may have been collected and reused since, only its 
+    // timestamp tells.
+    head = GetHeadRef(dead.key, dead.hash, false);
+    if (head == NULL || *head != dead.tombstone || 
+        dead.tombstone->createTimestamp != dead.timestamp) {
+      continue;
+    }
+    assert(dead.tombstone->tombstone);
+    *head = dead.tombstone->link;
+    if (ordered != NULL) {
+      ordered->Remove(dead.key);
+    }
+    dead.timestamp = CREATE_MV_TIMESTAMP(epoch, 0);
+    unlinkedKeys.push_back(dead);
+    count += 1;
+  }
+  return count;
+}
+
+/*
+ * Walk the ordered index from start, a window of keys at a time, pipelined 
+ * like the CC threads' key streams: the index entries of the next window are 
+ * prefetched before the head versions of the current one, whose entries were 
+ * requested a window earlier, and only then are its keys resolved. A key 
+ * without a version visible at the timestamp, or deleted as of it, is 
+ * skipped.
+ */
+uint32_t MVTablePartition::ScanRange(uint64_t start, uint64_t end, 
+                                     uint32_t limit, uint64_t version, 
+                                     MVRecord **OUT_VERSIONS) {
+  uint64_t keys[2][MV_SCAN_WINDOW], hashes[2][MV_SCAN_WINDOW];
+  uint32_t count, fetched[2], cur, prev, i;
+  MVBTreeCursor cursor;
+  MVRecord *rec;
+  bool done;
+
+  assert(ordered != NULL);
+  cursor = ordered->Seek(start);
+  count = 0;
+  done = false;
+  cur = 0;
+  fetched[0] = 0;
+  fetched[1] = 0;
+  while (true) {
+    prev = cur ^ 1;
+    fetched[cur] = 0;
+    while (!done && fetched[cur] < MV_SCAN_WINDOW && 
+           count + fetched[prev] + fetched[cur] < limit) {
+      i = fetched[cur];
+      if (!ordered->Next(&cursor, &keys[cur][i], &hashes[cur][i]) ||
+          keys[cur][i] >= end) {
+        done = true;
+        break;
+      }
+      Prefetch(hashes[cur][i]);
+      fetched[cur] += 1;
+    }
+    if (fetched[prev] == 0 && fetched[cur] == 0)
+      break;
+    for (i = 0; i < fetched[prev]; ++i) {
+      PrefetchHead(hashes[prev][i]);
+    }
+    for (i = 0; i < fetched[prev] && count < limit; ++i) {
+      rec = GetMVRecord(keys[prev][i], hashes[prev][i], version);
+      if (rec != NULL && !rec->tombstone) {
+        OUT_VERSIONS[count++] = rec;
+      }
+    }
+    cur = prev;
+  }
+  return count;
+}
+
+uint64_t MVTablePartition::IndexSize() {
+  if (indexType == MV_INDEX_FINGERPRINT8)
+    return index8->NumBuckets();
+  else if (indexType == MV_INDEX_FINGERPRINT16)
+    return index16->NumBuckets();
+  return numSlots;
+}
+
+/*
+ * The CC thread publishes a new head only once it is fully set up, and a 
+ * replaced head keeps its link, so a walk that races with writes sees each 
+ * key once, through either its old or its new head.
+ */
+void MVTablePartition::GetHeads(uint64_t start, uint64_t end, 
+                                std::vector<MVRecord*> *OUT_HEADS) {
+  uint64_t i;
+  MVRecord *cur;
+
+  assert(start <= end && end <= IndexSize());
+  for (i = start; i < end; ++i) {
+    if (indexType == MV_INDEX_FINGERPRINT8) {
+      index8->GetHeads(i, OUT_HEADS);
+    } else if (indexType == MV_INDEX_FINGERPRINT16) {
+      index16->GetHeads(i, OUT_HEADS);
+    } else {
+      for (cur = tableSlots[i]; cur != NULL; cur = cur->link) {
+        OUT_HEADS->push_back(cur);
+      }
+    }
+  }
+}
+
 /*
 bool MVTablePartition::GetVersion(const CompositeKey &pkey, uint64_t version, 
                                   Record *OUT_rec) {
@@ -156,6 +342,13 @@ bool MVTablePartition::GetLatestVersion(const CompositeKey &pkey,
  */
 bool MVTablePartition::WriteNewVersion(CompositeKey &pkey, mv_action *action, 
                                        uint64_t version) {
+  return WriteNewVersion(pkey.key, CompositeKey::Hash(&pkey), action, version,
+                         &pkey.value);
+}
+
+bool MVTablePartition::WriteNewVersion(uint64_t key, uint64_t hash, 
+                                       mv_action *action, uint64_t version,
+                                       MVRecord **OUT_RECORD, uint8_t flags) {
 
   // Allocate an MVRecord to hold the new record.
   MVRecord *toAdd;
@@ -166,31 +359,46 @@ bool MVTablePartition::WriteNewVersion(CompositeKey &pkey, mv_action *action,
   toAdd->createTimestamp = version;
   toAdd->deleteTimestamp = MVRecord::INFINITY;
   toAdd->writer = action;
-  toAdd->key = pkey.key;  
+  toAdd->key = key;  
+  toAdd->tombstone = (flags & KEY_STREAM_DELETE) != 0;
 
-  // Get the slot number the record hashes to, and try to find if a mvprevious
-  // version of the record already exists.
-  uint64_t slotNumber = CompositeKey::Hash(&pkey) % numSlots;
-  MVRecord *cur = tableSlots[slotNumber];
-  MVRecord **prev = &tableSlots[slotNumber];
+  // Find if a previous version of the record already exists. If so, the new 
+  // version takes its place in the index and links to it.
+  MVRecord **head = GetHeadRef(key, hash, true);
+  MVRecord *cur = *head;
   uint64_t epoch = GET_MV_EPOCH(version);
   
-  while (cur != NULL) {                
-    // We found the record. Link to the old record.
-    if (cur->key == pkey.key) {
-      toAdd->link = cur->link;
-      toAdd->recordLink = cur;
-      if (GET_MV_EPOCH(cur->createTimestamp) == epoch)
-              toAdd->epoch_ancestor = cur->epoch_ancestor;
-      else
-              toAdd->epoch_ancestor = cur;
-      break;
-    }
+  if (cur == NULL && ordered != NULL) {
+    ordered->Insert(key, hash);
+  }
+  
+  if ((flags & KEY_STREAM_RMW) && (cur == NULL || cur->tombstone)) {
+    toAdd->tombstone = true;
+  }
 
-    prev = &cur->link;
-    cur = cur->link;
+  // An increment of an absent key is a tombstone like any other RMW of one.
+  if ((flags & KEY_STREAM_INCR) && !toAdd->tombstone) {
+    toAdd->deltaState = DELTA_PENDING;
+  }
+  
+  if (cur != NULL) {
+    cur->deleteTimestamp = version;
+    toAdd->link = cur->link;
+    toAdd->recordLink = cur;
+    if (GET_MV_EPOCH(cur->createTimestamp) == epoch)
+            toAdd->epoch_ancestor = cur->epoch_ancestor;
+    else
+            toAdd->epoch_ancestor = cur;
+  }
+
+  // Snapshot readers walk the index concurrently, publish the version only 
+  // once it is fully set up.
+  barrier();
+  *head = toAdd;
+  *OUT_RECORD = toAdd;
+  if (toAdd->tombstone) {
+    MVDeadKey dead = {toAdd, version, key, hash};
+    deadKeys.push_back(dead);
   }
-  *prev = toAdd;
-  pkey.value = toAdd;
   return true;
 }
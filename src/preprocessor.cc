@@ -1,4 +1,5 @@
 #include <preprocessor.h>
+#include <algorithm>
 
 uint32_t MVActionDistributor::NUM_CC_THREADS = 1;
 
@@ -24,71 +25,343 @@ MVActionDistributor::MVActionDistributor(MVActionDistributorConfig config) :
   
   this->config = config;
   this->leader = config.subQueues != NULL;
+  this->lowWaterMark = NULL;
+  this->restartQueues = NULL;
+  this->numRestartQueues = 0;
+  this->epoch = 1;
 
+  /* Start with one contiguous run of virtual partitions per CC thread. */
+  this->owners = (uint32_t*)alloc_mem(sizeof(uint32_t)*NUM_VPARTS, 
+                                      config.cpuNumber);
+  this->loads = (uint64_t*)alloc_mem(sizeof(uint64_t)*NUM_VPARTS, 
+                                     config.cpuNumber);
+  assert(this->owners != NULL && this->loads != NULL);
+  for (uint32_t i = 0; i < NUM_VPARTS; ++i)
+    this->owners[i] = i / (NUM_VPARTS / NUM_CC_THREADS);
+  memset(this->loads, 0x0, sizeof(uint64_t)*NUM_VPARTS);
+  this->repartitionInterval = 0;
+  this->numCounted = 0;
+  this->loaded = false;
 }
 
 /*
- * Hash the given key, and find which concurrency control thread is
- * responsible for the appropriate key range. 
+ * Find which concurrency control thread is responsible for the given key in 
+ * the batch's epoch, set by BuildStreams. Executors use the same id to hand 
+ * superseded versions back to a CC thread: the key's current owner, which is 
+ * not the one that allocated them if the key's partition has moved since. 
+ * Allocators simply trade version headers with the partitions they own.
  */
 uint32_t MVActionDistributor::GetCCThread(CompositeKey& key) 
 {
-        uint64_t hash = CompositeKey::Hash(&key);
-        return (uint32_t)(hash % NUM_CC_THREADS);
-}
-
-// Output to concurrency control layer:
-// Batch of txns that are guaranteed to contain read/write elements that 
-// are relevant to the thread
-//
-// List of ints that refer to the index within the writeset/readset of 
-// the specific composite keys that we care about, ordered in the same
-// order as the batch
-
-// Constructing a new thing to pass: the txn is included but can it be modified?
-// Why not? 
-void MVActionDistributor::ProcessAction(mv_action * action, int* last_actions, mv_action ** batch, int index) {
-  int cc_threads[NUM_CC_THREADS] = {-1};
-  int keys[NUM_CC_THREADS];
-
-  for (int i = 0; i < NUM_CC_THREADS; i++) {
-    keys[i] = -1;
-  }
+        assert(key.threadId < NUM_CC_THREADS);
+        return key.threadId;
+}
 
-  for(int i = 0; i < action->__readset.size(); i++) {
-    int partition = GetCCThread(action->__readset[i]);
-    cc_threads[partition] = 1;
-    int index = keys[partition];
-    if (index == -1) {
-      action->__read_starts[partition] = i;
-    } else {
-      action->__readset[index].next = i;
-    }
-    keys[partition] = i;
-  }
+static void alloc_stream(KeyStream *stream, uint32_t count)
+{
+        size_t entry_sz;
+        char *data;
 
-  for (int i = 0; i < NUM_CC_THREADS; i++) {
-    keys[i] = -1;
-  }
+        stream->count = 0;
+        if (count == 0) {
+                memset(stream, 0x0, sizeof(KeyStream));
+                return;
+        }
+        entry_sz = 3*sizeof(uint64_t) + 2*sizeof(uint32_t) + sizeof(uint8_t);
+        data = (char*)malloc(entry_sz*count);
+        assert(data != NULL);
+        stream->keys = (uint64_t*)data;
+        stream->hashes = (uint64_t*)&stream->keys[count];
+        stream->slots = (MVRecord***)&stream->hashes[count];
+        stream->txns = (uint32_t*)&stream->slots[count];
+        stream->tables = &stream->txns[count];
+        stream->flags = (uint8_t*)&stream->tables[count];
+}
 
-  for(int i = 0; i < action->__writeset.size(); i++) {
-    int partition = GetCCThread(action->__writeset[i]);
-    cc_threads[partition] = 1;
-    int index = keys[partition];
-    if (index != -1) {
-      action->__writeset[index].next = i;
-    } else {
-      action->__write_starts[partition] = i;
-    }
-    keys[partition] = i;
-  }
+static inline void append_stream(KeyStream *stream, uint32_t txn, 
+                                 CompositeKey *key, uint8_t flags)
+{
+        uint32_t i = stream->count;
+        stream->txns[i] = txn;
+        stream->tables[i] = key->tableId;
+        stream->keys[i] = key->key;
+        stream->hashes[i] = key->hash;
+        stream->flags[i] = flags;
+        stream->slots[i] = &key->value;
+        stream->count = i + 1;
+}
 
-  for(int i = 0; i < NUM_CC_THREADS; i++) {
-    if (cc_threads[i] == 1) {
-      batch[last_actions[i]]->__nextAction[i] = index;
-      last_actions[i] = index;
-    }
-  }
+/* A range read is resolved by every CC thread, the entry names the range. */
+static inline void append_range(KeyStream *stream, uint32_t txn, 
+                                uint32_t index, MVRangeRead *range)
+{
+        uint32_t i = stream->count;
+        stream->txns[i] = txn;
+        stream->tables[i] = range->tableId;
+        stream->keys[i] = index;
+        stream->hashes[i] = 0;
+        stream->flags[i] = KEY_STREAM_RANGE;
+        stream->slots[i] = NULL;
+        stream->count = i + 1;
+}
+
+/* 
+ * Key of the batch's epoch: route it to the owner of its virtual partition, 
+ * and count it against the partition. 
+ */
+static inline uint32_t assign_owner(const ActionBatch *batch, 
+                                    CompositeKey *key)
+{
+        key->threadId = batch->owners[key->vpart];
+        batch->loads[key->vpart] += 1;
+        return key->threadId;
+}
+
+/*
+ * Split the batch's keys into one KeyStream per CC thread. The first pass 
+ * assigns every key its CC thread and sizes each stream, the second fills 
+ * them in timestamp order. The streams are released by the CC threads once 
+ * they have been scheduled.
+ */
+void MVActionDistributor::BuildStreams(ActionBatch *batch) 
+{
+        uint32_t counts[NUM_CC_THREADS], i, j, k, num_reads, num_writes, 
+                num_ranges;
+        KeyStream *streams;
+        mv_action *action;
+        uint8_t flags;
+
+        memset(counts, 0x0, sizeof(counts));
+        for (i = 0; i < batch->numActions; ++i) {
+                action = batch->actionBuf[i];
+                num_reads = action->__readset.size();
+                num_writes = action->__writeset.size();
+                for (j = 0; j < num_reads; ++j) 
+                        counts[assign_owner(batch, 
+                                            &action->__readset[j])] += 1;
+                for (j = 0; j < num_writes; ++j) 
+                        counts[assign_owner(batch, 
+                                            &action->__writeset[j])] += 1;
+                for (j = 0; j < NUM_CC_THREADS; ++j) 
+                        counts[j] += action->__numRanges;
+        }
+
+        streams = (KeyStream*)malloc(sizeof(KeyStream)*NUM_CC_THREADS);
+        assert(streams != NULL);
+        for (i = 0; i < NUM_CC_THREADS; ++i) 
+                alloc_stream(&streams[i], counts[i]);
+        
+        for (i = 0; i < batch->numActions; ++i) {
+                action = batch->actionBuf[i];
+                num_reads = action->__readset.size();
+                num_writes = action->__writeset.size();
+                num_ranges = action->__numRanges;
+                for (j = 0; j < num_reads; ++j) 
+                        append_stream(&streams[GetCCThread(action->__readset[j])], 
+                                      i, &action->__readset[j], 0);
+                for (j = 0; j < num_ranges; ++j) 
+                        for (k = 0; k < NUM_CC_THREADS; ++k) 
+                                append_range(&streams[k], i, j, 
+                                             &action->__ranges[j]);
+                for (j = 0; j < num_writes; ++j) {
+                        flags = KEY_STREAM_WRITE;
+                        if (action->__writeset[j].is_rmw)
+                                flags |= KEY_STREAM_RMW;
+                        if (action->__writeset[j].is_delete)
+                                flags |= KEY_STREAM_DELETE;
+                        if (action->__writeset[j].is_incr)
+                                flags |= KEY_STREAM_INCR;
+                        append_stream(&streams[GetCCThread(action->__writeset[j])], 
+                                      i, &action->__writeset[j], flags);
+                }
+        }
+        batch->streams = streams;
+}
+
+/* 
+ * Take the txns the executors resubmit (see Executor::Resubmit), one queue 
+ * per executor. 
+ */
+void MVActionDistributor::SetRestarts(volatile uint32_t *lowWaterMark,
+                                      SimpleQueue<RestartedTxn> *queues, 
+                                      uint32_t numQueues)
+{
+        this->lowWaterMark = lowWaterMark;
+        this->restartQueues = queues;
+        this->numRestartQueues = numQueues;
+}
+
+/* Rebalance virtual partitions every interval batches, 0 never does. */
+void MVActionDistributor::SetRepartitioning(uint32_t interval)
+{
+        this->repartitionInterval = interval;
+}
+
+/* 
+ * Hand the batch the current owners of the virtual partitions, and room to 
+ * count its keys in each. The CC threads free both with the streams.
+ */
+void MVActionDistributor::AssignOwners(ActionBatch *batch)
+{
+        uint32_t *map;
+
+        map = (uint32_t*)malloc(2*sizeof(uint32_t)*NUM_VPARTS);
+        assert(map != NULL);
+        memcpy(map, owners, sizeof(uint32_t)*NUM_VPARTS);
+        memset(&map[NUM_VPARTS], 0x0, sizeof(uint32_t)*NUM_VPARTS);
+        batch->owners = map;
+        batch->loads = &map[NUM_VPARTS];
+}
+
+/* 
+ * Add a batch whose streams are built to the partitions' loads, in epoch 
+ * order. The load batch says nothing about the workload and is left out.
+ */
+void MVActionDistributor::CountLoads(const ActionBatch &batch)
+{
+        uint32_t i;
+
+        if (repartitionInterval == 0)
+                return;
+        if (!loaded) {
+                loaded = true;
+                return;
+        }
+        for (i = 0; i < NUM_VPARTS; ++i)
+                loads[i] += batch.loads[i];
+        numCounted += 1;
+        if (numCounted == repartitionInterval) {
+                Repartition();
+                memset(loads, 0x0, sizeof(uint64_t)*NUM_VPARTS);
+                numCounted = 0;
+        }
+}
+
+/*
+ * Move virtual partitions off the CC thread with the most keys to the one 
+ * with the fewest while the busiest is more than MV_REPARTITION_SLACK percent 
+ * above the average, the largest partition that lowers the busier thread's 
+ * load first. Every move strictly evens out the two threads, so this ends. 
+ * A partition's keys move with it, the index is handed over as it is.
+ */
+void MVActionDistributor::Repartition()
+{
+        uint64_t thread_loads[NUM_CC_THREADS], total, best;
+        uint32_t i, busy, idle, vpart, moves;
+
+        memset(thread_loads, 0x0, sizeof(thread_loads));
+        total = 0;
+        for (i = 0; i < NUM_VPARTS; ++i) {
+                thread_loads[owners[i]] += loads[i];
+                total += loads[i];
+        }
+        for (moves = 0; moves < NUM_VPARTS; ++moves) {
+                busy = 0;
+                idle = 0;
+                for (i = 1; i < NUM_CC_THREADS; ++i) {
+                        if (thread_loads[i] > thread_loads[busy])
+                                busy = i;
+                        if (thread_loads[i] < thread_loads[idle])
+                                idle = i;
+                }
+                if (100*thread_loads[busy]*NUM_CC_THREADS <= 
+                    (100 + MV_REPARTITION_SLACK)*total)
+                        break;
+                vpart = NUM_VPARTS;
+                best = 0;
+                for (i = 0; i < NUM_VPARTS; ++i) 
+                        if (owners[i] == busy && loads[i] > best &&
+                            thread_loads[idle] + loads[i] < 
+                            thread_loads[busy]) {
+                                vpart = i;
+                                best = loads[i];
+                        }
+                if (vpart == NUM_VPARTS)
+                        break;
+                owners[vpart] = idle;
+                thread_loads[busy] -= best;
+                thread_loads[idle] += best;
+        }
+}
+
+void MVActionDistributor::DrainRestarts()
+{
+        RestartedTxn restart;
+        uint32_t i;
+
+        for (i = 0; i < numRestartQueues; ++i) 
+                while (restartQueues[i].Dequeue(&restart))
+                        restarts.push_back(restart);
+}
+
+static bool restart_order(const RestartedTxn &a, const RestartedTxn &b)
+{
+        return a.timestamp < b.timestamp;
+}
+
+/*
+ * Append the txns resubmitted in epoch (epoch - MV_RESTART_DELAY) or before 
+ * to the batch, in the order of the timestamps they last ran at, so where a 
+ * txn restarts does not depend on timing. Every such txn is in the queues 
+ * once that epoch has been executed; until then the batch is held back and 
+ * false is returned. Batches arrive in epoch order, starting with the load.
+ */
+bool MVActionDistributor::InjectRestarts(ActionBatch *batch)
+{
+        uint32_t source, num_restarts, num_actions, i;
+        mv_action **actions;
+        mv_action *action;
+        RestartedTxn *restart;
+
+        if (restartQueues == NULL)
+                return true;
+        assert(batch->numActions == 0 || 
+               (batch->actionBuf[0]->__version >> 32) == epoch);
+        DrainRestarts();
+        if (epoch <= MV_RESTART_DELAY) {
+                epoch += 1;
+                return true;
+        }
+        source = epoch - MV_RESTART_DELAY;
+        barrier();
+        if (*lowWaterMark < source)
+                return false;
+        barrier();
+        DrainRestarts();
+        std::sort(restarts.begin(), restarts.end(), restart_order);
+        num_restarts = 0;
+        while (num_restarts < restarts.size() && 
+               (restarts[num_restarts].timestamp >> 32) <= source)
+                num_restarts += 1;
+        if (num_restarts > 0) {
+                if (batch->arena == NULL)
+                        batch->arena = new ActionArena(num_restarts*
+                                                       (sizeof(mv_action) + 
+                                                        CACHE_LINE));
+                num_actions = batch->numActions;
+                actions = (mv_action**)
+                        batch->arena->Alloc(sizeof(mv_action*)*
+                                            (num_actions + num_restarts),
+                                            CACHE_LINE);
+                memcpy(actions, batch->actionBuf, 
+                       sizeof(mv_action*)*num_actions);
+                for (i = 0; i < num_restarts; ++i) {
+                        restart = &restarts[i];
+                        action = mv_action::generate(restart->t, batch->arena);
+                        action->__version = 
+                                CREATE_MV_TIMESTAMP(epoch, (num_actions + i));
+                        action->__restarts = restart->restarts;
+                        action->__firstEpoch = restart->firstEpoch;
+                        action->__firstAbort = restart->firstAbort;
+                        actions[num_actions + i] = action;
+                }
+                batch->actionBuf = actions;
+                batch->numActions = num_actions + num_restarts;
+                restarts.erase(restarts.begin(), 
+                               restarts.begin() + num_restarts);
+        }
+        epoch += 1;
+        return true;
 }
 
 void MVActionDistributor::StartWorking() {
@@ -97,19 +370,28 @@ void MVActionDistributor::StartWorking() {
     log("Leader thread started!");
     int pubindex = 0;
     int subindex = 0;
+    ActionBatch batch;
+    bool held = false;
     while (true) {
 
-      // See if there is a batch available from input...
-      ActionBatch batch;
-      if (config.inputQueue->Dequeue(&batch)) {
+      // See if there is a batch available from input, it may have to wait 
+      // for restarted txns
+      if (!held)
+        held = config.inputQueue->Dequeue(&batch);
+      if (!held) {
+        DrainRestarts();
+      } else if (InjectRestarts(&batch)) {
         // Send it round robin to the subordinate threads
+        AssignOwners(&batch);
         config.pubQueues[pubindex]->EnqueueBlocking(batch);
         pubindex = (pubindex + 1) % config.numSubords;
+        held = false;
       }
 
       // See if there is a batch available from subordinates...
       ActionBatch outBatch;
       if (config.subQueues[subindex]->Dequeue(&outBatch)) {
+        CountLoads(outBatch);
         config.outputQueue->EnqueueBlocking(outBatch);
         subindex = (subindex + 1) % config.numSubords;
       }
@@ -117,25 +399,19 @@ void MVActionDistributor::StartWorking() {
   } else {
     log("Subordinate thread started!");
     while (true) {
-      ActionBatch batch = config.inputQueue->DequeueBlocking();
-      mv_action** actions = batch.actionBuf;
-      uint32_t numActions = batch.numActions;
-
-      // Allocate the output batches here for now as linked lists
-      int lastActions[NUM_CC_THREADS] = {0};
-
-      // Pre process each txn
-      for (uint32_t i = 0; i < numActions; ++i) {
-        mv_action * action = actions[i];
-        ProcessAction(action, lastActions, batch.actionBuf, i);
-      }
-
-      // Ensure the last action in the batch has negative nextAction values
-      mv_action* action = actions[numActions - 1];
-      for (uint32_t i = 0 ; i < NUM_CC_THREADS; i++) {
-        action->__nextAction[i] = -1;
-      }
-
+      // Keep taking resubmitted txns while waiting, an executor blocks once
+      // its restart queue is full
+      ActionBatch batch;
+      while (!config.inputQueue->Dequeue(&batch))
+        DrainRestarts();
+      while (!InjectRestarts(&batch))
+        ;
+      // Without a leader this thread takes batches off the input queue
+      if (config.threadId == 0)
+        AssignOwners(&batch);
+      BuildStreams(&batch);
+      if (config.threadId == 0)
+        CountLoads(batch);
       config.outputQueue->EnqueueBlocking(batch);
     }
   }
@@ -12,6 +12,7 @@
 #include <cassert>
 #include <cstring>
 #include <deque>
+#include <algorithm>
 
 using namespace std;
 
@@ -26,28 +27,64 @@ MVScheduler::MVScheduler(MVSchedulerConfig config) :
 
         this->config = config;
         this->epoch = 0;
+        this->lowWaterMarkPtr = NULL;
         this->txnCounter = 0;
         this->txnMask = ((uint64_t)1<<config.threadId);
 
-        this->partitions = 
-                (MVTablePartition**)alloc_mem(sizeof(MVTablePartition*)*config.numTables, 
-                                              config.cpuNumber);
+        this->partitions = config.partitions;
         assert(this->partitions != NULL);
+        assert(config.numVParts % NUM_CC_THREADS == 0);
 
-        /* Initialize the allocator and the partitions. */
+        /* 
+         * Initialize the allocator and the partitions of this thread's run 
+         * of virtual partitions. 
+         */
         this->alloc = new (config.cpuNumber) MVRecordAllocator(config.allocatorSize, 
                                                                config.cpuNumber,
                                                                config.worker_start,
                                                                config.worker_end);
-        for (uint32_t i = 0; i < this->config.numTables; ++i) {
-
-                /* Track the partition locally and add it to the database's catalog. */
-                this->partitions[i] =
-                        new (config.cpuNumber) MVTablePartition(config.tblPartitionSizes[i],
-                                                                config.cpuNumber, alloc);
-                assert(this->partitions[i] != NULL);
+        uint32_t per_thread = config.numVParts/NUM_CC_THREADS;
+        for (uint32_t v = config.threadId*per_thread; 
+             v < (config.threadId + 1)*per_thread; ++v) {
+                for (uint32_t i = 0; i < this->config.numTables; ++i) {
+                        MVTablePartition **slot = 
+                                &this->partitions[v*config.numTables + i];
+                        *slot = new (config.cpuNumber) 
+                                MVTablePartition(config.tblPartitionSizes[i],
+                                                 config.cpuNumber, alloc,
+                                                 config.indexType,
+                                                 config.rangeIndex);
+                        assert(*slot != NULL);
+                }
         }
         this->threadId = config.threadId;
+        memset(&this->stats, 0x0, sizeof(MVSchedulerStats));
+}
+
+MVSchedulerStats MVScheduler::GetStats()
+{
+        return stats;
+}
+
+uint64_t MVScheduler::LiveVersions()
+{
+        return alloc->Live();
+}
+
+/* Bytes of version headers added past the allocator's initial size. */
+uint64_t MVScheduler::GrownVersions()
+{
+        return alloc->Grown();
+}
+
+/* 
+ * Snapshot readers look keys up directly in the CC threads' partitions, 
+ * whichever thread owns them. 
+ */
+MVTablePartition* MVScheduler::GetPartition(uint32_t vpart, uint32_t tableId)
+{
+        assert(vpart < config.numVParts && tableId < config.numTables);
+        return partitions[vpart*config.numTables + tableId];
 }
 
 static inline uint64_t compute_version(uint32_t epoch, uint32_t txnCounter) {
@@ -58,31 +95,129 @@ void MVScheduler::Init () {}
 
 void MVScheduler::StartWorking() 
 {
+        uint64_t start, fanout_end, sched_end, fanin_end, num_keys;
+        bool loaded = false;
+
         //  std::cout << config.numRecycleQueues << "\n";
         while (true) {
                 ActionBatch curBatch = config.inputQueue->DequeueBlocking();
 
+                start = rdtsc();
+                this->epoch += 1;
+                AdoptPartitions(curBatch);
+                ReclaimDeadKeys(curBatch);
                 for (uint32_t i = 0; i < config.numSubords; ++i) 
                         config.pubQueues[i]->EnqueueBlocking(curBatch);
+                fanout_end = rdtsc();
 
-                mv_action* action = curBatch.actionBuf[0];
-                while (true) {
-                  ScheduleTransaction(action);
-                  int nextAction = action->__nextAction[threadId];
-                  if  (nextAction == -1) {
-                    break;
-                  }
-                  action = curBatch.actionBuf[nextAction];
-                }
+                ScheduleStream(&curBatch);
+                sched_end = rdtsc();
+                num_keys = curBatch.streams[threadId].count;
 
                 for (uint32_t i = 0; i < config.numSubords; ++i) 
                         config.subQueues[i]->DequeueBlocking();
+                fanin_end = rdtsc();
+
+                /* Every CC thread is done with the batch's streams. */
+                if (threadId == 0) {
+                        free(curBatch.streams);
+                        free(curBatch.owners);
+                        curBatch.streams = NULL;
+                        curBatch.owners = NULL;
+                        if (curBatch.timing != NULL)
+                                curBatch.timing->scheduled = fanin_end;
+                }
+
+                /* The first batch loads the database, keep it out of stats. */
+                if (loaded) {
+                        stats.batches += 1;
+                        stats.keys += num_keys;
+                        stats.fanout_cycles += fanout_end - start;
+                        stats.sched_cycles += sched_end - fanout_end;
+                        stats.fanin_cycles += fanin_end - sched_end;
+                }
+                loaded = true;
                 for (uint32_t i = 0; i < config.numOutputs; ++i) 
                         config.outputQueues[i].EnqueueBlocking(curBatch);
                 Recycle();
         }
 }
 
+/* 
+ * Executors publish the GC low watermark only once they are set up, after the 
+ * CC threads. Until it is set, dead keys are not reclaimed. 
+ */
+void MVScheduler::SetWatermark(volatile uint32_t *lowWaterMarkPtr)
+{
+        this->lowWaterMarkPtr = lowWaterMarkPtr;
+}
+
+/*
+ * Take over the virtual partitions the batch newly assigns this thread: new 
+ * versions in them come from this thread's allocator from now on. Their 
+ * previous owner is done with the previous batch, and so with them.
+ */
+void MVScheduler::AdoptPartitions(const ActionBatch &batch)
+{
+        MVTablePartition *partition;
+        uint32_t v, i;
+
+        for (v = 0; v < config.numVParts; ++v) {
+                if (batch.owners[v] != threadId || 
+                    partitions[v*config.numTables]->Allocator() == alloc)
+                        continue;
+                for (i = 0; i < config.numTables; ++i) {
+                        partition = partitions[v*config.numTables + i];
+                        partition->SetAllocator(alloc);
+                }
+                stats.vparts_adopted += 1;
+        }
+}
+
+void MVScheduler::ReclaimDeadKeys(const ActionBatch &batch)
+{
+        uint32_t low_watermark, v, i;
+
+        if (lowWaterMarkPtr == NULL)
+                return;
+        barrier();
+        low_watermark = *lowWaterMarkPtr;
+        barrier();
+        for (v = 0; v < config.numVParts; ++v) {
+                if (batch.owners[v] != threadId)
+                        continue;
+                for (i = 0; i < config.numTables; ++i) 
+                        stats.dead_keys += 
+                                partitions[v*config.numTables + i]->
+                                ReclaimDeadKeys(low_watermark, epoch);
+        }
+}
+
+/* 
+ * Low on versions: take back whatever garbage collection has returned, and 
+ * if that isn't enough, grow the allocator past its initial size rather than 
+ * wait. Readers, checkpoints and lazy executors can hold the low watermark 
+ * back for any number of epochs, and a hot CC thread needs more than its 
+ * even share meanwhile. Note how far the watermark was behind this thread's 
+ * epoch when it had to grow.
+ */
+void MVScheduler::RefillVersions()
+{
+        uint32_t lag;
+
+        Recycle();
+        if (!alloc->Warning())
+                return;
+        lag = 0;
+        if (lowWaterMarkPtr != NULL && *lowWaterMarkPtr < epoch)
+                lag = epoch - *lowWaterMarkPtr;
+        while (alloc->Warning())
+                alloc->Grow();
+        stats.version_grows += 1;
+        if (lag > stats.grow_lag_max)
+                stats.grow_lag_max = lag;
+}
+
 void MVScheduler::Recycle() 
 {
         /* Check for recycled MVRecords */
@@ -96,35 +231,93 @@ void MVScheduler::Recycle()
 }
 
 /*
- * For each record in the writeset, write out a placeholder indicating that
- * the value for the record will be produced by this transaction. We don't need
- * to track the version of each record written by the transaction. The version
- * is equal to the transaction's timestamp.
+ * Resolve the ith key of the stream. For a write, install a placeholder 
+ * indicating that the value for the record will be produced by the writing 
+ * transaction; the version is equal to the transaction's timestamp. For a 
+ * read, find the version visible at the reader's timestamp. Either way, the 
+ * result goes into the txn's CompositeKey through the stream's slot; a delete 
+ * is a write of a tombstone. A range 
+ * read is resolved against this thread's partition into the thread's share 
+ * of the range.
  */
-inline void MVScheduler::ScheduleTransaction(mv_action *action) 
+inline void MVScheduler::ScheduleKey(ActionBatch *batch, KeyStream *stream, 
+                                     uint32_t i)
 {
+        mv_action *action;
+        MVRangeRead *range;
+        bool success;
 
-        while (alloc->Warning()) {
-                //          std::cerr << "[WARNING] CC thread low on versions\n";
-                Recycle();
+        action = batch->actionBuf[stream->txns[i]];
+        if (stream->flags[i] & KEY_STREAM_RANGE) {
+                range = &action->__ranges[stream->keys[i]];
+                range->counts[threadId] = 
+                        GetPartition(threadId, range->tableId)->
+                        ScanRange(range->start, range->end, range->limit,
+                                  action->__version, 
+                                  &range->versions[threadId*range->limit]);
+        } else if (stream->flags[i] & KEY_STREAM_WRITE) {
+                if (alloc->Warning())
+                        RefillVersions();
+                success = Partition(stream->hashes[i], stream->tables[i])->
+                        WriteNewVersion(stream->keys[i], 
+                                        stream->hashes[i], 
+                                        action, 
+                                        action->__version, 
+                                        stream->slots[i],
+                                        stream->flags[i]);
+                assert(success);
+        } else {
+                *stream->slots[i] = 
+                        Partition(stream->hashes[i], stream->tables[i])->
+                        GetMVRecord(stream->keys[i], stream->hashes[i],
+                                    action->__version);
         }
+}
 
-        int r_index = action->__read_starts[threadId];
-        int w_index = action->__write_starts[threadId];
-        int i;
-        while (r_index != -1) {
-                i = r_index;
-                MVRecord *ref = this->partitions[action->__readset[i].tableId]->
-                        GetMVRecord(action->__readset[i], action->__version);
-                action->__readset[i].value = ref;
-                r_index = action->__readset[i].next;
-        }
+/* Stage one of group prefetching: the index entries of keys [start, end). */
+void MVScheduler::PrefetchEntries(KeyStream *stream, uint32_t start, 
+                                  uint32_t end)
+{
+        uint32_t i;
 
-        while (w_index != -1) {
-                i = w_index;
-                this->partitions[action->__writeset[i].tableId]->
-                        WriteNewVersion(action->__writeset[i], action, action->__version);
-                w_index = action->__writeset[i].next;
-        }
+        for (i = start; i < end; ++i) 
+                Partition(stream->hashes[i], stream->tables[i])->
+                        Prefetch(stream->hashes[i]);
 }
 
+/*
+ * Walk this thread's KeyStream for the batch, a window of keys at a time 
+ * (group prefetching), pipelined a window deep. The index entries of the next 
+ * window are prefetched before the versions the current window's entries 
+ * point at, so that finding those versions doesn't wait on the entries just 
+ * requested; the first window goes without. Only then are the window's keys 
+ * resolved in stream order. The prefetches are hints, so a key written 
+ * earlier in the same window is still resolved correctly.
+ */
+void MVScheduler::ScheduleStream(ActionBatch *batch) 
+{
+        KeyStream *stream;
+        uint32_t i, start, end, next, window;
+
+        stream = &batch->streams[threadId];
+        window = config.prefetchWindow;
+        if (window <= 1) {
+                for (i = 0; i < stream->count; ++i) 
+                        ScheduleKey(batch, stream, i);
+        } else {
+                PrefetchEntries(stream, 0, std::min(window, stream->count));
+                for (start = 0; start < stream->count; start = end) {
+                        end = std::min(start + window, stream->count);
+                        next = std::min(end + window, stream->count);
+                        PrefetchEntries(stream, end, next);
+                        if (start > 0)
+                                for (i = start; i < end; ++i) 
+                                        Partition(stream->hashes[i], 
+                                                  stream->tables[i])->
+                                                PrefetchHead(stream->hashes[i]);
+                        for (i = start; i < end; ++i) 
+                                ScheduleKey(batch, stream, i);
+                }
+        }
+        free(stream->keys);
+}
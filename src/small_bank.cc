@@ -1,4 +1,5 @@
 #include <small_bank.h>
+#include <cstring>
 
 SmallBank::LoadCustomerRange::LoadCustomerRange(uint64_t customer_start,
                                                 uint64_t customer_end)
@@ -8,8 +9,10 @@ SmallBank::LoadCustomerRange::LoadCustomerRange(uint64_t customer_start,
         long savings, checking;
         
         for (i = customer_start; i < customer_end; ++i) {
-                savings = rand() % 100;
-                checking = rand() % 100;
+                savings = Hash128to64(std::make_pair(i, (uint64_t)SAVINGS))
+                        % 100;
+                checking = Hash128to64(std::make_pair(i, (uint64_t)CHECKING))
+                        % 100;
                 balances.push_back(savings);
                 balances.push_back(checking);
                 customers.push_back(i);
@@ -27,10 +30,11 @@ bool SmallBank::LoadCustomerRange::Run()
                 customer_id = this->customers[i];
                 savings = this->balances[2*i];
                 checking = this->balances[2*i+1];
-                savings_rec =
-                        (SmallBankRecord*)get_write_ref(customer_id, SAVINGS);
-                checking_rec =
-                        (SmallBankRecord*)get_write_ref(customer_id, CHECKING);
+                savings_rec = (SmallBankRecord*)get_write_at(2*i, customer_id,
+                                                             SAVINGS);
+                checking_rec = (SmallBankRecord*)get_write_at(2*i+1,
+                                                              customer_id,
+                                                              CHECKING);
                 savings_rec->amount = savings;
                 checking_rec->amount = checking;
         }
@@ -65,9 +69,9 @@ SmallBank::Balance::Balance(uint64_t customer_id)
 bool SmallBank::Balance::Run()
 {
         SmallBankRecord *checking =
-                (SmallBankRecord*)get_read_ref(customer_id, CHECKING);
+                (SmallBankRecord*)get_read_at(0, customer_id, CHECKING);
         SmallBankRecord *savings =
-                (SmallBankRecord*)get_read_ref(customer_id, SAVINGS);
+                (SmallBankRecord*)get_read_at(1, customer_id, SAVINGS);
         this->totalBalance = checking->amount + savings->amount;
         do_spin();
         return true;        
@@ -86,6 +90,30 @@ void SmallBank::Balance::get_reads(struct big_key *array)
         array[1].table_id = SAVINGS;
 }
 
+uint32_t SmallBank::Balance::log_proc()
+{
+        return PROC_SB_BALANCE;
+}
+
+uint32_t SmallBank::Balance::log_size()
+{
+        return sizeof(uint64_t);
+}
+
+void SmallBank::Balance::log_params(char *buf)
+{
+        memcpy(buf, &this->customer_id, sizeof(uint64_t));
+}
+
+txn* SmallBank::Balance::from_log(const char *params, uint32_t size)
+{
+        uint64_t customer_id;
+
+        assert(size == sizeof(uint64_t));
+        memcpy(&customer_id, params, sizeof(uint64_t));
+        return new Balance(customer_id);
+}
+
 SmallBank::DepositChecking::DepositChecking(uint64_t customer, long amount)
 {
         this->customer_id = customer;
@@ -96,7 +124,8 @@ bool SmallBank::DepositChecking::Run()
 {
         SmallBankRecord *checking;
 
-        checking = (SmallBankRecord*)get_write_ref(this->customer_id, CHECKING);
+        checking = (SmallBankRecord*)get_write_at(0, this->customer_id,
+                                                  CHECKING);
         checking->amount += this->amount;
         do_spin();
         return true;        
@@ -107,12 +136,45 @@ uint32_t SmallBank::DepositChecking::num_rmws()
         return 1;
 }
 
+/* The deposit only adds to the balance. */
+uint32_t SmallBank::DepositChecking::num_incrs()
+{
+        return 1;
+}
+
 void SmallBank::DepositChecking::get_rmws(struct big_key *array)
 {
         array[0].key = this->customer_id;
         array[0].table_id = CHECKING;
 }
 
+uint32_t SmallBank::DepositChecking::log_proc()
+{
+        return PROC_SB_DEPOSIT_CHECKING;
+}
+
+uint32_t SmallBank::DepositChecking::log_size()
+{
+        return sizeof(uint64_t) + sizeof(long);
+}
+
+void SmallBank::DepositChecking::log_params(char *buf)
+{
+        memcpy(buf, &this->customer_id, sizeof(uint64_t));
+        memcpy(buf + sizeof(uint64_t), &this->amount, sizeof(long));
+}
+
+txn* SmallBank::DepositChecking::from_log(const char *params, uint32_t size)
+{
+        uint64_t customer_id;
+        long amount;
+
+        assert(size == sizeof(uint64_t) + sizeof(long));
+        memcpy(&customer_id, params, sizeof(uint64_t));
+        memcpy(&amount, params + sizeof(uint64_t), sizeof(long));
+        return new DepositChecking(customer_id, amount);
+}
+
 SmallBank::TransactSaving::TransactSaving(uint64_t customer, long amount)
 {
         this->amount = amount;
@@ -122,7 +184,7 @@ SmallBank::TransactSaving::TransactSaving(uint64_t customer, long amount)
 bool SmallBank::TransactSaving::Run()
 {
         SmallBankRecord *savings;
-        savings = (SmallBankRecord*)get_write_ref(customer_id, SAVINGS);
+        savings = (SmallBankRecord*)get_write_at(0, customer_id, SAVINGS);
         savings->amount += this->amount;
         do_spin();
         return true;
@@ -133,12 +195,44 @@ uint32_t SmallBank::TransactSaving::num_rmws()
         return 1;
 }
 
+uint32_t SmallBank::TransactSaving::num_incrs()
+{
+        return 1;
+}
+
 void SmallBank::TransactSaving::get_rmws(struct big_key *array)
 {
         array[0].key = this->customer_id;
         array[0].table_id = SAVINGS;
 }
 
+uint32_t SmallBank::TransactSaving::log_proc()
+{
+        return PROC_SB_TRANSACT_SAVING;
+}
+
+uint32_t SmallBank::TransactSaving::log_size()
+{
+        return sizeof(uint64_t) + sizeof(long);
+}
+
+void SmallBank::TransactSaving::log_params(char *buf)
+{
+        memcpy(buf, &this->customer_id, sizeof(uint64_t));
+        memcpy(buf + sizeof(uint64_t), &this->amount, sizeof(long));
+}
+
+txn* SmallBank::TransactSaving::from_log(const char *params, uint32_t size)
+{
+        uint64_t customer_id;
+        long amount;
+
+        assert(size == sizeof(uint64_t) + sizeof(long));
+        memcpy(&customer_id, params, sizeof(uint64_t));
+        memcpy(&amount, params + sizeof(uint64_t), sizeof(long));
+        return new TransactSaving(customer_id, amount);
+}
+
 SmallBank::Amalgamate::Amalgamate(uint64_t from_customer, uint64_t to_customer)
 {
         this->from_customer = from_customer;
@@ -150,11 +244,11 @@ bool SmallBank::Amalgamate::Run()
         SmallBankRecord *from_checking, *from_savings, *to_checking;
 
         from_checking =
-                (SmallBankRecord*)get_write_ref(this->from_customer, CHECKING);
+                (SmallBankRecord*)get_write_at(0, this->from_customer, CHECKING);
         from_savings =
-                (SmallBankRecord*)get_write_ref(this->from_customer, SAVINGS);
+                (SmallBankRecord*)get_write_at(1, this->from_customer, SAVINGS);
         to_checking =
-                (SmallBankRecord*)get_write_ref(this->to_customer, CHECKING);
+                (SmallBankRecord*)get_write_at(2, this->to_customer, CHECKING);
         to_checking->amount += from_checking->amount + from_savings->amount;
         from_checking->amount = 0;
         from_savings->amount = 0;
@@ -179,21 +273,54 @@ void SmallBank::Amalgamate::get_rmws(struct big_key *array)
         array[2].table_id = CHECKING;
 }
 
-SmallBank::WriteCheck::WriteCheck(uint64_t customer_id, long amount)
+uint32_t SmallBank::Amalgamate::log_proc()
+{
+        return PROC_SB_AMALGAMATE;
+}
+
+uint32_t SmallBank::Amalgamate::log_size()
+{
+        return sizeof(uint64_t) + sizeof(uint64_t);
+}
+
+void SmallBank::Amalgamate::log_params(char *buf)
+{
+        memcpy(buf, &this->from_customer, sizeof(uint64_t));
+        memcpy(buf + sizeof(uint64_t), &this->to_customer, sizeof(uint64_t));
+}
+
+txn* SmallBank::Amalgamate::from_log(const char *params, uint32_t size)
+{
+        uint64_t from_customer, to_customer;
+
+        assert(size == sizeof(uint64_t) + sizeof(uint64_t));
+        memcpy(&from_customer, params, sizeof(uint64_t));
+        memcpy(&to_customer, params + sizeof(uint64_t), sizeof(uint64_t));
+        return new Amalgamate(from_customer, to_customer);
+}
+
+SmallBank::WriteCheck::WriteCheck(uint64_t customer_id, long amount,
+                                  bool overdraft_abort)
 {
         this->customer_id = customer_id;
         this->check_amount = amount;
+        this->overdraft_abort = overdraft_abort;
 }
 
 bool SmallBank::WriteCheck::Run()
 {
         SmallBankRecord *checking, *savings;
-
-        checking = (SmallBankRecord*)get_write_ref(customer_id, CHECKING);
-        savings = (SmallBankRecord*)get_read_ref(customer_id, SAVINGS);
-        if (checking->amount + savings->amount - check_amount < 0)
-                check_amount += 1;
-        checking->amount -= check_amount;
+        long penalty;
+
+        checking = (SmallBankRecord*)get_write_at(0, customer_id, CHECKING);
+        savings = (SmallBankRecord*)get_read_at(0, customer_id, SAVINGS);
+        penalty = 0;
+        if (checking->amount + savings->amount - check_amount < 0) {
+                if (overdraft_abort)
+                        return abort();
+                penalty = 1;
+        }
+        checking->amount -= check_amount + penalty;
         do_spin();
         return true;
 }
@@ -219,3 +346,35 @@ void SmallBank::WriteCheck::get_rmws(struct big_key *array)
         array[0].key = this->customer_id;
         array[0].table_id = CHECKING;
 }
+
+uint32_t SmallBank::WriteCheck::log_proc()
+{
+        return PROC_SB_WRITE_CHECK;
+}
+
+uint32_t SmallBank::WriteCheck::log_size()
+{
+        return sizeof(uint64_t) + sizeof(long) + sizeof(bool);
+}
+
+void SmallBank::WriteCheck::log_params(char *buf)
+{
+        memcpy(buf, &this->customer_id, sizeof(uint64_t));
+        memcpy(buf + sizeof(uint64_t), &this->check_amount, sizeof(long));
+        memcpy(buf + sizeof(uint64_t) + sizeof(long), &this->overdraft_abort, 
+               sizeof(bool));
+}
+
+txn* SmallBank::WriteCheck::from_log(const char *params, uint32_t size)
+{
+        uint64_t customer_id;
+        long check_amount;
+        bool overdraft_abort;
+
+        assert(size == sizeof(uint64_t) + sizeof(long) + sizeof(bool));
+        memcpy(&customer_id, params, sizeof(uint64_t));
+        memcpy(&check_amount, params + sizeof(uint64_t), sizeof(long));
+        memcpy(&overdraft_abort, params + sizeof(uint64_t) + sizeof(long),
+               sizeof(bool));
+        return new WriteCheck(customer_id, check_amount, overdraft_abort);
+}
@@ -0,0 +1,129 @@
+#include <snapshot_reader.h>
+#include <util.h>
+#include <sstream>
+
+SnapshotReader::SnapshotReader(SnapshotReaderConfig cfg) : Runnable(cfg.cpu)
+{
+        std::stringstream msg;
+        msg << "Snapshot reader " << cfg.threadId << " started on cpu " << cfg.cpu << "\n";
+        std::cout << msg.str();
+
+        this->config = cfg;
+        this->pinned = 0;
+        memset(&this->stats, 0x0, sizeof(SnapshotReaderStats));
+}
+
+void SnapshotReader::Init()
+{
+}
+
+SnapshotReaderStats SnapshotReader::GetStats()
+{
+        return stats;
+}
+
+/*
+ * Pin the newest executed snapshot, unless the one already pinned is still
+ * the newest. The pin is published with a full barrier before readEpoch is
+ * checked again, so executor 0 either sees it before raising safeEpoch or
+ * has already published the epoch re-read here (see Executor::AdvanceReaders).
+ * Waits for the database to be loaded: before that, readEpoch is 0, the same
+ * as no pin.
+ */
+uint64_t SnapshotReader::Pin()
+{
+        ReaderPin *pin;
+        uint64_t snapshot;
+
+        snapshot = config.epochs->readEpoch;
+        if (pinned != 0 && snapshot == pinned)
+                return pinned;
+        pin = &config.epochs->pins[config.threadId];
+        do {
+                do {
+                        snapshot = config.epochs->readEpoch;
+                } while (snapshot == 0);
+                xchgq(&pin->epoch, snapshot);
+        } while (config.epochs->readEpoch != snapshot);
+        pinned = snapshot;
+        stats.pins += 1;
+        return pinned;
+}
+
+/* Stop holding back garbage collection while there is nothing to read. */
+void SnapshotReader::Unpin()
+{
+        barrier();
+        config.epochs->pins[config.threadId].epoch = 0;
+        barrier();
+        pinned = 0;
+}
+
+/*
+ * Point each of the txn's reads at the newest version of the snapshot epoch,
+ * looking keys up a window at a time like the CC threads do. The txn takes a
+ * timestamp of the following epoch, so reads go straight to those versions
+ * rather than to their epoch ancestors.
+ */
+void SnapshotReader::Resolve(mv_action *action, uint64_t snapshot)
+{
+        uint32_t num_reads, i, start, end;
+        uint64_t version;
+        MVTablePartition *partition;
+        CompositeKey *key;
+
+        version = CREATE_MV_TIMESTAMP(snapshot, 0xFFFFFFFF);
+        num_reads = action->__readset.size();
+        for (start = 0; start < num_reads; start = end) {
+                end = start + READER_WINDOW;
+                if (end > num_reads)
+                        end = num_reads;
+                for (i = start; i < end; ++i) {
+                        key = &action->__readset[i];
+                        config.partitions[key->vpart*config.numTables +
+                                          key->tableId]->Prefetch(key->hash);
+                }
+                for (i = start; i < end; ++i) {
+                        key = &action->__readset[i];
+                        partition = config.partitions[key->vpart*
+                                                      config.numTables +
+                                                      key->tableId];
+                        key->value = partition->GetMVRecord(key->key,
+                                                            key->hash,
+                                                            version);
+                }
+        }
+        action->__version = CREATE_MV_TIMESTAMP(snapshot + 1, 0);
+}
+
+void SnapshotReader::RunBatch(const ActionBatch &batch)
+{
+        mv_action *action;
+        uint64_t snapshot;
+        uint32_t i, epoch;
+
+        for (i = 0; i < batch.numActions; ++i) {
+                action = batch.actionBuf[i];
+                assert(action->__readonly == true);
+                epoch = (uint32_t)(action->__version >> 32);
+                snapshot = Pin();
+                Resolve(action, snapshot);
+                action->Run();
+                stats.txns += 1;
+                stats.snapshot_lag += (int64_t)epoch - 1 - (int64_t)snapshot;
+        }
+}
+
+void SnapshotReader::StartWorking()
+{
+        ActionBatch batch;
+
+        while (true) {
+                batch = config.inputQueue->DequeueBlocking();
+                RunBatch(batch);
+                Unpin();
+                if (batch.arena != NULL)
+                        batch.arena->Release();
+                config.outputQueue->EnqueueBlocking(batch);
+        }
+}
@@ -0,0 +1,52 @@
+#include <watermark_sampler.h>
+#include <util.h>
+#include <time.h>
+#include <unistd.h>
+#include <sstream>
+
+WatermarkSampler::WatermarkSampler(WatermarkSamplerConfig cfg)
+        : Runnable(cfg.cpu)
+{
+        std::stringstream msg;
+        msg << "Watermark sampler started on cpu " << cfg.cpu << "\n";
+        std::cout << msg.str();
+
+        assert(cfg.intervalMs > 0);
+        this->config = cfg;
+}
+
+void WatermarkSampler::Init()
+{
+}
+
+/*
+ * Sleeps between samples rather than spin, the sampler shares its cpu with
+ * whatever runs there. Each line is written in one go so that it isn't
+ * interleaved with other threads' output.
+ */
+void WatermarkSampler::StartWorking()
+{
+        struct timespec start_time, now;
+        uint64_t current_epoch, elapsed_ms;
+        uint32_t low_watermark;
+
+        clock_gettime(CLOCK_MONOTONIC, &start_time);
+        while (true) {
+                usleep(1000*config.intervalMs);
+                barrier();
+                current_epoch = config.epochs->currentEpoch;
+                low_watermark = config.epochs->lowWatermark;
+                barrier();
+                clock_gettime(CLOCK_MONOTONIC, &now);
+                elapsed_ms = 1000*(uint64_t)(now.tv_sec - start_time.tv_sec) +
+                        (now.tv_nsec - start_time.tv_nsec) / 1000000;
+
+                std::stringstream msg;
+                msg << "wm_sample ms:" << elapsed_ms << " epoch:" <<
+                        current_epoch << " watermark:" << low_watermark <<
+                        " gap:" << (current_epoch > low_watermark?
+                                    current_epoch - low_watermark : 0) <<
+                        "\n";
+                std::cerr << msg.str();
+        }
+}
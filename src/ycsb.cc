@@ -1,6 +1,37 @@
 #include <ycsb.h>
 #include <cassert>
 #include <string.h>
+#include <algorithm>
+
+/* 
+ * A key vector in a txn's log parameters (see txn::log_params): the number of 
+ * keys, followed by the keys. 
+ */
+static uint32_t log_keys_size(const vector<uint64_t> &keys)
+{
+        return sizeof(uint32_t) + keys.size()*sizeof(uint64_t);
+}
+
+static char* log_keys(char *buf, const vector<uint64_t> &keys)
+{
+        uint32_t count;
+
+        count = keys.size();
+        memcpy(buf, &count, sizeof(uint32_t));
+        memcpy(buf + sizeof(uint32_t), keys.data(), count*sizeof(uint64_t));
+        return buf + log_keys_size(keys);
+}
+
+static const char* replay_keys(const char *buf, vector<uint64_t> *OUT_KEYS)
+{
+        uint32_t count;
+
+        memcpy(&count, buf, sizeof(uint32_t));
+        OUT_KEYS->resize(count);
+        memcpy(OUT_KEYS->data(), buf + sizeof(uint32_t), 
+               count*sizeof(uint64_t));
+        return buf + log_keys_size(*OUT_KEYS);
+}
 
 ycsb_insert::ycsb_insert(uint64_t start, uint64_t end)
 {
@@ -26,7 +57,7 @@ bool ycsb_insert::Run()
 
         for (i = this->start; i < this->end; ++i) {
                 gen_rand(rand_array);
-                record_ptr = (char*)get_write_ref(i, 0);
+                record_ptr = (char*)get_write_at(i - this->start, i, 0);
                 memcpy(record_ptr, rand_array, YCSB_RECORD_SIZE);
         }
         return true;
@@ -79,6 +110,30 @@ void ycsb_readonly::get_reads(struct big_key *array)
         return;
 }
 
+uint32_t ycsb_readonly::log_proc()
+{
+        return PROC_YCSB_READONLY;
+}
+
+uint32_t ycsb_readonly::log_size()
+{
+        return log_keys_size(this->reads);
+}
+
+void ycsb_readonly::log_params(char *buf)
+{
+        log_keys(buf, this->reads);
+}
+
+txn* ycsb_readonly::from_log(const char *params, uint32_t size)
+{
+        vector<uint64_t> reads;
+
+        params = replay_keys(params, &reads);
+        assert(log_keys_size(reads) == size);
+        return new ycsb_readonly(reads);
+}
+
 ycsb_rmw::ycsb_rmw(vector<uint64_t> reads, vector<uint64_t> writes)
 {
         uint32_t num_reads, num_writes, i;
@@ -141,16 +196,305 @@ bool ycsb_rmw::Run()
         /* Accumulate each field of records in the readset into "counter". */
         counter = 0;
         for (i = 0; i < num_reads; ++i) {
-                field_ptr = (char*)get_read_ref(reads[i], 0);
+                field_ptr = (char*)get_read_at(i, reads[i], 0);
                 for (j = 0; j < 10; ++j)
                         counter += *((uint64_t*)&field_ptr[j*100]);
         }
 
         /* Perform an RMW operation on each element of the writeset. */
         for (i = 0; i < num_writes; ++i) {
-                write_ptr = (char*)get_write_ref(writes[i], 0);
+                write_ptr = (char*)get_write_at(i, writes[i], 0);
                 for (j = 0; j < 10; ++j)
                         *((uint64_t*)&write_ptr[j*100]) += j+1+counter;
         }
         return true;
 }
+
+uint32_t ycsb_rmw::log_proc()
+{
+        return PROC_YCSB_RMW;
+}
+
+uint32_t ycsb_rmw::log_size()
+{
+        return log_keys_size(this->reads) + log_keys_size(this->writes);
+}
+
+void ycsb_rmw::log_params(char *buf)
+{
+        buf = log_keys(buf, this->reads);
+        log_keys(buf, this->writes);
+}
+
+txn* ycsb_rmw::from_log(const char *params, uint32_t size)
+{
+        vector<uint64_t> reads, writes;
+
+        params = replay_keys(params, &reads);
+        params = replay_keys(params, &writes);
+        assert(log_keys_size(reads) + log_keys_size(writes) == size);
+        return new ycsb_rmw(reads, writes);
+}
+
+ycsb_churn::ycsb_churn(vector<uint64_t> rmws, vector<uint64_t> inserts, 
+                       vector<uint64_t> deletes)
+        : rmws(rmws), inserts(inserts), deletes(deletes)
+{
+}
+
+uint32_t ycsb_churn::num_rmws()
+{
+        return this->rmws.size();
+}
+
+uint32_t ycsb_churn::num_writes()
+{
+        return this->inserts.size();
+}
+
+uint32_t ycsb_churn::num_deletes()
+{
+        return this->deletes.size();
+}
+
+static void ycsb_keys(const vector<uint64_t> &keys, struct big_key *array)
+{
+        uint32_t i, num_keys;
+
+        num_keys = keys.size();
+        for (i = 0; i < num_keys; ++i) {
+                array[i].key = keys[i];
+                array[i].table_id = 0;
+        }
+}
+
+void ycsb_churn::get_rmws(struct big_key *array)
+{
+        ycsb_keys(this->rmws, array);
+}
+
+void ycsb_churn::get_writes(struct big_key *array)
+{
+        ycsb_keys(this->inserts, array);
+}
+
+void ycsb_churn::get_deletes(struct big_key *array)
+{
+        ycsb_keys(this->deletes, array);
+}
+
+/* 
+ * Positions of the rmws follow the inserts (see translator::write_ref_at). An 
+ * insert writes the whole record, a recycled payload's old contents would 
+ * otherwise differ between a run and its replay.
+ */
+bool ycsb_churn::Run()
+{
+        uint32_t i, j, num_rmws, num_inserts;
+        char *write_ptr;
+
+        num_rmws = this->rmws.size();
+        num_inserts = this->inserts.size();
+        for (i = 0; i < num_inserts; ++i) {
+                write_ptr = (char*)get_write_at(i, inserts[i], 0);
+                memset(write_ptr, 0x0, YCSB_RECORD_SIZE);
+                for (j = 0; j < 10; ++j)
+                        *((uint64_t*)&write_ptr[j*100]) = inserts[i] + j;
+        }
+        for (i = 0; i < num_rmws; ++i) {
+                write_ptr = (char*)get_write_at(num_inserts + i, rmws[i], 0);
+                if (write_ptr == NULL)
+                        continue;
+                for (j = 0; j < 10; ++j)
+                        *((uint64_t*)&write_ptr[j*100]) += j+1;
+        }
+        return true;
+}
+
+uint32_t ycsb_churn::log_proc()
+{
+        return PROC_YCSB_CHURN;
+}
+
+uint32_t ycsb_churn::log_size()
+{
+        return log_keys_size(this->rmws) + log_keys_size(this->inserts) + 
+                log_keys_size(this->deletes);
+}
+
+void ycsb_churn::log_params(char *buf)
+{
+        buf = log_keys(buf, this->rmws);
+        buf = log_keys(buf, this->inserts);
+        log_keys(buf, this->deletes);
+}
+
+txn* ycsb_churn::from_log(const char *params, uint32_t size)
+{
+        vector<uint64_t> rmws, inserts, deletes;
+
+        params = replay_keys(params, &rmws);
+        params = replay_keys(params, &inserts);
+        params = replay_keys(params, &deletes);
+        assert(log_keys_size(rmws) + log_keys_size(inserts) + 
+               log_keys_size(deletes) == size);
+        return new ycsb_churn(rmws, inserts, deletes);
+}
+
+ycsb_scan::ycsb_scan(uint64_t start, uint64_t end, uint32_t limit)
+        : keys(limit), values(limit)
+{
+        assert(start < end && limit > 0);
+        this->accumulated = 0;
+        this->start = start;
+        this->end = end;
+        this->limit = limit;
+}
+
+uint32_t ycsb_scan::num_ranges()
+{
+        return 1;
+}
+
+void ycsb_scan::get_ranges(struct big_range *array)
+{
+        array[0].start = this->start;
+        array[0].end = this->end;
+        array[0].table_id = 0;
+        array[0].limit = this->limit;
+}
+
+bool ycsb_scan::Run()
+{
+        uint32_t i, count;
+        uint64_t counter;
+
+        count = get_range_at(0, &keys[0], &values[0]);
+        assert(count <= limit);
+        counter = 0;
+        for (i = 0; i < count; ++i) 
+                counter += *(uint64_t*)values[i];
+        accumulated = counter;
+        return true;
+}
+
+uint32_t ycsb_scan::log_proc()
+{
+        return PROC_YCSB_SCAN;
+}
+
+uint32_t ycsb_scan::log_size()
+{
+        return 2*sizeof(uint64_t) + sizeof(uint32_t);
+}
+
+void ycsb_scan::log_params(char *buf)
+{
+        memcpy(buf, &this->start, sizeof(uint64_t));
+        memcpy(buf + sizeof(uint64_t), &this->end, sizeof(uint64_t));
+        memcpy(buf + 2*sizeof(uint64_t), &this->limit, sizeof(uint32_t));
+}
+
+txn* ycsb_scan::from_log(const char *params, uint32_t size)
+{
+        uint64_t start, end;
+        uint32_t limit;
+
+        assert(size == 2*sizeof(uint64_t) + sizeof(uint32_t));
+        memcpy(&start, params, sizeof(uint64_t));
+        memcpy(&end, params + sizeof(uint64_t), sizeof(uint64_t));
+        memcpy(&limit, params + 2*sizeof(uint64_t), sizeof(uint32_t));
+        return new ycsb_scan(start, end, limit);
+}
+
+ycsb_ollp::ycsb_ollp(vector<uint64_t> lookups, uint64_t num_records)
+        : lookups(lookups)
+{
+        assert(lookups.size() > 0 && num_records > 0);
+        this->num_records = num_records;
+        this->predicted = false;
+}
+
+/* 
+ * The records the lookups point to now, and the first lookup record. Recon 
+ * reads the lookup records at the same positions Run() does. 
+ */
+void ycsb_ollp::follow(vector<uint64_t> *OUT_RMWS)
+{
+        uint32_t i, num_lookups;
+        uint64_t *field_ptr;
+
+        num_lookups = this->lookups.size();
+        OUT_RMWS->clear();
+        OUT_RMWS->push_back(lookups[0]);
+        for (i = 0; i < num_lookups; ++i) {
+                field_ptr = (uint64_t*)get_read_at(i, lookups[i], 0);
+                OUT_RMWS->push_back(*field_ptr % num_records);
+        }
+        sort(OUT_RMWS->begin(), OUT_RMWS->end());
+        OUT_RMWS->erase(unique(OUT_RMWS->begin(), OUT_RMWS->end()), 
+                        OUT_RMWS->end());
+}
+
+bool ycsb_ollp::needs_recon()
+{
+        return !this->predicted;
+}
+
+uint32_t ycsb_ollp::num_recon_reads()
+{
+        return this->lookups.size();
+}
+
+void ycsb_ollp::get_recon_reads(struct big_key *array)
+{
+        ycsb_keys(this->lookups, array);
+}
+
+void ycsb_ollp::recon()
+{
+        follow(&this->rmws);
+        this->predicted = true;
+}
+
+uint32_t ycsb_ollp::num_reads()
+{
+        return this->lookups.size();
+}
+
+uint32_t ycsb_ollp::num_rmws()
+{
+        return this->rmws.size();
+}
+
+void ycsb_ollp::get_reads(struct big_key *array)
+{
+        ycsb_keys(this->lookups, array);
+}
+
+void ycsb_ollp::get_rmws(struct big_key *array)
+{
+        ycsb_keys(this->rmws, array);
+}
+
+bool ycsb_ollp::Run()
+{
+        vector<uint64_t> actual;
+        uint32_t i, j, num_rmws;
+        char *write_ptr;
+
+        follow(&actual);
+        if (actual != this->rmws) {
+                this->rmws = actual;
+                return false;
+        }
+        num_rmws = this->rmws.size();
+        for (i = 0; i < num_rmws; ++i) {
+                write_ptr = (char*)get_write_at(i, rmws[i], 0);
+                if (rmws[i] == lookups[0])
+                        *((uint64_t*)write_ptr) += 1;
+                for (j = 1; j < 10; ++j)
+                        *((uint64_t*)&write_ptr[j*100]) += j+1;
+        }
+        return true;
+}
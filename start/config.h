@@ -29,7 +29,26 @@ static struct option long_options[] = {
   {"read_txn_size", required_argument, NULL, 15},
   {"hot_position", required_argument, NULL, 16},  
   {"num_ppp_threads", required_argument, NULL, 17},
-  {NULL, no_argument, NULL, 18},
+  {"cc_fanout", required_argument, NULL, 18},
+  {"mv_index", required_argument, NULL, 19},
+  {"cc_window", required_argument, NULL, 20},
+  {"exec_slice", required_argument, NULL, 21},
+  {"epoch_target_us", required_argument, NULL, 22},
+  {"arrival_rate", required_argument, NULL, 23},
+  {"num_reader_threads", required_argument, NULL, 24},
+  {"payload_placement", required_argument, NULL, 25},
+  {"command_log", required_argument, NULL, 26},
+  {"replay", required_argument, NULL, 27},
+  {"checkpoint_dir", required_argument, NULL, 28},
+  {"checkpoint_threads", required_argument, NULL, 29},
+  {"checkpoint_interval", required_argument, NULL, 30},
+  {"lazy_depth", required_argument, NULL, 31},
+  {"incr_deltas", required_argument, NULL, 32},
+  {"num_vparts", required_argument, NULL, 33},
+  {"repartition_interval", required_argument, NULL, 34},
+  {"overdraft_abort", required_argument, NULL, 35},
+  {"wm_report_ms", required_argument, NULL, 36},
+  {NULL, no_argument, NULL, 37},
 };
 
 enum distribution_t {
@@ -47,6 +66,12 @@ struct workload_config
         uint32_t read_pct;
         uint32_t read_txn_size;
         uint32_t hot_position;
+
+        /* 
+         * SmallBank WriteCheck aborts rather than charge a penalty when the 
+         * check overdraws the customer's accounts. 
+         */
+        uint32_t overdraft_abort;
 };
 
 enum ConcurrencyControl {
@@ -117,7 +142,109 @@ struct MVConfig {
   double theta;
         int read_pct;
         int read_txn_size;
-        
+
+        /* 
+         * Max children per node of the CC thread broadcast tree, a socket 
+         * leader's leader and local children together. 0 means unbounded, 
+         * every thread on a socket hangs off the socket's leader. 1 is not 
+         * allowed, see build_cc_tree.
+         */
+        uint32_t ccFanout = 0;
+
+        /* Partition index layout, see MVIndexType. */
+        uint32_t indexType = 0;
+
+        /* 
+         * Number of keys a CC thread prefetches and then resolves together. 
+         * 0 or 1 resolves one key at a time.
+         */
+        uint32_t ccWindow = 16;
+
+        /* 
+         * Number of consecutive txns in a unit of executor work stealing. 0 
+         * statically assigns every numWorkerThreads'th txn to an executor.
+         */
+        uint32_t execSlice = 16;
+
+        /* 
+         * Target p99 txn latency in microseconds. If set, epochs are closed 
+         * after at most epochSize txns or a time budget, and the txn count is 
+         * tuned online; 0 cuts every epoch at exactly epochSize txns.
+         */
+        uint32_t epochTargetUs = 0;
+
+        /* 
+         * Offered load in txns per second when epochs are sized adaptively. 
+         * 0 means every txn is available from the start.
+         */
+        uint32_t arrivalRate = 0;
+
+        /* 
+         * Threads running read-only txns against the newest executed epoch, 
+         * outside the CC and execution stages. 0 sends read-only txns 
+         * through the pipeline like any other.
+         */
+        uint32_t numReaderThreads = 0;
+
+        /* NUMA node record payloads are allocated on, see PayloadPlacement. */
+        uint32_t payloadPlacement = 0;
+
+        /* 
+         * File txn inputs are logged to, see CommandLog. NULL runs without 
+         * durability. 
+         */
+        const char *commandLog = NULL;
+
+        /* 
+         * Instead of running the workload, rebuild the database by re-running 
+         * the epochs in commandLog. 
+         */
+        uint32_t replay = 0;
+
+        /* 
+         * Directory checkpoints are written to, see Checkpointer. NULL takes 
+         * none. A replay reloads the checkpoint in it, if there is one, and 
+         * re-runs only the logged epochs after it.
+         */
+        const char *checkpointDir = NULL;
+
+        /* Threads writing, and reloading, a checkpoint in parallel. */
+        uint32_t checkpointThreads = 1;
+
+        /* Executed epochs between the starts of two checkpoints. */
+        uint32_t checkpointInterval = 50;
+
+        /* 
+         * Lazy execution: each executor acknowledges up to lazyDepth batches 
+         * before executing them, evaluating only their read-only txns and 
+         * whatever those read right away. 0 executes every batch eagerly.
+         */
+        uint32_t lazyDepth = 0;
+
+        /* 
+         * Write the increments txns declare (see txn::num_incrs) as deltas, 
+         * which don't wait for the value they add to, instead of RMWs.
+         */
+        uint32_t incrDeltas = 0;
+
+        /* 
+         * Keys hash to numVParts virtual partitions, each owned by one CC 
+         * thread; a multiple of numCCThreads. 0 means one per CC thread.
+         */
+        uint32_t numVParts = 0;
+
+        /* 
+         * Batches between two rebalancings of virtual partitions across CC 
+         * threads, by the keys each saw. 0 keeps the initial assignment.
+         */
+        uint32_t repartitionInterval = 0;
+
+        /* 
+         * Milliseconds between two samples of the current epoch and the low 
+         * watermark printed while the run is going, see WatermarkSampler. 0 
+         * takes none.
+         */
+        uint32_t wmReportMs = 0;
 };
 
 class ExperimentConfig {
@@ -140,7 +267,26 @@ class ExperimentConfig {
     READ_PCT,
     READ_TXN_SIZE,
     HOT_POSITION,
-    NUM_PPP_THREADS
+    NUM_PPP_THREADS,
+    CC_FANOUT,
+    MV_INDEX,
+    CC_WINDOW,
+    EXEC_SLICE,
+    EPOCH_TARGET_US,
+    ARRIVAL_RATE,
+    NUM_READER_THREADS,
+    PAYLOAD_PLACEMENT,
+    COMMAND_LOG,
+    REPLAY,
+    CHECKPOINT_DIR,
+    CHECKPOINT_THREADS,
+    CHECKPOINT_INTERVAL,
+    LAZY_DEPTH,
+    INCR_DELTAS,
+    NUM_VPARTS,
+    REPARTITION_INTERVAL,
+    OVERDRAFT_ABORT,
+    WM_REPORT_MS,
   };
   unordered_map<int, char*> argMap;
 
@@ -221,6 +367,75 @@ class ExperimentConfig {
       if (argMap.count(THETA) > 0) {
         mvConfig.theta = (double)atof(argMap[THETA]);
       }
+      if (argMap.count(CC_FANOUT) > 0) {
+        mvConfig.ccFanout = (uint32_t)atoi(argMap[CC_FANOUT]);
+        assert(mvConfig.ccFanout != 1);
+      }
+      if (argMap.count(MV_INDEX) > 0) {
+        mvConfig.indexType = (uint32_t)atoi(argMap[MV_INDEX]);
+        assert(mvConfig.indexType < 3);
+      }
+      if (argMap.count(CC_WINDOW) > 0) {
+        mvConfig.ccWindow = (uint32_t)atoi(argMap[CC_WINDOW]);
+      }
+      if (argMap.count(EXEC_SLICE) > 0) {
+        mvConfig.execSlice = (uint32_t)atoi(argMap[EXEC_SLICE]);
+      }
+      if (argMap.count(EPOCH_TARGET_US) > 0) {
+        mvConfig.epochTargetUs = (uint32_t)atoi(argMap[EPOCH_TARGET_US]);
+      }
+      if (argMap.count(ARRIVAL_RATE) > 0) {
+        mvConfig.arrivalRate = (uint32_t)atoi(argMap[ARRIVAL_RATE]);
+      }
+      if (argMap.count(NUM_READER_THREADS) > 0) {
+        mvConfig.numReaderThreads = 
+                (uint32_t)atoi(argMap[NUM_READER_THREADS]);
+      }
+      if (argMap.count(PAYLOAD_PLACEMENT) > 0) {
+        mvConfig.payloadPlacement = 
+                (uint32_t)atoi(argMap[PAYLOAD_PLACEMENT]);
+        assert(mvConfig.payloadPlacement < 3);
+      }
+      if (argMap.count(COMMAND_LOG) > 0) {
+        mvConfig.commandLog = argMap[COMMAND_LOG];
+      }
+      if (argMap.count(REPLAY) > 0) {
+        mvConfig.replay = (uint32_t)atoi(argMap[REPLAY]);
+        assert(mvConfig.replay == 0 || mvConfig.commandLog != NULL);
+      }
+      if (argMap.count(CHECKPOINT_DIR) > 0) {
+        mvConfig.checkpointDir = argMap[CHECKPOINT_DIR];
+      }
+      if (argMap.count(CHECKPOINT_THREADS) > 0) {
+        mvConfig.checkpointThreads = 
+                (uint32_t)atoi(argMap[CHECKPOINT_THREADS]);
+        assert(mvConfig.checkpointThreads > 0);
+      }
+      if (argMap.count(CHECKPOINT_INTERVAL) > 0) {
+        mvConfig.checkpointInterval = 
+                (uint32_t)atoi(argMap[CHECKPOINT_INTERVAL]);
+        assert(mvConfig.checkpointInterval > 0);
+      }
+      if (argMap.count(LAZY_DEPTH) > 0) {
+        mvConfig.lazyDepth = (uint32_t)atoi(argMap[LAZY_DEPTH]);
+      }
+      if (argMap.count(INCR_DELTAS) > 0) {
+        mvConfig.incrDeltas = (uint32_t)atoi(argMap[INCR_DELTAS]);
+      }
+      if (argMap.count(NUM_VPARTS) > 0) {
+        mvConfig.numVParts = (uint32_t)atoi(argMap[NUM_VPARTS]);
+      }
+      if (mvConfig.numVParts == 0) {
+        mvConfig.numVParts = mvConfig.numCCThreads;
+      }
+      assert(mvConfig.numVParts % mvConfig.numCCThreads == 0);
+      if (argMap.count(REPARTITION_INTERVAL) > 0) {
+        mvConfig.repartitionInterval = 
+                (uint32_t)atoi(argMap[REPARTITION_INTERVAL]);
+      }
+      if (argMap.count(WM_REPORT_MS) > 0) {
+        mvConfig.wmReportMs = (uint32_t)atoi(argMap[WM_REPORT_MS]);
+      }
       this->ccType = MULTIVERSION;
     } else if (ccType == LOCKING) {  // ccType == LOCKING
       
@@ -369,6 +584,10 @@ class ExperimentConfig {
     }
     this->w_conf.read_pct = (uint32_t)atoi(argMap[READ_PCT]);
     this->w_conf.read_txn_size = (uint32_t)atoi(argMap[READ_TXN_SIZE]);
+    this->w_conf.overdraft_abort = 0;
+    if (argMap.count(OVERDRAFT_ABORT) > 0)
+            this->w_conf.overdraft_abort = 
+                    (uint32_t)atoi(argMap[OVERDRAFT_ABORT]);
     
     /* 
      * If experiment varies hot record location, make sure that location has 
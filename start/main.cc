@@ -28,6 +28,7 @@ Database DB(2);
 uint64_t dbSize = ((uint64_t)1<<36);
 
 uint32_t NUM_CC_THREADS;
+uint32_t NUM_VPARTS;
 
 int NumProcs;
 uint32_t numLockingRecords;
@@ -42,13 +43,15 @@ int main(int argc, char **argv) {
   
   
   if (cfg.ccType == MULTIVERSION) {
-          if (cfg.mvConfig.experiment < 3) 
+          if (cfg.mvConfig.experiment < 3 || cfg.mvConfig.experiment == 5 ||
+              cfg.mvConfig.experiment == 6 || cfg.mvConfig.experiment == 7) 
                   recordSize = cfg.mvConfig.recordSize;
           else if (cfg.mvConfig.experiment < 5)
                   recordSize = sizeof(SmallBankRecord);
           else
                   assert(false);
-          if (cfg.mvConfig.experiment < 3)
+          if (cfg.mvConfig.experiment < 3 || cfg.mvConfig.experiment == 5 ||
+              cfg.mvConfig.experiment == 6 || cfg.mvConfig.experiment == 7)
                   GLOBAL_RECORD_SIZE = 1000;
           else
                   GLOBAL_RECORD_SIZE = sizeof(SmallBankRecord);
@@ -5,9 +5,17 @@
 #include <preprocessor.h>
 #include <scheduler.h>
 #include <executor.h>
+#include <snapshot_reader.h>
+#include <command_log.h>
+#include <checkpoint.h>
+#include <watermark_sampler.h>
 #include <iostream>
 #include <fstream>
+#include <algorithm>
+#include <deque>
 #include <setup_workload.h>
+#include <small_bank.h>
+#include <setup_mv.h>
 
 #define INPUT_SIZE 2048
 #define OFFSET 0
@@ -15,8 +23,7 @@
 
 #define MV_DRY_RUNS 5
 
-static uint64_t dbSize = ((uint64_t)1<<36);
-extern uint32_t GLOBAL_RECORD_SIZE;
+#define MV_GC_HEADROOM 8
 
 Table** mv_tables;
 
@@ -67,12 +74,127 @@ static void CreateQueues(int cpuNumber, uint32_t subCount,
         *OUT_SUB_QUEUES = subQueues;
 }
 
+/*
+ * Shape of the CC thread broadcast tree. CC threads are grouped by the NUMA 
+ * node of the cpu they run on. Within a node, threads form a heap-ordered tree 
+ * rooted at the node's lowest numbered thread (the socket leader), and socket 
+ * leaders form a second tree rooted at thread 0. A batch therefore crosses the 
+ * interconnect once per remote socket. No node has more than fanout children, 
+ * leader and local children together: a socket leader with threads of its own 
+ * keeps at least one child slot for them, the rest of its slots go to leaders 
+ * first. Within a socket, and among leaders, each parent's slots are filled 
+ * in thread order before moving on to the next parent. A fanout of 0 leaves 
+ * the fan-out unbounded; a fanout of 1 is not allowed, since a chain can't 
+ * cross to another socket without leaving threads of this one behind.
+ *
+ * A parent always has a smaller thread id than its children, and leader 
+ * children come before local children so that remote subtrees start first.
+ */
+struct cc_tree {
+        std::vector<int> parent;
+        std::vector<uint32_t> childIndex;
+        std::vector<uint32_t> numChildren;
+        uint32_t depth;
+};
+
+static cc_tree build_cc_tree(uint32_t cpuStart, uint32_t numThreads, 
+                             uint32_t fanout)
+{
+        cc_tree tree;
+        std::vector<int> nodes;
+        std::vector<std::vector<uint32_t> > groups;
+        std::vector<uint32_t> leaders, depth, budget, kids;
+        std::deque<uint32_t> parents;
+        uint32_t i, j, k, g, d;
+        int node;
+
+        assert(fanout != 1);
+
+        tree.parent.assign(numThreads, -1);
+        tree.childIndex.assign(numThreads, 0);
+        tree.numChildren.assign(numThreads, 0);
+        tree.depth = 0;
+        
+        /* Group threads by socket, in order of first appearance. */
+        for (i = 0; i < numThreads; ++i) {
+                node = numa_available() < 0? 0 : numa_node_of_cpu(cpuStart + i);
+                for (g = 0; g < nodes.size(); ++g) 
+                        if (nodes[g] == node)
+                                break;
+                if (g == nodes.size()) {
+                        nodes.push_back(node);
+                        groups.push_back(std::vector<uint32_t>());
+                        leaders.push_back(i);
+                }
+                groups[g].push_back(i);
+        }
+
+        /* 
+         * Leader-to-leader edges first, then edges within each socket. 
+         * budget is the number of children a thread may take, kids the 
+         * number it has so far. 
+         */
+        budget.assign(numThreads, fanout == 0? numThreads : fanout);
+        kids.assign(numThreads, 0);
+        for (g = 0; g < groups.size(); ++g)
+                if (groups[g].size() > 1)
+                        budget[leaders[g]] -= 1;
+        parents.push_back(leaders[0]);
+        for (k = 1; k < leaders.size(); ++k) {
+                while (kids[parents.front()] == budget[parents.front()])
+                        parents.pop_front();
+                j = parents.front();
+                tree.parent[leaders[k]] = (int)j;
+                kids[j] += 1;
+                parents.push_back(leaders[k]);
+        }
+        budget.assign(numThreads, fanout == 0? numThreads : fanout);
+        for (g = 0; g < groups.size(); ++g) {
+                parents.clear();
+                parents.push_back(groups[g][0]);
+                for (k = 1; k < groups[g].size(); ++k) {
+                        while (kids[parents.front()] == 
+                               budget[parents.front()])
+                                parents.pop_front();
+                        j = parents.front();
+                        tree.parent[groups[g][k]] = (int)j;
+                        kids[j] += 1;
+                        parents.push_back(groups[g][k]);
+                }
+        }
+        for (k = 1; k < leaders.size(); ++k) {
+                j = (uint32_t)tree.parent[leaders[k]];
+                tree.childIndex[leaders[k]] = tree.numChildren[j]++;
+        }
+        for (g = 0; g < groups.size(); ++g) {
+                for (k = 1; k < groups[g].size(); ++k) {
+                        j = (uint32_t)tree.parent[groups[g][k]];
+                        tree.childIndex[groups[g][k]] = tree.numChildren[j]++;
+                }
+        }
+
+        depth.assign(numThreads, 0);
+        for (i = 1; i < numThreads; ++i) {
+                assert(tree.parent[i] >= 0 && (uint32_t)tree.parent[i] < i);
+                d = depth[tree.parent[i]] + 1;
+                depth[i] = d;
+                if (d > tree.depth)
+                        tree.depth = d;
+        }
+        return tree;
+}
+
 static MVSchedulerConfig SetupSched(int cpuNumber, 
                                     uint32_t threadId, 
-                                    int numThreads, 
+                                    uint32_t subCount,
                                     size_t alloc, 
                                     uint32_t numTables,
                                     size_t *partSizes, 
+                                    uint32_t numVParts,
+                                    MVTablePartition **partitions,
+                                    MVIndexType indexType,
+                                    uint32_t prefetchWindow,
+                                    bool rangeIndex,
                                     uint32_t numRecycles,
                                     SimpleQueue<ActionBatch> *inputQueue,
                                     uint32_t numOutputs,
@@ -80,36 +202,8 @@ static MVSchedulerConfig SetupSched(int cpuNumber,
                                     int worker_start,
                                     int worker_end) {
         assert(inputQueue != NULL && outputQueues != NULL);
-        uint32_t subCount;
         SimpleQueue<ActionBatch> **pubQueues, **subQueues;
-        if (threadId % 10 == 0) {
-                if (threadId == 0) {
-      
-                        // Figure out how many subordinates this thread is in charge of.
-                        uint32_t localSubordinates = numThreads > 10? 9 : numThreads-1;
-                        uint32_t numRemoteSockets = 
-                                numThreads/10 + (numThreads % 10 == 0? 0 : 1) - 1;
-                        subCount = (uint32_t)(localSubordinates + numRemoteSockets);
-                        CreateQueues(cpuNumber, subCount, &pubQueues, &subQueues);
-                }
-                else {
-                        int myDiv = threadId/10;
-                        int totalDiv = numThreads/10;
-                        if (myDiv < totalDiv) {
-                                subCount = 9;
-                        }
-                        else {
-                                subCount = (uint32_t)(numThreads - cpuNumber - 1);
-                        }      
-
-                        CreateQueues(cpuNumber, subCount, &pubQueues, &subQueues);      
-                }
-        }
-        else {
-                subCount = 0;
-                pubQueues = NULL;
-                subQueues = NULL;
-        }
+        CreateQueues(cpuNumber, subCount, &pubQueues, &subQueues);
 
         // Create recycle queue
         uint32_t recycleQueueSize = CACHE_LINE*64*numRecycles;
@@ -137,6 +231,11 @@ static MVSchedulerConfig SetupSched(int cpuNumber,
                 alloc,
                 numTables,
                 partSizes,
+                numVParts,
+                partitions,
+                indexType,
+                prefetchWindow,
+                rangeIndex,
                 numOutputs,
                 subCount,
                 numRecycles,
@@ -221,7 +320,7 @@ static SimpleQueue<RecordList>* SetupGCQueues(uint32_t cpuNumber,
 
 static ExecutorConfig SetupExec(uint32_t cpuNumber, uint32_t threadId, 
                                 uint32_t numWorkerThreads, 
-                                volatile uint32_t *epoch, 
+                                EpochTree *epochs, 
                                 volatile uint32_t *GClowWaterMarkPtr,
                                 uint64_t *recordSizes, 
                                 uint64_t *allocSizes,
@@ -229,14 +328,22 @@ static ExecutorConfig SetupExec(uint32_t cpuNumber, uint32_t threadId,
                                 SimpleQueue<ActionBatch> *outputQueue,
                                 uint32_t numCCThreads,
                                 uint32_t numTables, 
-                                uint32_t queuesPerTable) {  
+                                uint32_t queuesPerTable,
+                                uint32_t sliceSize,
+                                Executor **peers,
+                                ReaderEpochs *readers,
+                                PayloadPlacement placement,
+                                int *ccNodes,
+                                uint32_t lazyDepth) {  
   assert(inputQueue != NULL);  
   
-  // GC config
+  // GC config. Snapshot readers hold garbage collection back to the oldest 
+  // snapshot they may be reading.
   GarbageBinConfig gcConfig = SetupGCConfig(numCCThreads, numWorkerThreads, 
                                             numTables, 
                                             cpuNumber,
-                                            GClowWaterMarkPtr);
+                                            readers == NULL? GClowWaterMarkPtr :
+                                            &readers->safeEpoch);
 
   // GC queues for this particular worker
   SimpleQueue<RecordList> *gcQueues = SetupGCQueues(cpuNumber, queuesPerTable, 
@@ -245,20 +352,72 @@ static ExecutorConfig SetupExec(uint32_t cpuNumber, uint32_t threadId,
     threadId,
     numWorkerThreads,
     (int)cpuNumber,
-    epoch,
+    epochs,
     GClowWaterMarkPtr,
     inputQueue,
     outputQueue,
-    1,
+    numTables,
     recordSizes,
     allocSizes,
-    1,
+    queuesPerTable,
     gcQueues,
     gcConfig,
+    sliceSize,
+    peers,
+    readers,
+    placement,
+    ccNodes,
+    NULL,                       // Set by setup_restarts
+    lazyDepth,
   };
   return config;
 }
 
+/* 
+ * Group the executors, which run on the cpus from cpuStart on, by NUMA node 
+ * and into groups of at most EXEC_WM_FANOUT, see EpochTree.
+ */
+static EpochTree* SetupEpochTree(uint32_t cpuStart, uint32_t numWorkers) {
+  EpochTree *tree;
+  int nodes[numWorkers];
+  uint32_t i, j, node, count;
+
+  tree = (EpochTree*)alloc_mem(sizeof(EpochTree), cpuStart);
+  memset(tree, 0x0, sizeof(EpochTree));
+  tree->groupOf = (uint32_t*)malloc(sizeof(uint32_t)*numWorkers);
+  tree->members = (uint32_t*)malloc(sizeof(uint32_t)*numWorkers);
+  tree->groupStart = (uint32_t*)malloc(sizeof(uint32_t)*(numWorkers+1));
+  for (i = 0; i < numWorkers; ++i) {
+    nodes[i] = numa_available() < 0? 0 : numa_node_of_cpu(cpuStart + i);
+    if (nodes[i] < 0)
+      nodes[i] = 0;
+  }
+
+  // Members of a group are contiguous in members, groups of a node too.
+  count = 0;
+  for (node = 0; node < MAX_NUMA_NODES; ++node) {
+    j = 0;
+    for (i = 0; i < numWorkers; ++i) {
+      if (nodes[i] != (int)node)
+        continue;
+      if (j % EXEC_WM_FANOUT == 0)
+        tree->groupStart[tree->numGroups++] = count;
+      tree->groupOf[i] = tree->numGroups - 1;
+      tree->members[count++] = i;
+      j += 1;
+    }
+  }
+  assert(count == numWorkers);
+  tree->groupStart[tree->numGroups] = count;
+  tree->executors = (EpochSlot*)alloc_mem(sizeof(EpochSlot)*numWorkers, 
+                                          cpuStart);
+  tree->groups = (EpochSlot*)alloc_mem(sizeof(EpochSlot)*tree->numGroups, 
+                                       cpuStart);
+  memset(tree->executors, 0x0, sizeof(EpochSlot)*numWorkers);
+  memset(tree->groups, 0x0, sizeof(EpochSlot)*tree->numGroups);
+  return tree;
+}
+
 static Executor** SetupExecutors(uint32_t cpuStart,
                                  uint32_t numWorkers, 
                                  uint32_t numCCThreads,
@@ -266,21 +425,20 @@ static Executor** SetupExecutors(uint32_t cpuStart,
                                  SimpleQueue<ActionBatch> *inputQueue,
                                  SimpleQueue<ActionBatch> *outputQueue,
                                  uint32_t queuesPerCCThread,
-                                 SimpleQueue<MVRecordList> ***ccQueues) {  
+                                 SimpleQueue<MVRecordList> ***ccQueues,
+                                 uint32_t numTables,
+                                 uint64_t *recordSizes,
+                                 uint64_t *allocSizes,
+                                 uint32_t sliceSize,
+                                 ReaderEpochs *readers,
+                                 PayloadPlacement placement,
+                                 int *ccNodes,
+                                 uint32_t lazyDepth) {  
   assert(queuesPerCCThread == numWorkers);
   assert(queuesPerTable == numWorkers);
 
-  uint64_t threadDbSz = dbSize / numWorkers;
   Executor **execs = (Executor**)malloc(sizeof(Executor*)*numWorkers);
-  volatile uint32_t *epochArray = 
-    (volatile uint32_t*)malloc(sizeof(uint32_t)*(numWorkers+1));  
-  memset((void*)epochArray, 0x0, sizeof(uint32_t)*(numWorkers+1));
-
-  uint32_t numTables = 1;
-
-  uint64_t *sizeData = (uint64_t*)malloc(sizeof(uint64_t)*2);
-  sizeData[0] = GLOBAL_RECORD_SIZE;
-  sizeData[1] = threadDbSz/recordSize;
+  EpochTree *epochs = SetupEpochTree(cpuStart, numWorkers);
 
   // First pass, create configs. Each config contains a reference to each 
   // worker's local GC queue.
@@ -290,15 +448,21 @@ static Executor** SetupExecutors(uint32_t cpuStart,
           //    if (i == 0) {
           //            curOutput = &outputQueue[i];
           //    }
-    configs[i] = SetupExec(cpuStart+i, i, numWorkers, &epochArray[i], 
-                           &epochArray[numWorkers],
-                           &sizeData[0],
-                           &sizeData[1],
+    configs[i] = SetupExec(cpuStart+i, i, numWorkers, epochs, 
+                           &epochs->lowWatermark,
+                           recordSizes,
+                           allocSizes,
                            &inputQueue[i],
                            curOutput,
                            numCCThreads,
-                           1,
-                           queuesPerTable);
+                           numTables,
+                           queuesPerTable,
+                           sliceSize,
+                           execs,
+                           readers,
+                           placement,
+                           ccNodes,
+                           lazyDepth);
   }
   
   // Second pass, connect recycled data producers with consumers
@@ -313,10 +477,10 @@ static Executor** SetupExecutors(uint32_t cpuStart,
     // Connect to every workers gc queue
     for (uint32_t j = 0; j < numWorkers; ++j) {
       for (uint32_t k = 0; k < numTables; ++k) {
-        configs[i].garbageConfig.workerChannels[j] = 
+        configs[i].garbageConfig.workerChannels[j*numTables+k] = 
           &configs[j].recycleQueues[k*queuesPerTable+(i%queuesPerTable)];
+        assert(configs[i].garbageConfig.workerChannels[j*numTables+k] != NULL);
       }
-      assert(configs[i].garbageConfig.workerChannels[j] != NULL);
     }
     execs[i] = new ((int)(cpuStart+i)) Executor(configs[i]);
   }
@@ -393,21 +557,33 @@ static MVActionDistributor** SetupPPPThreads(uint32_t numProcs,
 
 static MVScheduler** SetupSchedulers(uint32_t cpuStart,
                                      int numProcs, 
+                                     uint32_t fanout,
                                      SimpleQueue<ActionBatch> *topInputQueue, 
                                      SimpleQueue<ActionBatch> **outputQueueRefs_OUT, 
                                      uint32_t numOutputs,
                                      size_t allocatorSize, 
                                      uint32_t numTables,
                                      size_t tableSize, 
+                                     uint32_t numVParts,
+                                     MVIndexType indexType,
+                                     uint32_t prefetchWindow,
+                                     bool rangeIndex,
                                      SimpleQueue<MVRecordList> ***gcRefs_OUT,
                                      int worker_start, int worker_end) {  
         
-  size_t partitionChunk = tableSize/numProcs;
+  size_t partitionChunk = tableSize/numVParts;
   size_t *tblPartitionSizes = (size_t*)malloc(numTables*sizeof(size_t));
   for (uint32_t i = 0; i < numTables; ++i) {
     tblPartitionSizes[i] = partitionChunk;
   }
 
+  // Every CC thread fills in the partitions it starts out owning
+  MVTablePartition **partitions = 
+    (MVTablePartition**)alloc_mem(sizeof(MVTablePartition*)*numVParts*numTables, 
+                                  0);
+  assert(partitions != NULL);
+  memset(partitions, 0x0, sizeof(MVTablePartition*)*numVParts*numTables);
+
   // Set up queues for leader thread
   /*
   char *inputArray = (char*)alloc_mem(CACHE_LINE*INPUT_SIZE, 0);            
@@ -420,61 +596,116 @@ static MVScheduler** SetupSchedulers(uint32_t cpuStart,
   
   MVScheduler **schedArray = 
     (MVScheduler**)alloc_mem(sizeof(MVScheduler*)*numProcs, 79);
+  MVSchedulerConfig configs[numProcs];
+  cc_tree tree = build_cc_tree(cpuStart, (uint32_t)numProcs, fanout);
   
-  MVSchedulerConfig globalLeaderConfig = SetupSched(cpuStart, 0, numProcs, 
-                                                    allocatorSize,
-                                                    numTables,
-                                                    tblPartitionSizes, 
-                                                    numOutputs,
-                                                    topInputQueue,
-                                                    numOutputs,
-                                                    leaderOutputQueues,
-                                                    worker_start, worker_end);
-
-  schedArray[0] = 
-    new (globalLeaderConfig.cpuNumber) MVScheduler(globalLeaderConfig);
-  gcRefs_OUT[0] = globalLeaderConfig.recycleQueues;
-
-  MVSchedulerConfig localLeaderConfig = globalLeaderConfig;
-  
-  for (uint32_t i = 1; i < numProcs; ++i) {
-    if (i % 10 == 0) {
-      int leaderNum = i/10;
-      auto inputQueue = globalLeaderConfig.pubQueues[9+leaderNum-1];
-      auto outputQueue = globalLeaderConfig.subQueues[9+leaderNum-1];
-      MVSchedulerConfig config = SetupSched(cpuStart + i, i, numProcs, allocatorSize, 
-                                            numTables,
-                                            tblPartitionSizes, 
-                                            numOutputs,
-                                            inputQueue, 
-                                            1,
-                                            outputQueue, worker_start,
-                                            worker_end);
-      schedArray[i] = new (config.cpuNumber) MVScheduler(config);
-      gcRefs_OUT[i] = config.recycleQueues;
-      localLeaderConfig = config;
-    }
-    else {
-      int index = i%10;      
-      auto inputQueue = localLeaderConfig.pubQueues[index-1];
-      auto outputQueue = localLeaderConfig.subQueues[index-1];
-      MVSchedulerConfig subConfig = SetupSched(cpuStart + i, i, numProcs, allocatorSize, 
-                                               numTables,
-                                               tblPartitionSizes, 
-                                               numOutputs,
-                                               inputQueue, 
-                                               1,
-                                               outputQueue, worker_start,
-                                               worker_end);
-      schedArray[i] = new (subConfig.cpuNumber) MVScheduler(subConfig);
-      gcRefs_OUT[i] = subConfig.recycleQueues;
-    }
+  configs[0] = SetupSched(cpuStart, 0, tree.numChildren[0], 
+                          allocatorSize,
+                          numTables,
+                          tblPartitionSizes, 
+                          numVParts,
+                          partitions,
+                          indexType,
+                          prefetchWindow,
+                          rangeIndex,
+                          numOutputs,
+                          topInputQueue,
+                          numOutputs,
+                          leaderOutputQueues,
+                          worker_start, worker_end);
+  schedArray[0] = new (configs[0].cpuNumber) MVScheduler(configs[0]);
+  gcRefs_OUT[0] = configs[0].recycleQueues;
+
+  /* Parents precede their children, so their queues already exist. */
+  for (uint32_t i = 1; i < (uint32_t)numProcs; ++i) {
+    MVSchedulerConfig *parent = &configs[tree.parent[i]];
+    auto inputQueue = parent->pubQueues[tree.childIndex[i]];
+    auto outputQueue = parent->subQueues[tree.childIndex[i]];
+    configs[i] = SetupSched(cpuStart + i, i, tree.numChildren[i], 
+                            allocatorSize, 
+                            numTables,
+                            tblPartitionSizes, 
+                            numVParts,
+                            partitions,
+                            indexType,
+                            prefetchWindow,
+                            rangeIndex,
+                            numOutputs,
+                            inputQueue, 
+                            1,
+                            outputQueue, worker_start,
+                            worker_end);
+    schedArray[i] = new (configs[i].cpuNumber) MVScheduler(configs[i]);
+    gcRefs_OUT[i] = configs[i].recycleQueues;
   }
   
   *outputQueueRefs_OUT = leaderOutputQueues;
   return schedArray;
 }
 
+/* 
+ * Number of tables in the workload, and the payload size of each table's 
+ * records. The YCSB procedures read and write all YCSB_RECORD_SIZE bytes of 
+ * a record, so only SmallBank's records are small enough to be inlined in 
+ * their version headers.
+ */
+uint32_t get_tables(MVConfig config, uint64_t *OUT_RECORD_SIZES)
+{
+        if (config.experiment < 3 || config.experiment == 5 || 
+            config.experiment == 6 || config.experiment == 7) {
+                OUT_RECORD_SIZES[0] = YCSB_RECORD_SIZE;
+                return 1;
+        } else if (config.experiment < 5) {
+                OUT_RECORD_SIZES[CHECKING] = sizeof(SmallBankRecord);
+                OUT_RECORD_SIZES[SAVINGS] = sizeof(SmallBankRecord);
+                return 2;
+        }
+        assert(false);
+        return 0;
+}
+
+/* 
+ * Whether every table's payloads fit in a version header, see 
+ * MVRecord::INLINE_VALUES. 
+ */
+static bool inline_values(MVConfig config)
+{
+        uint64_t record_sizes[MV_MAX_TABLES];
+        uint32_t num_tables, i;
+
+        num_tables = get_tables(config, record_sizes);
+        for (i = 0; i < num_tables; ++i)
+                if (record_sizes[i] > MV_INLINE_SIZE)
+                        return false;
+        return true;
+}
+
+/* Whether the workload has range reads, which need ordered partitions. */
+static bool uses_ranges(MVConfig config)
+{
+        return config.experiment == 5;
+}
+
+/* Whether the workload has txns that abort on their own. */
+static bool uses_aborts(workload_config config)
+{
+        return config.experiment == 3 && config.overdraft_abort != 0;
+}
+
+/* Whether the workload has txns that need recon, and may restart. */
+static bool uses_recon(MVConfig config)
+{
+        return config.experiment == 7;
+}
+
+/* Most records a txn of the workload writes. */
+static uint32_t writes_per_txn(MVConfig config)
+{
+        if (config.experiment == 3 || config.experiment == 4)
+                return 3;       // SmallBank Amalgamate
+        return config.txnSize;
+}
+
 static uint32_t get_num_epochs(MVConfig config)
 {
         uint32_t num_epochs;
@@ -485,149 +716,161 @@ static uint32_t get_num_epochs(MVConfig config)
         return num_epochs;
 }
 
-/*
- * Pre-process each txn's read- and write-sets. 
- * 
- * XXX Ideally, this should happen _online_, and "route" transactions to the
- * appropriate concurrency control threads, but we're doing it offline because 
- * it's good enough for experiments.
- *
- * Basically, make a linked list where the starts vector is of size NUM_CC_THREADS
- * vector[i] tells you the first index in the vector of composite keys that is for thread i
- * and each composite key has an int field 'next' that points to the next key for thread i
- *
- * So do we want to just move this to an outer layer? and the prepreprocessor just does this step
- * and then puts the txn in the appropriate output Qs (sending it to multiple CC threads, but only the relevant ones)
- * Instead of sending composite keys..
- *
- * Do we have issue with changing concurrency threads
- *
- * OK new idea... send batches of write/read actions to the concurrency control layer. each batch also has the batch of txns
- * in total order. I mean, the write/read actions could even be associated with the txn object, who cares.Then the concurrency
- * layer can output the associated batch of txn objects to the execution layer.
- *
- *
+/* 
+ * Create the arena for a batch of num_txns txns, sized for txns of up to 
+ * txn_size keys. 
  */
-/*
-static void do_preprocessing(vector<CompositeKey> &keys, vector<int> &starts)
-{
-        CompositeKey mv_key;
-        int indices[NUM_CC_THREADS], index, *ptr;
-        uint32_t i, num_keys;
-        for (i = 0; i < NUM_CC_THREADS; ++i)
-                indices[i] = -1;
-        num_keys = keys.size();
-        for (i = 0; i < num_keys; ++i) {
-                mv_key = keys[i];
-                if (indices[mv_key.threadId] != -1) {
-                  // If this key's thread ID is found
-                        index = indices[mv_key.threadId];
-                  // Look in the list of keys at that index
-                  // Assign ptr to the next field of that 
-                        ptr = &keys[index].next;
-                } else {
-                  // If it wasn't found, then put i in the starts vector
-                        ptr = &starts[mv_key.threadId];
-                }
-                indices[mv_key.threadId] = i;
-                *ptr = i;
-        }
-}*/
-
-static void convert_keys(mv_action *action, txn *txn)
-{
-        uint32_t i, num_reads, num_rmws, num_writes, num_entries;
-        struct big_key *array;
-
-        /* Alloc an array to poke txn information. */
-        num_reads = txn->num_reads();
-        num_rmws = txn->num_rmws();
-        num_writes = txn->num_writes();
-        if (num_reads >= num_rmws && num_reads >= num_writes) 
-                num_entries = num_reads;
-        else if (num_rmws >= num_writes) 
-                num_entries = num_rmws;
-        else 
-                num_entries = num_writes;
-        array = (struct big_key*)malloc(sizeof(struct big_key)*num_entries);
-                
-        /* Handle writes. */
-        txn->get_writes(array);
-        for (i = 0; i < num_writes; ++i)
-                action->add_write_key(array[i].table_id, array[i].key, false);
-
-        /* Handle rmws. */
-        txn->get_rmws(array);
-        for (i = 0; i < num_rmws; ++i)
-                action->add_write_key(array[i].table_id, array[i].key, true);
-        
-        /* Handle reads. */
-        txn->get_reads(array);
-        for (i = 0; i < num_reads; ++i)
-                action->add_read_key(array[i].table_id, array[i].key);
-        if (num_rmws == 0 && num_writes == 0)
-                action->__readonly = true;
-        free(array);
-}
-
-static mv_action* generate_mv_action(txn *txn)
+static ActionArena* create_arena(uint32_t num_txns, uint32_t txn_size)
 {
-        mv_action *action;
+        uint64_t per_txn;
 
-        /* Get the transaction's rw-sets. */
-        action = new mv_action(txn);
-        txn->set_translator(action);
-        convert_keys(action, txn);
+        per_txn = sizeof(mv_action*) + sizeof(mv_action) + CACHE_LINE + 
+                txn_size*sizeof(CompositeKey);
+        return new ActionArena(per_txn*num_txns);
+}
 
-        /* 
-         * Pre-process rw-sets for more concurrency control phase parallelism. 
-         */
-        /*
-        do_preprocessing(action->__writeset, action->__write_starts);
-        do_preprocessing(action->__readset, action->__read_starts);
-        */
-        action->setup_reverse_index();
-        return action;        
+/* An empty batch of up to num_txns txns, with its own arena. */
+static ActionBatch mv_alloc_action_batch(uint32_t num_txns, uint32_t txn_size)
+{
+        ActionBatch batch;
+        batch.numActions = 0;
+        batch.streams = NULL;
+        batch.owners = NULL;
+        batch.loads = NULL;
+        batch.timing = NULL;
+        batch.arena = create_arena(num_txns, txn_size);
+        batch.actionBuf = (mv_action**)
+                batch.arena->Alloc(sizeof(mv_action*)*num_txns, CACHE_LINE);
+        return batch;
 }
 
+/* 
+ * Generate an epoch's worth of txns. With snapshot readers, read-only txns 
+ * are dealt out to one batch per reader in OUT_READER_BATCHES instead of 
+ * going into the returned batch, they keep the epoch for bookkeeping only.
+ */
 static ActionBatch mv_create_action_batch(MVConfig config,
                                           workload_config w_config,
-                                          uint32_t epoch)
+                                          uint32_t epoch,
+                                          ActionBatch *OUT_READER_BATCHES)
 {
-        ActionBatch batch;
+        ActionBatch batch, *reader_batch;
         mv_action *action;
         txn *txn;
-        uint32_t i;
+        uint32_t i, num_readers, next_reader;
         uint64_t timestamp;
-        batch.numActions = config.epochSize;
-        batch.actionBuf =
-                (mv_action**)malloc(sizeof(mv_action*)*config.epochSize);
-        assert(batch.actionBuf != NULL);
+
+        num_readers = config.numReaderThreads;
+        batch = mv_alloc_action_batch(config.epochSize, config.txnSize);
+        for (i = 0; i < num_readers; ++i)
+                OUT_READER_BATCHES[i] = 
+                        mv_alloc_action_batch(config.epochSize/num_readers + 1,
+                                              config.txnSize);
+        next_reader = 0;
         for (i = 0; i < config.epochSize; ++i) {
-                timestamp = CREATE_MV_TIMESTAMP(epoch, i);
                 txn = generate_transaction(w_config);
-                action = generate_mv_action(txn);
-                action->__version = timestamp;
-                batch.actionBuf[i] = action;
+                if (num_readers > 0 && txn->num_writes() == 0 && 
+                    txn->num_rmws() == 0 && txn->num_ranges() == 0 &&
+                    txn->num_deletes() == 0 && !txn->needs_recon()) {
+                        reader_batch = &OUT_READER_BATCHES[next_reader];
+                        next_reader = (next_reader + 1) % num_readers;
+                        action = mv_action::generate(txn, reader_batch->arena);
+                        action->__version = CREATE_MV_TIMESTAMP(epoch, 0);
+                        reader_batch->actionBuf[reader_batch->numActions++] = 
+                                action;
+                } else {
+                        timestamp = CREATE_MV_TIMESTAMP(epoch, 
+                                                        batch.numActions);
+                        action = mv_action::generate(txn, batch.arena);
+                        action->__version = timestamp;
+                        batch.actionBuf[batch.numActions++] = action;
+                }
         }
         return batch;
 }
 
 static void mv_setup_input_array(std::vector<ActionBatch> *input,
+                                 std::vector<ActionBatch> *reader_input,
                                  MVConfig mv_config, workload_config w_config)
 {
-        uint32_t num_epochs;
+        uint32_t num_epochs, num_readers;
         ActionBatch batch;
         uint32_t i;
         
-        num_epochs = 2*get_num_epochs(mv_config);
+        /* 
+         * Fixed size epochs are timed while a second set keeps the pipeline 
+         * full. Adaptive epochs are cut from the txns of exactly numTxns.
+         */
+        num_readers = mv_config.numReaderThreads;
+        ActionBatch reader_batches[num_readers + 1];
+        num_epochs = get_num_epochs(mv_config);
+        if (mv_config.epochTargetUs == 0)
+                num_epochs *= 2;
         for (i = 0; i < num_epochs + MV_DRY_RUNS; ++i) {
-                batch = mv_create_action_batch(mv_config, w_config, i+2);
+                batch = mv_create_action_batch(mv_config, w_config, i+2, 
+                                               reader_batches);
                 input->push_back(batch);
+                reader_input->insert(reader_input->end(), reader_batches, 
+                                     reader_batches + num_readers);
         }
         std::cerr << "Done setting up mv input!\n";
 }
 
+/* 
+ * Rebuild the batches of the epochs in the command log, giving their txns the 
+ * timestamps they were logged with. Epochs up to checkpoint_epoch are already 
+ * part of the reloaded checkpoint. Executors count epochs by batch, so those 
+ * become empty batches that keep the epochs after them at their timestamps.
+ */
+static void mv_setup_replay_input(std::vector<ActionBatch> *input,
+                                  MVConfig mv_config, 
+                                  uint32_t checkpoint_epoch,
+                                  uint32_t *OUT_NUM_EPOCHS,
+                                  uint64_t *OUT_NUM_TXNS)
+{
+        std::vector<CommandLogRecord> epochs;
+        CommandLogHeader header;
+        CommandLogTxn entry;
+        ActionBatch batch;
+        mv_action *action;
+        uint64_t offset;
+        uint32_t i, j;
+        txn *t;
+
+        *OUT_NUM_EPOCHS = 0;
+        *OUT_NUM_TXNS = 0;
+        epochs = CommandLog::Read(mv_config.commandLog);
+        for (i = 0; i < epochs.size(); ++i) {
+                memcpy(&header, epochs[i].data, sizeof(CommandLogHeader));
+                if (header.epoch <= checkpoint_epoch) {
+                        input->push_back(mv_alloc_action_batch(1, 1));
+                        continue;
+                }
+                batch = mv_alloc_action_batch(std::max(header.numTxns, 
+                                                       (uint32_t)1),
+                                              mv_config.txnSize);
+                offset = sizeof(CommandLogHeader);
+                for (j = 0; j < header.numTxns; ++j) {
+                        memcpy(&entry, &epochs[i].data[offset], 
+                               sizeof(CommandLogTxn));
+                        offset += sizeof(CommandLogTxn);
+                        t = replay_transaction(entry.proc, 
+                                               &epochs[i].data[offset],
+                                               entry.size);
+                        offset += entry.size;
+                        action = mv_action::generate(t, batch.arena);
+                        action->__version = 
+                                CREATE_MV_TIMESTAMP(header.epoch, j);
+                        batch.actionBuf[batch.numActions++] = action;
+                }
+                assert(offset == header.size);
+                input->push_back(batch);
+                *OUT_NUM_EPOCHS += 1;
+                *OUT_NUM_TXNS += header.numTxns;
+        }
+        std::cerr << "Done reading " << epochs.size() << " logged epochs!\n";
+}
+
 static ActionBatch generate_db(workload_config conf)
 {
         txn **loader_txns;
@@ -640,21 +883,270 @@ static ActionBatch generate_db(workload_config conf)
         num_txns = generate_input(conf, &loader_txns);
         assert(loader_txns != NULL);
         ret.numActions = num_txns;
-        ret.actionBuf = (mv_action**)malloc(sizeof(mv_action*)*num_txns);
+        ret.streams = NULL;
+        ret.owners = NULL;
+        ret.loads = NULL;
+        ret.timing = NULL;
+        ret.arena = create_arena(num_txns, conf.txn_size);
+        ret.actionBuf = (mv_action**)
+                ret.arena->Alloc(sizeof(mv_action*)*num_txns, CACHE_LINE);
         for (i = 0; i < num_txns; ++i) {
-                ret.actionBuf[i] = generate_mv_action(loader_txns[i]);
+                ret.actionBuf[i] = mv_action::generate(loader_txns[i], 
+                                                      ret.arena);
                 timestamp = CREATE_MV_TIMESTAMP(1, i);
                 ret.actionBuf[i]->__version = timestamp;
         }
         return ret;
 }
  
-static void write_results(MVConfig config, timespec elapsed_time)
-{
+/* 
+ * Summary of an adaptive run for results.txt, the per-epoch records go to 
+ * epochs.txt. 
+ */
+struct epoch_summary {
         uint32_t num_epochs;
-        double elapsed_milli;
+        double avg_size;
+        double p99_latency_us;
+};
+
+/* 
+ * Command log of a run, or the log a replay run rebuilt the database from. 
+ * digest is a hash of every loaded key's newest value once all logged epochs 
+ * have executed (see state_digest), equal for a run and its replay.
+ */
+struct log_summary {
+        CommandLogStats stats;
+        uint32_t replayed_epochs;
+        uint64_t replayed_txns;
+        uint64_t digest;
+};
+
+/* 
+ * Checkpoints a run took, summed over the checkpoint threads, or the 
+ * checkpoint a replay reloaded instead of loading the database (reload_epoch 
+ * 0 if there was none). Reading covers the files being read and cut into 
+ * txns, installing the load batch of those txns going through the pipeline.
+ */
+struct checkpoint_summary {
+        CheckpointStats stats;
+        uint32_t reload_epoch;
+        uint64_t reload_keys;
+        uint64_t reload_bytes;
+        uint64_t reload_read_cycles;
+        uint64_t reload_install_cycles;
+};
+
+/* 
+ * Snapshot readers, each fed its own read-only batches through one input and 
+ * one output queue. 
+ */
+struct reader_pool {
+        uint32_t num_readers;
+        SnapshotReader **threads;
+        ReaderEpochs *epochs;
+        SimpleQueue<ActionBatch> *inputs;
+        SimpleQueue<ActionBatch> *outputs;
+};
+
+/* Stored procedures by txn_proc, as their abort counts are reported. */
+static const char *proc_names[NUM_PROCS] = {
+        "none",
+        "ycsb_readonly",
+        "ycsb_rmw",
+        "ycsb_churn",
+        "ycsb_scan",
+        "sb_balance",
+        "sb_deposit_checking",
+        "sb_transact_saving",
+        "sb_amalgamate",
+        "sb_write_check",
+};
+
+/* Deferred batches and the txns read-only txns forced, in lazy mode. */
+static void write_lazy_results(std::ofstream &out, MVConfig config, 
+                               const LazyStats &lazy)
+{
+        double reads, deferred;
+
+        if (config.lazyDepth == 0)
+                return;
+        reads = lazy.reads == 0? 1.0 : (double)lazy.reads;
+        deferred = lazy.deferred == 0? 1.0 : (double)lazy.deferred;
+        out << "lazy_depth:" << config.lazyDepth << " ";
+        out << "lazy_deferred_avg:" << lazy.deferred_sum / deferred << " ";
+        out << "lazy_deferred_max:" << lazy.deferred_max << " ";
+        out << "lazy_forced:" << lazy.forced << " ";
+        out << "lazy_forced_per_read:" << lazy.forced / reads << " ";
+        out << "lazy_idle_drains:" << lazy.idle_drains << " ";
+        out << "lazy_full_drains:" << lazy.full_drains << " ";
+}
+
+/* Delta versions written for increments, and how reads folded them. */
+static void write_delta_results(std::ofstream &out, MVConfig config, 
+                                const DeltaStats &deltas)
+{
+        double writes;
+
+        if (config.incrDeltas == 0)
+                return;
+        writes = deltas.writes == 0? 1.0 : (double)deltas.writes;
+        out << "incr_deltas:" << config.incrDeltas << " ";
+        out << "delta_writes:" << deltas.writes << " ";
+        out << "delta_read_fold_pct:" << 
+                100.0 * deltas.read_folds / writes << " ";
+        out << "fold_chain_max:" << deltas.fold_chain_max << " ";
+}
+
+/* Logic aborts, in all and for each stored procedure that had any. */
+static void write_abort_results(std::ofstream &out, bool aborts_enabled, 
+                                const AbortStats &aborts)
+{
+        uint32_t proc;
+
+        if (!aborts_enabled)
+                return;
+        out << "aborts:" << aborts.Total() << " ";
+        for (proc = 0; proc < NUM_PROCS; ++proc)
+                if (aborts.procs[proc] != 0)
+                        out << "aborts_" << proc_names[proc] << ":" << 
+                                aborts.procs[proc] << " ";
+}
+
+/* How often recon predictions went stale, and what restarts cost. */
+static void write_restart_results(std::ofstream &out, MVConfig config, 
+                                  const RestartStats &restarts, 
+                                  double cycles_per_micro)
+{
+        double recons, restarted;
+
+        if (!uses_recon(config))
+                return;
+        recons = restarts.recons == 0? 1.0 : (double)restarts.recons;
+        restarted = restarts.restarted == 0? 1.0 : (double)restarts.restarted;
+        out << "restart_pct:" << 100.0 * restarts.restarts / recons << " ";
+        out << "restart_extra_epochs:" << 
+                restarts.restart_epochs / restarted << " ";
+        out << "restart_extra_us:" << 
+                restarts.restart_cycles / restarted / cycles_per_micro << " ";
+}
+
+/* 
+ * How the low watermark kept up: the share of advances made by executor 0, 
+ * which a flat scheme would make all of, and the GC lag per executor and 
+ * epoch.
+ */
+static void write_watermark_results(std::ofstream &out, MVConfig config, 
+                                    Executor **exec_threads, 
+                                    const WatermarkStats &wm, double batches)
+{
+        double advances;
+
+        advances = wm.advances == 0? 1.0 : (double)wm.advances;
+        out << "wm_groups:" << exec_threads[0]->Epochs()->numGroups << " ";
+        out << "wm_advances_t0_pct:" << 
+                100.0 * exec_threads[0]->GetStats().wm.advances / advances << 
+                " ";
+        out << "wm_lag_avg:" << 
+                wm.lag_sum / batches / config.numWorkerThreads << " ";
+        out << "wm_lag_max:" << wm.lag_max << " ";
+}
+
+static void write_results(MVConfig config, bool aborts_enabled, 
+                          timespec elapsed_time,
+                          MVScheduler **sched_threads, Executor **exec_threads,
+                          reader_pool *readers, epoch_summary *epochs,
+                          log_summary *log, checkpoint_summary *ckpt)
+{
+        uint32_t num_epochs, i;
+        double elapsed_milli, cycles_per_micro, batches, cc_keys, 
+                cc_sched_cycles, cc_keys_max, cc_sched_max;
         std::ofstream result_file;
+        double exec_txns, exec_wakeups, payload_accesses;
+        uint64_t live_versions, live_payloads, gc_max_lag, dead_keys, 
+                vparts_adopted, version_grows, grow_lag_max, grown_bytes;
+        double gc_versions, gc_payloads, gc_releases, gc_lag;
+        GarbageBinStats gc_stats;
+        double reader_txns, reader_lag, reader_pins;
+        double log_syncs, log_epochs;
+        double ckpts, ckpt_seconds, reload_seconds, reload_read_seconds;
+        SnapshotReaderStats reader_stats;
+        MVSchedulerStats root_stats;
+        ExecutorStats exec_stats;
+        cc_tree tree;
         num_epochs = get_num_epochs(config);
+        tree = build_cc_tree(config.numPPPThreads, config.numCCThreads,
+                             config.ccFanout);
+        root_stats = sched_threads[0]->GetStats();
+        cc_keys = 0;
+        cc_sched_cycles = 0;
+        cc_keys_max = 0;
+        cc_sched_max = 0;
+        dead_keys = 0;
+        vparts_adopted = 0;
+        version_grows = 0;
+        grow_lag_max = 0;
+        grown_bytes = 0;
+        for (i = 0; i < config.numCCThreads; ++i) {
+                cc_keys += sched_threads[i]->GetStats().keys;
+                cc_sched_cycles += sched_threads[i]->GetStats().sched_cycles;
+                cc_keys_max = std::max(cc_keys_max, (double)
+                                       sched_threads[i]->GetStats().keys);
+                cc_sched_max = std::max(cc_sched_max, (double)
+                                        sched_threads[i]->GetStats().
+                                        sched_cycles);
+                dead_keys += sched_threads[i]->GetStats().dead_keys;
+                vparts_adopted += sched_threads[i]->GetStats().vparts_adopted;
+                version_grows += sched_threads[i]->GetStats().version_grows;
+                grow_lag_max = std::max(grow_lag_max, sched_threads[i]->
+                                        GetStats().grow_lag_max);
+                grown_bytes += sched_threads[i]->GrownVersions();
+        }
+        if (cc_keys == 0)
+                cc_keys = 1;
+        if (cc_sched_cycles == 0)
+                cc_sched_cycles = 1;
+        memset(&exec_stats, 0x0, sizeof(ExecutorStats));
+        for (i = 0; i < config.numWorkerThreads; ++i)
+                exec_stats.Add(exec_threads[i]->GetStats());
+        exec_txns = exec_stats.txns == 0? 1.0 : (double)exec_stats.txns;
+        exec_wakeups = exec_stats.wakeups == 0? 1.0 : 
+                (double)exec_stats.wakeups;
+        payload_accesses = exec_stats.payload_accesses == 0? 1.0 : 
+                (double)exec_stats.payload_accesses;
+        live_versions = 0;
+        for (i = 0; i < config.numCCThreads; ++i)
+                live_versions += sched_threads[i]->LiveVersions();
+        live_payloads = 0;
+        gc_versions = 0;
+        gc_payloads = 0;
+        gc_releases = 0;
+        gc_lag = 0;
+        gc_max_lag = 0;
+        for (i = 0; i < config.numWorkerThreads; ++i) {
+                live_payloads += exec_threads[i]->LivePayloads();
+                gc_stats = exec_threads[i]->GetGCStats();
+                gc_versions += gc_stats.versions;
+                gc_payloads += gc_stats.payloads;
+                gc_releases += gc_stats.releases;
+                gc_lag += gc_stats.lag_sum;
+                if (gc_stats.max_lag > gc_max_lag)
+                        gc_max_lag = gc_stats.max_lag;
+        }
+        if (gc_releases == 0)
+                gc_releases = 1;
+        reader_txns = 0;
+        reader_lag = 0;
+        reader_pins = 0;
+        for (i = 0; i < readers->num_readers; ++i) {
+                reader_stats = readers->threads[i]->GetStats();
+                reader_txns += reader_stats.txns;
+                reader_lag += reader_stats.snapshot_lag;
+                reader_pins += reader_stats.pins;
+        }
+        if (reader_txns == 0)
+                reader_txns = 1;
+        cycles_per_micro = FREQUENCY / 1000000.0;
+        batches = root_stats.batches == 0? 1.0 : (double)root_stats.batches;
         elapsed_milli =
                 1000.0*elapsed_time.tv_sec + elapsed_time.tv_nsec/1000000.0;
         std::cerr << "Number of txns: " << config.numTxns << "\n";
@@ -667,6 +1159,133 @@ static void write_results(MVConfig config, timespec elapsed_time)
         result_file << "workerthreads:" << config.numWorkerThreads << " ";
         result_file << "records:" << config.numRecords << " ";
         result_file << "read_pct:" << config.read_pct << " ";
+        result_file << "cc_fanout:" << config.ccFanout << " ";
+        result_file << "mv_index:" << config.indexType << " ";
+        result_file << "cc_window:" << config.ccWindow << " ";
+        result_file << "cc_ns_per_key:" << 
+                cc_sched_cycles / cc_keys * 1000.0 / cycles_per_micro << " ";
+        result_file << "cc_tree_depth:" << tree.depth << " ";
+        result_file << "cc_key_imbalance:" << 
+                cc_keys_max*config.numCCThreads / cc_keys << " ";
+        result_file << "cc_sched_imbalance:" << 
+                cc_sched_max*config.numCCThreads / cc_sched_cycles << " ";
+        if (config.numVParts != config.numCCThreads || 
+            config.repartitionInterval > 0) {
+                result_file << "vparts:" << config.numVParts << " ";
+                result_file << "repartition_interval:" << 
+                        config.repartitionInterval << " ";
+                result_file << "vpart_moves:" << vparts_adopted << " ";
+        }
+        result_file << "bcast_fanout_us:" << 
+                root_stats.fanout_cycles / batches / cycles_per_micro << " ";
+        result_file << "bcast_sched_us:" << 
+                root_stats.sched_cycles / batches / cycles_per_micro << " ";
+        result_file << "bcast_fanin_us:" << 
+                root_stats.fanin_cycles / batches / cycles_per_micro << " ";
+        result_file << "exec_parks:" << exec_stats.parks << " ";
+        result_file << "exec_waiting_avg:" << 
+                exec_stats.waiting_sum / exec_txns << " ";
+        result_file << "exec_waiting_max:" << exec_stats.max_waiting << " ";
+        result_file << "exec_wakeup_us:" << 
+                exec_stats.wakeup_cycles / exec_wakeups / cycles_per_micro << 
+                " ";
+        result_file << "exec_slice:" << config.execSlice << " ";
+        result_file << "gc_live_versions:" << live_versions << " ";
+        result_file << "gc_live_payloads:" << live_payloads << " ";
+        result_file << "gc_versions_per_epoch:" << gc_versions / batches << " ";
+        result_file << "gc_payloads_per_epoch:" << gc_payloads / batches << " ";
+        result_file << "gc_lag_avg:" << gc_lag / gc_releases << " ";
+        result_file << "gc_lag_max:" << gc_max_lag << " ";
+        result_file << "gc_dead_keys:" << dead_keys << " ";
+        write_watermark_results(result_file, config, exec_threads, 
+                                exec_stats.wm, batches);
+        result_file << "version_grows:" << version_grows << " ";
+        result_file << "version_grown_kb:" << grown_bytes / 1024 << " ";
+        result_file << "grow_lag_max:" << grow_lag_max << " ";
+        result_file << "readers:" << config.numReaderThreads << " ";
+        result_file << "reader_txns:" << reader_txns << " ";
+        result_file << "reader_lag_avg:" << reader_lag / reader_txns << " ";
+        result_file << "reader_pins:" << reader_pins << " ";
+        result_file << "epoch_target_us:" << config.epochTargetUs << " ";
+        if (epochs != NULL) {
+                result_file << "arrival_rate:" << config.arrivalRate << " ";
+                result_file << "epochs:" << epochs->num_epochs << " ";
+                result_file << "epoch_avg_size:" << epochs->avg_size << " ";
+                result_file << "epoch_p99_us:" << epochs->p99_latency_us << " ";
+        }
+        result_file << "exec_steals:" << exec_stats.steals << " ";
+        result_file << "exec_idle_us:" << 
+                exec_stats.idle_cycles / config.numWorkerThreads / batches / 
+                cycles_per_micro << " ";
+        result_file << "payload_placement:" << config.payloadPlacement << " ";
+        result_file << "payload_remote_pct:" << 
+                100.0 * exec_stats.payload_remote / payload_accesses << " ";
+        write_lazy_results(result_file, config, exec_stats.lazy);
+        write_delta_results(result_file, config, exec_stats.deltas);
+        write_abort_results(result_file, aborts_enabled, exec_stats.aborts);
+        write_restart_results(result_file, config, exec_stats.restarts, 
+                              cycles_per_micro);
+        if (log != NULL && config.replay) {
+                result_file << "replay_epochs:" << log->replayed_epochs << " ";
+                result_file << "replay_txns:" << log->replayed_txns << " ";
+                result_file << "log_digest:" << std::hex << log->digest << 
+                        std::dec << " ";
+        } else if (log != NULL) {
+                log_syncs = log->stats.syncs == 0? 1 : log->stats.syncs;
+                log_epochs = log->stats.epochs == 0? 1 : log->stats.epochs;
+                result_file << "log_epochs:" << log->stats.epochs << " ";
+                result_file << "log_kb_per_epoch:" << 
+                        log->stats.bytes / log_epochs / 1024.0 << " ";
+                result_file << "log_epochs_per_sync:" << 
+                        log->stats.epochs / log_syncs << " ";
+                result_file << "log_sync_us:" << 
+                        log->stats.sync_cycles / log_syncs / cycles_per_micro 
+                            << " ";
+                result_file << "log_release_waits:" << 
+                        log->stats.release_waits << " ";
+                result_file << "log_release_wait_us:" << 
+                        log->stats.release_wait_cycles / log_epochs / 
+                        cycles_per_micro << " ";
+                result_file << "log_digest:" << std::hex << log->digest << 
+                        std::dec << " ";
+        }
+        if (ckpt != NULL && config.replay) {
+                reload_read_seconds = 
+                        (double)ckpt->reload_read_cycles / FREQUENCY;
+                reload_seconds = reload_read_seconds + 
+                        (double)ckpt->reload_install_cycles / FREQUENCY;
+                if (reload_seconds == 0)
+                        reload_seconds = 1;
+                if (reload_read_seconds == 0)
+                        reload_read_seconds = 1;
+                result_file << "reload_epoch:" << ckpt->reload_epoch << " ";
+                result_file << "reload_keys:" << ckpt->reload_keys << " ";
+                result_file << "reload_mb:" << 
+                        ckpt->reload_bytes / 1048576.0 << " ";
+                result_file << "reload_ms:" << 1000.0 * reload_seconds << " ";
+                result_file << "reload_read_gbps:" << 
+                        ckpt->reload_bytes / reload_read_seconds / 1e9 << " ";
+                result_file << "reload_gbps:" << 
+                        ckpt->reload_bytes / reload_seconds / 1e9 << " ";
+        } else if (ckpt != NULL) {
+                ckpts = ckpt->stats.checkpoints == 0? 
+                        1 : ckpt->stats.checkpoints;
+                ckpt_seconds = (double)ckpt->stats.cycles / FREQUENCY;
+                if (ckpt_seconds == 0)
+                        ckpt_seconds = 1;
+                result_file << "ckpt_threads:" << 
+                        config.checkpointThreads << " ";
+                result_file << "ckpt_interval:" << 
+                        config.checkpointInterval << " ";
+                result_file << "ckpts:" << ckpt->stats.checkpoints << " ";
+                result_file << "ckpt_epoch:" << ckpt->stats.epoch << " ";
+                result_file << "ckpt_mb:" << 
+                        ckpt->stats.bytes / ckpts / 1048576.0 << " ";
+                result_file << "ckpt_ms:" << 
+                        1000.0 * ckpt_seconds / ckpts << " ";
+                result_file << "ckpt_gbps:" << 
+                        ckpt->stats.bytes / ckpt_seconds / 1e9 << " ";
+        }
         if (config.experiment == 0) {
                 result_file << "10rmw ";
         } else if (config.experiment == 1) {
@@ -675,6 +1294,12 @@ static void write_results(MVConfig config, timespec elapsed_time)
                 result_file << "5w ";
         } else if (config.experiment < 5) {
                 result_file << "small_bank ";
+        } else if (config.experiment == 5) {
+                result_file << "scan scan_len:" << config.read_txn_size << " ";
+        } else if (config.experiment == 6) {
+                result_file << "churn ";
+        } else if (config.experiment == 7) {
+                result_file << "ollp ";
         }        
         if (config.distribution == 0) {
                 result_file << "uniform";
@@ -686,53 +1311,400 @@ static void write_results(MVConfig config, timespec elapsed_time)
         
 }
 
+/* 
+ * Wait for batch i, epoch i+2 (see mv_setup_input_array), to come out of 
+ * every executor and snapshot reader. With a command log, the batch's results 
+ * are then held back until its epoch is durable.
+ */
+static void release_batch(SimpleQueue<ActionBatch> *output_queue,
+                          uint32_t num_workers, reader_pool *readers, 
+                          CommandLog *log, uint32_t i)
+{
+        uint32_t j;
+
+        for (j = 0; j < num_workers; ++j) 
+                (&output_queue[j])->DequeueBlocking();
+        for (j = 0; j < readers->num_readers; ++j)
+                (&readers->outputs[j])->DequeueBlocking();
+        if (log != NULL)
+                log->WaitDurable(i + 2);
+}
+
+/* 
+ * Feed batch i to the pipeline, logging it first if there is a command log. 
+ * The log thread writes it out while the batch is scheduled and executed.
+ */
+static void submit_batch(SimpleQueue<ActionBatch> *input_queue,
+                         const std::vector<ActionBatch> &inputs, 
+                         reader_pool *readers,
+                         const std::vector<ActionBatch> &reader_inputs,
+                         CommandLog *log, uint32_t i)
+{
+        uint32_t j, num_readers;
+
+        num_readers = readers->num_readers;
+        if (log != NULL)
+                log->Append(i + 2, inputs[i]);
+        input_queue->EnqueueBlocking(inputs[i]);
+        for (j = 0; j < num_readers; ++j) 
+                (&readers->inputs[j])->
+                        EnqueueBlocking(reader_inputs[i*num_readers+j]);
+}
+
+/* 
+ * With a command log, every batch is run to completion and made durable 
+ * before returning, so that the database reflects exactly the logged epochs. 
+ * Lazy executors acknowledge batches before running them, see wait_executed.
+ */
 static timespec run_experiment(SimpleQueue<ActionBatch> *input_queue,
                                SimpleQueue<ActionBatch> *output_queue,
                                std::vector<ActionBatch> inputs,
-                               uint32_t num_workers)
+                               uint32_t num_workers,
+                               reader_pool *readers,
+                               std::vector<ActionBatch> reader_inputs,
+                               CommandLog *log)
 {
-        uint32_t num_batches, num_wait_batches, i, j;
+        uint32_t num_batches, num_wait_batches, num_readers, i;
         struct timespec elapsed_time, end_time, start_time;
         num_batches = inputs.size();
         num_wait_batches = (num_batches - MV_DRY_RUNS) / 2;
+        num_readers = readers->num_readers;
+        assert(reader_inputs.size() == num_batches*num_readers);
 
         barrier();
-        for (i = 0; i < MV_DRY_RUNS; ++i)
-                input_queue->EnqueueBlocking(inputs[i]);
-        for (i = 0; i < MV_DRY_RUNS; ++i)
-                for (j = 0; j < num_workers; ++j)
-                        (&output_queue[j])->DequeueBlocking();
+        for (i = 0; i < MV_DRY_RUNS; ++i) 
+                submit_batch(input_queue, inputs, readers, reader_inputs, log, 
+                             i);
+        for (i = 0; i < MV_DRY_RUNS; ++i) 
+                release_batch(output_queue, num_workers, readers, log, i);
         barrier();
 
         clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start_time);
         barrier();                
-        for (i = MV_DRY_RUNS; i < num_batches; ++i) {
+        for (i = MV_DRY_RUNS; i < num_batches; ++i) 
+                submit_batch(input_queue, inputs, readers, reader_inputs, log, 
+                             i);
+        barrier();
+        for (i = MV_DRY_RUNS; i < num_wait_batches; ++i) 
+                release_batch(output_queue, num_workers, readers, log, i);
+        barrier();
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end_time);
+        barrier();
+        elapsed_time = diff_time(end_time, start_time);
+        if (log != NULL)
+                for (i = std::max(num_wait_batches, (uint32_t)MV_DRY_RUNS); 
+                     i < num_batches; ++i)
+                        release_batch(output_queue, num_workers, readers, log, 
+                                      i);
+        std::cerr << "Done running Bohm experiment!\n";
+        return elapsed_time;
+}
+
+/* 
+ * Run every logged epoch, see mv_setup_replay_input. At most half a queue of 
+ * batches is in flight, so a long log cannot fill every queue of the 
+ * pipeline. 
+ */
+static timespec run_replay(SimpleQueue<ActionBatch> *input_queue,
+                           SimpleQueue<ActionBatch> *output_queue,
+                           std::vector<ActionBatch> inputs,
+                           uint32_t num_workers)
+{
+        uint32_t num_batches, i, j;
+        struct timespec elapsed_time, end_time, start_time;
+        num_batches = inputs.size();
+
+        barrier();
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start_time);
+        barrier();
+        for (i = 0; i < num_batches; ++i) {
+                if (i >= INPUT_SIZE/2)
+                        for (j = 0; j < num_workers; ++j) 
+                                (&output_queue[j])->DequeueBlocking();
                 input_queue->EnqueueBlocking(inputs[i]);
         }
-        barrier();
-        for (i = MV_DRY_RUNS; i < num_wait_batches; ++i) {
+        for (i = std::max(num_batches, (uint32_t)INPUT_SIZE/2) - INPUT_SIZE/2; 
+             i < num_batches; ++i) 
                 for (j = 0; j < num_workers; ++j) 
                         (&output_queue[j])->DequeueBlocking();
+        barrier();
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end_time);
+        barrier();
+        elapsed_time = diff_time(end_time, start_time);
+        std::cerr << "Done replaying the command log!\n";
+        return elapsed_time;
+}
+
+/* The threads taking checkpoints during a run, see Checkpointer. */
+struct checkpoint_pool {
+        uint32_t num_threads;
+        Checkpointer **threads;
+};
+
+/* 
+ * Per-epoch state of an adaptive run. opened is when the epoch's first txn 
+ * arrived, executed when the last executor finished it.
+ */
+struct epoch_record {
+        EpochTiming timing;
+        uint64_t opened;
+        uint64_t executed;
+        uint32_t size;
+        bool timed_out;
+};
+
+#define EPOCH_WINDOW 100
+#define EPOCH_MAX_IN_FLIGHT 4
+
+/* 
+ * Sizes epochs to keep the p99 latency of txns under a target. A txn waits 
+ * at most until its epoch closes and then for the CC and execution stages, 
+ * so an epoch closes once it holds size txns, or once its first txn has 
+ * waited target minus the (smoothed) time the stages take. size shrinks 
+ * multiplicatively while more than 1% of the last EPOCH_WINDOW epochs miss 
+ * the target, and grows additively while epochs comfortably make it.
+ */
+struct epoch_controller {
+        uint32_t size;
+        uint32_t min_size;
+        uint32_t max_size;
+        double target;                  // cycles
+        double pipeline;                // cycles, closed to executed
+        bool missed[EPOCH_WINDOW];
+        uint32_t num_missed;
+        uint32_t num_epochs;
+};
+
+static void init_epoch_controller(epoch_controller *ctl, MVConfig config)
+{
+        memset(ctl, 0x0, sizeof(epoch_controller));
+        ctl->max_size = config.epochSize;
+        ctl->min_size = std::min(config.epochSize, (uint32_t)64);
+        ctl->size = ctl->max_size;
+        ctl->target = config.epochTargetUs * (FREQUENCY / 1000000.0);
+        ctl->pipeline = 0;
+}
+
+static uint64_t epoch_budget(epoch_controller *ctl)
+{
+        return (uint64_t)std::max(ctl->target - ctl->pipeline, 
+                                  ctl->target / 10);
+}
+
+static void epoch_feedback(epoch_controller *ctl, epoch_record *rec)
+{
+        double latency, pipeline;
+        uint32_t slot;
+        bool missed;
+
+        latency = rec->executed - rec->opened;
+        pipeline = rec->executed - rec->timing.closed;
+        if (ctl->num_epochs == 0)
+                ctl->pipeline = pipeline;
+        else
+                ctl->pipeline = 0.75*ctl->pipeline + 0.25*pipeline;
+
+        slot = ctl->num_epochs % EPOCH_WINDOW;
+        missed = latency > ctl->target;
+        if (ctl->num_epochs >= EPOCH_WINDOW && ctl->missed[slot])
+                ctl->num_missed -= 1;
+        ctl->missed[slot] = missed;
+        ctl->num_missed += missed;
+        ctl->num_epochs += 1;
+
+        if (missed && 100*ctl->num_missed > EPOCH_WINDOW)
+                ctl->size = std::max(ctl->min_size, ctl->size*3/4);
+        else if (!rec->timed_out && latency < 0.8*ctl->target)
+                ctl->size = std::min(ctl->max_size, ctl->size + ctl->size/8 + 1);
+}
+
+static void write_epochs(epoch_record *records, uint32_t num_epochs, 
+                         uint32_t first_epoch, epoch_summary *OUT_SUMMARY)
+{
+        std::ofstream epoch_file;
+        std::vector<double> latencies;
+        double cycles_per_micro, total_size;
+        uint32_t i;
+
+        cycles_per_micro = FREQUENCY / 1000000.0;
+        total_size = 0;
+        epoch_file.open("epochs.txt", std::ios::app | std::ios::out);
+        for (i = 0; i < num_epochs; ++i) {
+                epoch_record *rec = &records[i];
+                total_size += rec->size;
+                latencies.push_back((rec->executed - rec->opened) / 
+                                    cycles_per_micro);
+                epoch_file << "mv_epoch ";
+                epoch_file << "epoch:" << first_epoch + i << " ";
+                epoch_file << "size:" << rec->size << " ";
+                epoch_file << "close:" << (rec->timed_out? "time" : "count") << " ";
+                epoch_file << "wait_us:" << 
+                        (rec->timing.closed - rec->opened) / cycles_per_micro << " ";
+                epoch_file << "cc_us:" << 
+                        (rec->timing.scheduled - rec->timing.closed) / 
+                        cycles_per_micro << " ";
+                epoch_file << "exec_us:" << 
+                        (rec->executed - rec->timing.scheduled) / 
+                        cycles_per_micro << " ";
+                epoch_file << "latency_us:" << latencies.back() << "\n";
+        }
+        epoch_file.close();
+
+        std::sort(latencies.begin(), latencies.end());
+        OUT_SUMMARY->num_epochs = num_epochs;
+        OUT_SUMMARY->avg_size = num_epochs == 0? 0 : total_size / num_epochs;
+        OUT_SUMMARY->p99_latency_us = num_epochs == 0? 0 : 
+                latencies[(uint32_t)(0.99*(num_epochs - 1))];
+}
+
+/* 
+ * Run with adaptively sized epochs. inputs holds MV_DRY_RUNS fixed size 
+ * batches, followed by batches whose txns form one pool; epochs are cut from 
+ * the pool as txns arrive, and stamped with their timestamps when cut.
+ */
+static timespec run_adaptive_experiment(SimpleQueue<ActionBatch> *input_queue,
+                                        SimpleQueue<ActionBatch> *output_queue,
+                                        std::vector<ActionBatch> inputs,
+                                        MVConfig config,
+                                        epoch_summary *OUT_SUMMARY)
+{
+        uint32_t num_chunks, chunk_size, pool_size, next, num_epochs, 
+                completed, min_done, i, j, n, avail, first_epoch;
+        uint32_t done[config.numWorkerThreads];
+        uint64_t start, now, arrived, opened;
+        mv_action **pool;
+        epoch_record *records, *rec;
+        epoch_controller ctl;
+        ActionBatch batch, dummy;
+        struct timespec elapsed_time, end_time, start_time;
+        bool waiting;
+
+        assert(inputs.size() > MV_DRY_RUNS);
+        num_chunks = inputs.size() - MV_DRY_RUNS;
+        chunk_size = config.epochSize;
+        pool_size = num_chunks*chunk_size;
+        pool = (mv_action**)malloc(sizeof(mv_action*)*pool_size);
+        records = (epoch_record*)malloc(sizeof(epoch_record)*pool_size);
+        assert(pool != NULL && records != NULL);
+        for (i = 0; i < num_chunks; ++i) {
+                assert(inputs[MV_DRY_RUNS+i].numActions == chunk_size);
+                memcpy(&pool[i*chunk_size], inputs[MV_DRY_RUNS+i].actionBuf,
+                       sizeof(mv_action*)*chunk_size);
+        }
+        init_epoch_controller(&ctl, config);
+        memset(done, 0x0, sizeof(uint32_t)*config.numWorkerThreads);
+        first_epoch = MV_DRY_RUNS + 2;
+
+        barrier();
+        for (i = 0; i < MV_DRY_RUNS; ++i)
+                input_queue->EnqueueBlocking(inputs[i]);
+        for (i = 0; i < MV_DRY_RUNS; ++i)
+                for (j = 0; j < config.numWorkerThreads; ++j)
+                        (&output_queue[j])->DequeueBlocking();
+        barrier();
+
+        clock_gettime(CLOCK_THREAD_CPUTIME_ID, &start_time);
+        start = rdtsc();
+        next = 0;
+        num_epochs = 0;
+        completed = 0;
+        while (completed < num_epochs || next < pool_size) {
+                
+                /* Epochs are done once every executor has finished them. */
+                min_done = num_epochs;
+                for (j = 0; j < config.numWorkerThreads; ++j) {
+                        while ((&output_queue[j])->Dequeue(&dummy))
+                                done[j] += 1;
+                        min_done = std::min(min_done, done[j]);
+                }
+                now = rdtsc();
+                for (; completed < min_done; ++completed) {
+                        records[completed].executed = now;
+                        epoch_feedback(&ctl, &records[completed]);
+                }
+
+                if (next == pool_size || 
+                    num_epochs - completed >= EPOCH_MAX_IN_FLIGHT)
+                        continue;
+
+                /* Close the next epoch on its txn count or time budget. */
+                if (config.arrivalRate == 0) {
+                        arrived = pool_size;
+                        opened = now;
+                } else {
+                        arrived = (now - start) * config.arrivalRate / FREQUENCY;
+                        arrived = std::min(arrived, (uint64_t)pool_size);
+                        opened = start + 
+                                (uint64_t)next * FREQUENCY / config.arrivalRate;
+                }
+                if (arrived <= next)
+                        continue;
+                avail = arrived - next;
+                waiting = avail < ctl.size && arrived < pool_size;
+                if (waiting && now - opened < epoch_budget(&ctl))
+                        continue;
+                n = std::min(avail, ctl.size);
+                
+                rec = &records[num_epochs];
+                rec->timed_out = waiting;
+                rec->opened = opened;
+                rec->size = n;
+                rec->timing.closed = now;
+                rec->timing.scheduled = 0;
+                batch.actionBuf = &pool[next];
+                batch.numActions = n;
+                batch.streams = NULL;
+                batch.owners = NULL;
+                batch.loads = NULL;
+                batch.timing = &rec->timing;
+                batch.arena = NULL;
+                for (i = 0; i < n; ++i)
+                        pool[next+i]->__version = 
+                                CREATE_MV_TIMESTAMP(first_epoch + num_epochs, i);
+
+                /* 
+                 * Epochs never exceed a chunk, so at most one chunk's last 
+                 * txn falls in this one. Its arena is released with this 
+                 * epoch.
+                 */
+                if ((next + n) / chunk_size > next / chunk_size)
+                        batch.arena = inputs[MV_DRY_RUNS + 
+                                             (next + n) / chunk_size - 1].arena;
+                next += n;
+                num_epochs += 1;
+                input_queue->EnqueueBlocking(batch);
         }
         barrier();
         clock_gettime(CLOCK_THREAD_CPUTIME_ID, &end_time);
         barrier();
         elapsed_time = diff_time(end_time, start_time);
-        std::cerr << "Done running Bohm experiment!\n";
+        write_epochs(records, num_epochs, first_epoch, OUT_SUMMARY);
+        free(records);
+        std::cerr << "Done running adaptive Bohm experiment!\n";
         return elapsed_time;
 }
 
+/* 
+ * Load the database, or install the reloaded checkpoint in reload_batch if 
+ * there is one. 
+ */
 static void init_database(MVConfig config,
                           workload_config w_conf,
                           SimpleQueue<ActionBatch> *input_queue,
                           SimpleQueue<ActionBatch> *output_queue,
                           MVActionDistributor **ppp_threads,
                           MVScheduler **sched_threads,
-                          Executor **exec_threads)
+                          Executor **exec_threads,
+                          reader_pool *readers,
+                          CommandLog *log,
+                          checkpoint_pool *checkpointers,
+                          ActionBatch *reload_batch,
+                          checkpoint_summary *ckpt)
                           
 {
         uint32_t i;
         ActionBatch init_batch;
+        uint64_t start;
         int pin_success;
         pin_success = pin_thread(79);
         assert(pin_success == 0);
@@ -741,7 +1713,10 @@ static void init_database(MVConfig config,
                 ppp_threads[i]->WaitInit();
         }
 
-        init_batch = generate_db(w_conf);
+        if (reload_batch != NULL)
+                init_batch = *reload_batch;
+        else
+                init_batch = generate_db(w_conf);
         for (i = 0; i < config.numCCThreads; ++i) {
                 sched_threads[i]->Run();        
                 sched_threads[i]->WaitInit();
@@ -750,11 +1725,26 @@ static void init_database(MVConfig config,
                 exec_threads[i]->Run();
                 exec_threads[i]->WaitInit();                
         }
+        for (i = 0; i < readers->num_readers; ++i) {
+                readers->threads[i]->Run();
+                readers->threads[i]->WaitInit();
+        }
+        if (log != NULL) {
+                log->Run();
+                log->WaitInit();
+        }
+        for (i = 0; i < checkpointers->num_threads; ++i) {
+                checkpointers->threads[i]->Run();
+                checkpointers->threads[i]->WaitInit();
+        }
 
+        start = rdtsc();
         input_queue->EnqueueBlocking(init_batch);
         for (i = 0; i < config.numWorkerThreads; ++i) 
                 (&output_queue[i])->DequeueBlocking();
         barrier();
+        if (reload_batch != NULL)
+                ckpt->reload_install_cycles = rdtsc() - start;
         std::cerr << "Done loading the database!\n";
         return;
 }
@@ -775,7 +1765,8 @@ static MVScheduler** setup_scheduler_threads(MVConfig config,
                                              SimpleQueue<ActionBatch> **sched_output,
                                              SimpleQueue<MVRecordList> ***gc_queues)
 {
-        uint64_t stickies_per_thread;
+        uint64_t stickies_per_thread, num_versions, 
+                record_sizes[MV_MAX_TABLES];
         uint32_t num_tables;
         MVScheduler **schedulers;
         int worker_start, worker_end;
@@ -783,19 +1774,29 @@ static MVScheduler** setup_scheduler_threads(MVConfig config,
         
         worker_start = (int)config.numCCThreads;
         worker_end = worker_start + config.numWorkerThreads - 1;
-        if (config.experiment < 3) {
-                stickies_per_thread = (((uint64_t)1)<<27);
-                num_tables = 1;
-        } else if (config.experiment < 5) {
-                stickies_per_thread = (((uint64_t)1)<<24);
-                num_tables = 2;
-        } else {
-                assert(false);
-        }
-        schedulers = SetupSchedulers(cpuStart, config.numCCThreads, sched_input,
+        num_tables = get_tables(config, record_sizes);
+
+        /* 
+         * Version headers per CC thread: two for each record it owns, plus 
+         * the writes of the epochs the low watermark normally lags by, 
+         * MV_GC_HEADROOM and any deferred by lazy executors. This is a soft 
+         * limit: snapshot readers and checkpoints pin epochs for longer, and 
+         * skew sends more writes to some CC threads, so a thread that runs 
+         * out grows its allocator (see MVScheduler::RefillVersions).
+         */
+        num_versions = (2*(uint64_t)config.numRecords*num_tables + 
+                        (MV_GC_HEADROOM + config.lazyDepth)*
+                        (uint64_t)config.epochSize*writes_per_txn(config))
+                / config.numCCThreads;
+        stickies_per_thread = num_versions*MVRecord::HeaderSize();
+        schedulers = SetupSchedulers(cpuStart, config.numCCThreads, 
+                                     config.ccFanout, sched_input,
                                      sched_output, config.numWorkerThreads+1,
                                      stickies_per_thread, num_tables,
-                                     config.numRecords, gc_queues,
+                                     config.numRecords, config.numVParts,
+                                     (MVIndexType)config.indexType, 
+                                     config.ccWindow, uses_ranges(config),
+                                     gc_queues,
                                      worker_start,
                                      worker_end);
         assert(schedulers != NULL);
@@ -807,24 +1808,380 @@ static MVScheduler** setup_scheduler_threads(MVConfig config,
         return schedulers;
 }
 
+/* Every virtual partition's partitions, [vpart*numTables + table]. */
+static MVTablePartition** get_partitions(MVConfig config, 
+                                         MVScheduler **sched_threads)
+{
+        MVTablePartition **partitions;
+        uint64_t record_sizes[MV_MAX_TABLES];
+        uint32_t i, j, num_tables;
+
+        num_tables = get_tables(config, record_sizes);
+        partitions = (MVTablePartition**)
+                malloc(sizeof(MVTablePartition*)*config.numVParts*num_tables);
+        assert(partitions != NULL);
+        for (i = 0; i < config.numVParts; ++i)
+                for (j = 0; j < num_tables; ++j)
+                        partitions[i*num_tables+j] = 
+                                sched_threads[0]->GetPartition(i, j);
+        return partitions;
+}
+
+static bool takes_checkpoints(MVConfig config)
+{
+        return config.checkpointDir != NULL && !config.replay;
+}
+
+/* 
+ * Readers run on the cpus after the executors and look keys up directly in 
+ * the CC threads' partitions. The checkpointer pins epochs like a reader, its 
+ * pin comes after the readers' ones.
+ */
+static void setup_readers(MVConfig config, MVScheduler **sched_threads, 
+                          reader_pool *OUT_POOL)
+{
+        SnapshotReaderConfig reader_config;
+        MVTablePartition **partitions;
+        uint32_t i, num_tables, num_pins, start_cpu;
+        uint64_t record_sizes[MV_MAX_TABLES];
+        ReaderEpochs *epochs;
+
+        OUT_POOL->num_readers = config.numReaderThreads;
+        OUT_POOL->threads = NULL;
+        OUT_POOL->epochs = NULL;
+        OUT_POOL->inputs = NULL;
+        OUT_POOL->outputs = NULL;
+        if (config.numReaderThreads == 0 && !takes_checkpoints(config))
+                return;
+
+        num_pins = config.numReaderThreads + 
+                (takes_checkpoints(config)? 1 : 0);
+        epochs = (ReaderEpochs*)alloc_mem(sizeof(ReaderEpochs), 0);
+        assert(epochs != NULL);
+        memset(epochs, 0x0, sizeof(ReaderEpochs));
+        epochs->numReaders = num_pins;
+        epochs->pins = (ReaderPin*)alloc_mem(sizeof(ReaderPin)*num_pins, 0);
+        assert(epochs->pins != NULL);
+        memset(epochs->pins, 0x0, sizeof(ReaderPin)*num_pins);
+        OUT_POOL->epochs = epochs;
+        if (config.numReaderThreads == 0)
+                return;
+
+        num_tables = get_tables(config, record_sizes);
+        partitions = get_partitions(config, sched_threads);
+        OUT_POOL->inputs = SetupQueuesMany<ActionBatch>(INPUT_SIZE, 
+                                                        config.numReaderThreads,
+                                                        0);
+        OUT_POOL->outputs = SetupQueuesMany<ActionBatch>(INPUT_SIZE, 
+                                                         config.numReaderThreads,
+                                                         0);
+        OUT_POOL->threads = (SnapshotReader**)
+                malloc(sizeof(SnapshotReader*)*config.numReaderThreads);
+        start_cpu = config.numCCThreads + config.numPPPThreads + 
+                config.numWorkerThreads;
+        for (i = 0; i < config.numReaderThreads; ++i) {
+                reader_config.threadId = i;
+                reader_config.cpu = start_cpu + i;
+                reader_config.numTables = num_tables;
+                reader_config.partitions = partitions;
+                reader_config.epochs = epochs;
+                reader_config.inputQueue = &OUT_POOL->inputs[i];
+                reader_config.outputQueue = &OUT_POOL->outputs[i];
+                OUT_POOL->threads[i] = 
+                        new (reader_config.cpu) SnapshotReader(reader_config);
+        }
+        std::cerr << "Done setting up snapshot readers!\n";
+}
+
 static Executor** setup_executors(MVConfig config,
                                   SimpleQueue<ActionBatch> *sched_outputs,
                                   SimpleQueue<ActionBatch> *output_queue,
-                                  SimpleQueue<MVRecordList> ***gc_queues)
+                                  SimpleQueue<MVRecordList> ***gc_queues,
+                                  ReaderEpochs *readers)
 {
-        uint32_t start_cpu, queues_per_table, queues_per_cc_thread;
+        uint32_t start_cpu, queues_per_table, queues_per_cc_thread, num_tables;
+        uint64_t *record_sizes, *alloc_sizes;
+        int *cc_nodes;
         Executor **execs;
         start_cpu = config.numCCThreads + config.numPPPThreads;
         queues_per_table = config.numWorkerThreads;
         queues_per_cc_thread = config.numWorkerThreads;
+
+        /* 
+         * Each executor starts with payloads for its share of the database 
+         * plus a few epochs' worth of new versions; its allocators grow if 
+         * garbage collection falls behind. With inline values, payloads 
+         * live in the version headers instead.
+         */
+        record_sizes = (uint64_t*)malloc(sizeof(uint64_t)*MV_MAX_TABLES);
+        alloc_sizes = (uint64_t*)malloc(sizeof(uint64_t)*MV_MAX_TABLES);
+        num_tables = get_tables(config, record_sizes);
+        for (uint32_t i = 0; i < num_tables; ++i) {
+                if (MVRecord::INLINE_VALUES)
+                        alloc_sizes[i] = 0;
+                else
+                        alloc_sizes[i] = 
+                                config.numRecords/config.numWorkerThreads + 
+                                4*config.epochSize;
+        }
+
+        /* CC threads run on the cpus following the distributors. */
+        cc_nodes = (int*)malloc(sizeof(int)*config.numCCThreads);
+        for (uint32_t i = 0; i < config.numCCThreads; ++i) 
+                cc_nodes[i] = numa_available() < 0? 0 : 
+                        numa_node_of_cpu(config.numPPPThreads + i);
         execs = SetupExecutors(start_cpu, config.numWorkerThreads,
                                config.numCCThreads, queues_per_table,
                                sched_outputs, output_queue,
-                               queues_per_cc_thread, gc_queues);
+                               queues_per_cc_thread, gc_queues, num_tables,
+                               record_sizes, alloc_sizes, config.execSlice,
+                               readers,
+                               (PayloadPlacement)config.payloadPlacement,
+                               cc_nodes, config.lazyDepth);
         std::cerr << "Done setting up executors!\n";
         return execs;
 }
 
+/* 
+ * Every executor resubmits txns through its own queue to the distributor 
+ * that takes batches off the input queue. 
+ */
+static void setup_restarts(MVConfig config, MVActionDistributor *distributor,
+                           Executor **exec_threads)
+{
+        SimpleQueue<RestartedTxn> *queues;
+        uint32_t i, size;
+
+        size = 1;
+        while (size < 2*config.epochSize)
+                size <<= 1;
+        queues = SetupQueuesMany<RestartedTxn>(size, config.numWorkerThreads,
+                                               0);
+        for (i = 0; i < config.numWorkerThreads; ++i)
+                exec_threads[i]->SetRestartQueue(&queues[i]);
+        distributor->SetRestarts(exec_threads[0]->Watermark(), queues, 
+                                 config.numWorkerThreads);
+}
+
+/* The log thread runs on the cpu after the snapshot readers. */
+static CommandLog* setup_command_log(MVConfig config)
+{
+        CommandLogConfig log_config;
+        CommandLog *log;
+
+        if (config.commandLog == NULL || config.replay)
+                return NULL;
+        log_config.cpu = config.numCCThreads + config.numPPPThreads + 
+                config.numWorkerThreads + config.numReaderThreads;
+        log_config.path = config.commandLog;
+        log_config.inputQueue = 
+                SetupQueuesMany<CommandLogRecord>(INPUT_SIZE, 1, 
+                                                  log_config.cpu);
+        log = new (log_config.cpu) CommandLog(log_config);
+        std::cerr << "Done setting up the command log!\n";
+        return log;
+}
+
+/* 
+ * Checkpoint threads run on the cpus after the log thread. A run starts over 
+ * from its own load and truncates its command log, so an older checkpoint in 
+ * the directory is dropped first.
+ */
+static void setup_checkpointers(MVConfig config, MVScheduler **sched_threads,
+                                ReaderEpochs *epochs, 
+                                checkpoint_pool *OUT_POOL)
+{
+        CheckpointConfig ckpt_config;
+        CheckpointRound *round;
+        uint64_t *record_sizes;
+        uint32_t i, num_tables, start_cpu;
+
+        OUT_POOL->num_threads = 0;
+        OUT_POOL->threads = NULL;
+        if (!takes_checkpoints(config))
+                return;
+
+        Checkpointer::RemoveManifest(config.checkpointDir);
+        record_sizes = (uint64_t*)malloc(sizeof(uint64_t)*MV_MAX_TABLES);
+        num_tables = get_tables(config, record_sizes);
+        round = (CheckpointRound*)alloc_mem(sizeof(CheckpointRound), 0);
+        assert(round != NULL);
+        memset(round, 0x0, sizeof(CheckpointRound));
+        start_cpu = config.numCCThreads + config.numPPPThreads + 
+                config.numWorkerThreads + config.numReaderThreads + 
+                (config.commandLog != NULL? 1 : 0);
+        OUT_POOL->num_threads = config.checkpointThreads;
+        OUT_POOL->threads = (Checkpointer**)
+                malloc(sizeof(Checkpointer*)*config.checkpointThreads);
+        for (i = 0; i < config.checkpointThreads; ++i) {
+                ckpt_config.threadId = i;
+                ckpt_config.numThreads = config.checkpointThreads;
+                ckpt_config.cpu = start_cpu + i;
+                ckpt_config.numTables = num_tables;
+                ckpt_config.numPartitions = config.numVParts;
+                ckpt_config.partitions = get_partitions(config, sched_threads);
+                ckpt_config.recordSizes = record_sizes;
+                ckpt_config.dir = config.checkpointDir;
+                ckpt_config.interval = config.checkpointInterval;
+                ckpt_config.epochs = epochs;
+                ckpt_config.pinId = config.numReaderThreads;
+                ckpt_config.round = round;
+                OUT_POOL->threads[i] = 
+                        new (ckpt_config.cpu) Checkpointer(ckpt_config);
+        }
+        std::cerr << "Done setting up checkpointers!\n";
+}
+
+/* The watermark sampler runs on the cpu after the checkpoint threads. */
+static WatermarkSampler* setup_watermark_sampler(MVConfig config, 
+                                                 EpochTree *epochs)
+{
+        WatermarkSamplerConfig sampler_config;
+        WatermarkSampler *sampler;
+
+        if (config.wmReportMs == 0)
+                return NULL;
+        sampler_config.cpu = config.numCCThreads + config.numPPPThreads + 
+                config.numWorkerThreads + config.numReaderThreads + 
+                (config.commandLog != NULL? 1 : 0) + 
+                (takes_checkpoints(config)? config.checkpointThreads : 0);
+        sampler_config.epochs = epochs;
+        sampler_config.intervalMs = config.wmReportMs;
+        sampler = new (sampler_config.cpu) WatermarkSampler(sampler_config);
+        std::cerr << "Done setting up the watermark sampler!\n";
+        return sampler;
+}
+
+/* 
+ * Sum the checkpoint threads' shares, thread 0 keeps the per-checkpoint 
+ * counts. 
+ */
+static void checkpoint_stats(checkpoint_pool *checkpointers, 
+                             checkpoint_summary *OUT_SUMMARY)
+{
+        CheckpointStats stats;
+        uint32_t i;
+
+        if (checkpointers->num_threads == 0)
+                return;
+        OUT_SUMMARY->stats = checkpointers->threads[0]->GetStats();
+        for (i = 1; i < checkpointers->num_threads; ++i) {
+                stats = checkpointers->threads[i]->GetStats();
+                OUT_SUMMARY->stats.records += stats.records;
+                OUT_SUMMARY->stats.bytes += stats.bytes;
+                OUT_SUMMARY->stats.write_cycles += stats.write_cycles;
+        }
+}
+
+/* 
+ * Read the newest checkpoint in the checkpoint directory with one reader per 
+ * file, on the cpus the checkpoint threads run on in a normal run, and turn 
+ * it into a load batch. Returns false if there is no checkpoint.
+ */
+static bool load_checkpoint(MVConfig config, ActionBatch *OUT_BATCH,
+                            checkpoint_summary *OUT_SUMMARY)
+{
+        CheckpointManifest manifest;
+        CheckpointReaderConfig reader_config;
+        CheckpointReader **readers;
+        std::vector<txn*> loads;
+        uint32_t i, j, start_cpu;
+        uint64_t start;
+
+        if (config.checkpointDir == NULL || 
+            !Checkpointer::ReadManifest(config.checkpointDir, &manifest))
+                return false;
+
+        start = rdtsc();
+        start_cpu = config.numCCThreads + config.numPPPThreads + 
+                config.numWorkerThreads + config.numReaderThreads;
+        readers = (CheckpointReader**)
+                malloc(sizeof(CheckpointReader*)*manifest.numFiles);
+        for (i = 0; i < manifest.numFiles; ++i) {
+                reader_config.cpu = start_cpu + i;
+                reader_config.dir = config.checkpointDir;
+                reader_config.epoch = manifest.epoch;
+                reader_config.fileId = i;
+                readers[i] = new (reader_config.cpu) 
+                        CheckpointReader(reader_config);
+                readers[i]->Run();
+        }
+        OUT_SUMMARY->reload_bytes = 0;
+        for (i = 0; i < manifest.numFiles; ++i) {
+                readers[i]->WaitDone();
+                loads.insert(loads.end(), readers[i]->GetLoads().begin(),
+                             readers[i]->GetLoads().end());
+                OUT_SUMMARY->reload_bytes += readers[i]->Bytes();
+        }
+
+        *OUT_BATCH = mv_alloc_action_batch(std::max((uint32_t)loads.size(), 
+                                                    (uint32_t)1),
+                                           CHECKPOINT_LOAD_KEYS);
+        OUT_SUMMARY->reload_keys = 0;
+        for (j = 0; j < loads.size(); ++j) {
+                OUT_BATCH->actionBuf[j] = mv_action::generate(loads[j], 
+                                                             OUT_BATCH->arena);
+                OUT_BATCH->actionBuf[j]->__version = CREATE_MV_TIMESTAMP(1, j);
+                OUT_SUMMARY->reload_keys += loads[j]->num_writes();
+        }
+        OUT_BATCH->numActions = loads.size();
+        OUT_SUMMARY->reload_epoch = manifest.epoch;
+        OUT_SUMMARY->reload_read_cycles = rdtsc() - start;
+        std::cerr << "Done reading the checkpoint of epoch " << 
+                manifest.epoch << "!\n";
+        return true;
+}
+
+/* 
+ * Wait until every executor has executed the first num_epochs epochs. Lazy 
+ * executors acknowledge batches before they execute them.
+ */
+static void wait_executed(Executor **exec_threads, uint32_t num_epochs)
+{
+        volatile uint32_t *watermark;
+
+        watermark = exec_threads[0]->Watermark();
+        while (*watermark < num_epochs)
+                ;
+}
+
+/* 
+ * Hash of the newest value of every loaded key, taken once the pipeline is 
+ * idle. A deleted key counts as absent, whether or not its tombstone has been 
+ * reclaimed yet.
+ */
+static uint64_t state_digest(MVConfig config, MVScheduler **sched_threads)
+{
+        uint64_t record_sizes[MV_MAX_TABLES], digest, value_hash, key;
+        uint32_t num_tables, table, vpart;
+        CompositeKey composite;
+        MVRecord *record;
+
+        num_tables = get_tables(config, record_sizes);
+        digest = 0;
+        for (table = 0; table < num_tables; ++table) {
+                for (key = 0; key < config.numRecords; ++key) {
+                        composite = CompositeKey(false, table, key);
+                        composite.hash = CompositeKey::Hash(&composite);
+                        vpart = CompositeKey::Owner(composite.hash, 
+                                                    config.numVParts);
+                        record = sched_threads[0]->GetPartition(vpart, table)->
+                                GetMVRecord(key, composite.hash,
+                                            CREATE_MV_TIMESTAMP(0xFFFFFFFF, 
+                                                                0));
+                        value_hash = 0;
+                        if (record != NULL && !record->tombstone) {
+                                assert(record->value != NULL);
+                                value_hash = CityHash64((char*)record->value,
+                                                        record_sizes[table]);
+                        }
+                        digest = Hash128to64(std::make_pair(digest, 
+                                                            value_hash));
+                }
+        }
+        return digest;
+}
+
 void do_mv_experiment(MVConfig mv_config, workload_config w_config)
 {
         MVActionDistributor **pppThreads;
@@ -836,30 +2193,72 @@ void do_mv_experiment(MVConfig mv_config, workload_config w_config)
         
         SimpleQueue<MVRecordList> **schedGCQueues[mv_config.numCCThreads];
         SimpleQueue<ActionBatch> *outputQueue;
-        std::vector<ActionBatch> input_placeholder;
+        std::vector<ActionBatch> input_placeholder, reader_inputs;
+        reader_pool readers;
         timespec elapsed_time;
+        epoch_summary epochs;
+        CommandLog *log;
+        log_summary logged;
+        checkpoint_pool checkpointers;
+        WatermarkSampler *sampler;
+        checkpoint_summary ckpt;
+        ActionBatch reload_batch;
+        bool reloaded;
 
-        /* 
-         * XXX Need this for copying old versions of records if a txn performs 
-         * an RMW. Ideally, we need to separate record allocation from version 
-         * allocation to make it work properly. "Engineering effort". See 
-         * src/executor.cc.
-         */
-        if (w_config.experiment < 3)
-                GLOBAL_RECORD_SIZE = 1000;
-        else
-                GLOBAL_RECORD_SIZE = 8;
         MVScheduler::NUM_CC_THREADS = (uint32_t)mv_config.numCCThreads;
+        MVActionDistributor::NUM_CC_THREADS = (uint32_t)mv_config.numCCThreads;
         NUM_CC_THREADS = (uint32_t)mv_config.numCCThreads;
+        NUM_VPARTS = mv_config.numVParts;
+        mv_action::INCR_DELTAS = mv_config.incrDeltas != 0;
+        MVRecord::INLINE_VALUES = inline_values(mv_config);
         assert(mv_config.distribution < 2);
 
+        /* Adaptive epochs are cut from whole batches of txns. */
+        assert(mv_config.epochTargetUs == 0 || 
+               mv_config.numReaderThreads == 0);
+
+        /* 
+         * Logged epochs are the fixed size batches of the input stage. Where 
+         * restarted txns land depends on timing, so they cannot be replayed.
+         */
+        assert(mv_config.commandLog == NULL || 
+               (mv_config.epochTargetUs == 0 && !uses_recon(mv_config)));
+
+        /* A deferred txn would only be found out to restart when drained. */
+        assert(mv_config.lazyDepth == 0 || !uses_recon(mv_config));
+
+        /* 
+         * Every CC thread resolves a range read against its one partition, 
+         * so range reads need the plain layout. 
+         */
+        assert(!uses_ranges(mv_config) || 
+               (mv_config.numVParts == mv_config.numCCThreads && 
+                mv_config.repartitionInterval == 0));
+
         pppThreads = setup_ppp_threads(mv_config, &pppInputQueue, &pppOutputQueue);
 
         schedThreads = setup_scheduler_threads(mv_config, pppOutputQueue,
                                                &schedOutputQueues,
                                                schedGCQueues);
 
-        mv_setup_input_array(&input_placeholder, mv_config, w_config);
+        setup_readers(mv_config, schedThreads, &readers);
+
+        memset(&logged, 0x0, sizeof(log_summary));
+        memset(&ckpt, 0x0, sizeof(checkpoint_summary));
+        reloaded = false;
+        if (mv_config.replay) {
+                reloaded = load_checkpoint(mv_config, &reload_batch, &ckpt);
+                mv_setup_replay_input(&input_placeholder, mv_config, 
+                                      ckpt.reload_epoch,
+                                      &logged.replayed_epochs,
+                                      &logged.replayed_txns);
+        } else {
+                mv_setup_input_array(&input_placeholder, &reader_inputs, 
+                                     mv_config, w_config);
+        }
+        log = setup_command_log(mv_config);
+        setup_checkpointers(mv_config, schedThreads, readers.epochs, 
+                            &checkpointers);
 
         // If this line is moved to line 929 (before setup_ppp_threads)
         // the output queues are set to null value..??
@@ -869,15 +2268,61 @@ void do_mv_experiment(MVConfig mv_config, workload_config w_config)
 
 
         execThreads = setup_executors(mv_config, schedOutputQueues, outputQueue,
-                                      schedGCQueues);
+                                      schedGCQueues, readers.epochs);
+        for (uint32_t i = 0; i < mv_config.numCCThreads; ++i) 
+                schedThreads[i]->SetWatermark(execThreads[0]->GCWatermark());
+        if (uses_recon(mv_config))
+                setup_restarts(mv_config, pppThreads[0], execThreads);
+        pppThreads[0]->SetRepartitioning(mv_config.repartitionInterval);
+        sampler = setup_watermark_sampler(mv_config, execThreads[0]->Epochs());
 
         init_database(mv_config, w_config, pppInputQueue, outputQueue,
-                      pppThreads, schedThreads, execThreads);
+                      pppThreads, schedThreads, execThreads, &readers, log,
+                      &checkpointers, reloaded? &reload_batch : NULL, &ckpt);
 
+        /* Samples cover the run, not the load. */
+        if (sampler != NULL) {
+                sampler->Run();
+                sampler->WaitInit();
+        }
         pin_memory();
-        elapsed_time = run_experiment(pppInputQueue,  //&schedOutputQueues[config.numWorkerThreads],
-                                      outputQueue,
-                                      input_placeholder,// 1);
-                                      mv_config.numWorkerThreads);
-        write_results(mv_config, elapsed_time);
+        if (mv_config.replay) {
+                elapsed_time = run_replay(pppInputQueue, outputQueue, 
+                                          input_placeholder, 
+                                          mv_config.numWorkerThreads);
+                wait_executed(execThreads, input_placeholder.size() + 1);
+                logged.digest = state_digest(mv_config, schedThreads);
+                write_results(mv_config, uses_aborts(w_config), elapsed_time,
+                              schedThreads, 
+                              execThreads, &readers, NULL, &logged,
+                              mv_config.checkpointDir != NULL? &ckpt : NULL);
+        } else if (mv_config.epochTargetUs == 0) {
+                elapsed_time = run_experiment(pppInputQueue,  //&schedOutputQueues[config.numWorkerThreads],
+                                              outputQueue,
+                                              input_placeholder,// 1);
+                                              mv_config.numWorkerThreads,
+                                              &readers, reader_inputs, log);
+                if (log != NULL) {
+                        logged.stats = log->GetStats();
+                        wait_executed(execThreads, 
+                                      input_placeholder.size() + 1);
+                        logged.digest = state_digest(mv_config, schedThreads);
+                }
+                checkpoint_stats(&checkpointers, &ckpt);
+                write_results(mv_config, uses_aborts(w_config), elapsed_time,
+                              schedThreads, 
+                              execThreads, &readers, NULL, 
+                              log != NULL? &logged : NULL,
+                              checkpointers.num_threads > 0? &ckpt : NULL);
+        } else {
+                elapsed_time = run_adaptive_experiment(pppInputQueue, 
+                                                       outputQueue,
+                                                       input_placeholder,
+                                                       mv_config, &epochs);
+                checkpoint_stats(&checkpointers, &ckpt);
+                write_results(mv_config, uses_aborts(w_config), elapsed_time,
+                              schedThreads, 
+                              execThreads, &readers, &epochs, NULL,
+                              checkpointers.num_threads > 0? &ckpt : NULL);
+        }
 }
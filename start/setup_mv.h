@@ -3,6 +3,9 @@
 
 #include <config.h>
 
+#define MV_MAX_TABLES 2
+
 extern void do_mv_experiment(MVConfig mv_xconfig, workload_config w_config);
+extern uint32_t get_tables(MVConfig config, uint64_t *OUT_RECORD_SIZES);
 
 #endif // SETUP_MV_H_
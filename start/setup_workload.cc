@@ -24,7 +24,8 @@ uint64_t gen_unique_key(RecordGenerator *gen,
 }
 
 
-txn* generate_small_bank_action(uint32_t num_records, bool read_only)
+txn* generate_small_bank_action(uint32_t num_records, bool read_only,
+                                bool overdraft_abort)
 {
         txn *t;
         int mod, txn_type;
@@ -60,7 +61,8 @@ txn* generate_small_bank_action(uint32_t num_records, bool read_only)
                 if (rand() % 2 == 0) {
                         amount *= -1;
                 }
-                t = new SmallBank::WriteCheck(customer, amount);
+                t = new SmallBank::WriteCheck(customer, amount, 
+                                              overdraft_abort);
         } else {
                 assert(false);
         }
@@ -201,6 +203,74 @@ txn* generate_ycsb_rmw(RecordGenerator *gen, uint32_t num_reads,
         return ret;
 }
 
+/* 
+ * Scan read_txn_size records from a random start key. Keys come from the 
+ * generator, so a skewed distribution also skews where scans begin. 
+ */
+txn* generate_ycsb_scan(RecordGenerator *gen, workload_config config)
+{
+        uint64_t start;
+        txn *ret;
+
+        start = gen->GenNext();
+        ret = new ycsb_scan(start, config.num_records, config.read_txn_size);
+        assert(ret != NULL);
+        assert(ret->num_ranges() == 1);
+        return ret;
+}
+
+/* 
+ * A quarter of the txn's keys (at least one) are deleted, as many others are 
+ * inserted, and the rest are updated. All keys come from the loaded key 
+ * space, so the table neither grows nor shrinks in the long run. 
+ */
+txn* generate_ycsb_churn(RecordGenerator *gen, uint32_t num_keys)
+{
+        using namespace std;
+
+        uint32_t i, num_changes;
+        set<uint64_t> seen_keys;
+        vector<uint64_t> rmws, inserts, deletes;
+        txn *ret;
+
+        num_changes = num_keys/4 > 0? num_keys/4 : 1;
+        assert(2*num_changes <= num_keys);
+        for (i = 0; i < num_changes; ++i) {
+                deletes.push_back(gen_unique_key(gen, &seen_keys));
+                inserts.push_back(gen_unique_key(gen, &seen_keys));
+        }
+        for (i = 2*num_changes; i < num_keys; ++i) 
+                rmws.push_back(gen_unique_key(gen, &seen_keys));
+
+        ret = new ycsb_churn(rmws, inserts, deletes);
+        assert(ret != NULL);
+        assert(ret->num_deletes() == deletes.size());
+        assert(ret->num_writes() == inserts.size());
+        assert(ret->num_rmws() == rmws.size());
+        return ret;
+}
+
+/* Half of the txn's keys (at least one) are lookups, see ycsb_ollp. */
+txn* generate_ycsb_ollp(RecordGenerator *gen, uint32_t num_keys,
+                        uint64_t num_records)
+{
+        using namespace std;
+
+        uint32_t i, num_lookups;
+        set<uint64_t> seen_keys;
+        vector<uint64_t> lookups;
+        txn *ret;
+
+        num_lookups = num_keys/2 > 0? num_keys/2 : 1;
+        for (i = 0; i < num_lookups; ++i)
+                lookups.push_back(gen_unique_key(gen, &seen_keys));
+        ret = new ycsb_ollp(lookups, num_records);
+        assert(ret != NULL);
+        assert(ret->needs_recon());
+        assert(ret->num_recon_reads() == lookups.size());
+        return ret;
+}
+
 txn* generate_ycsb_action(RecordGenerator *gen, workload_config config)
 {
         uint32_t num_reads, num_rmws;
@@ -210,9 +280,16 @@ txn* generate_ycsb_action(RecordGenerator *gen, workload_config config)
         num_rmws = 0;        
         flip = (uint32_t)rand() % 100;
         assert(flip >= 0 && flip < 100);
-        if (flip < config.read_pct) {
+        if (flip < config.read_pct && config.experiment == 5) {
+                return generate_ycsb_scan(gen, config);
+        } else if (flip < config.read_pct) {
                 return generate_ycsb_readonly(gen, config);
-        } else if (config.experiment == 0) {
+        } else if (config.experiment == 6) {
+                return generate_ycsb_churn(gen, config.txn_size);
+        } else if (config.experiment == 7) {
+                return generate_ycsb_ollp(gen, config.txn_size, 
+                                          config.num_records);
+        } else if (config.experiment == 0 || config.experiment == 5) {
                 num_rmws = config.txn_size;
                 num_reads = 0;
         } else if (config.experiment == 1) {
@@ -284,7 +361,8 @@ uint32_t generate_input(workload_config conf, txn ***loaders)
 {
         if (conf.experiment == 3 || conf.experiment == 4) {
                 return generate_small_bank_input(conf, loaders);
-        } else if (conf.experiment < 3) {
+        } else if (conf.experiment < 3 || conf.experiment == 5 || 
+                   conf.experiment == 6 || conf.experiment == 7) {
                 return generate_ycsb_input(conf, loaders);
         } else {
                 assert(false);
@@ -296,21 +374,53 @@ txn* generate_transaction(workload_config config)
         txn *txn = NULL;
         
         if (config.experiment == 3) {
-                txn = generate_small_bank_action(config.num_records, false);
+                txn = generate_small_bank_action(config.num_records, false,
+                                                 config.overdraft_abort != 0);
         } else if (config.experiment == 4) {
-                txn = generate_small_bank_action(config.num_records, true);
-        } else if (config.experiment < 3) {
+                txn = generate_small_bank_action(config.num_records, true, 
+                                                 false);
+        } else if (config.experiment < 3 || config.experiment == 5 || 
+                   config.experiment == 6 || config.experiment == 7) {
                 if (config.distribution == UNIFORM && my_gen == NULL)
                         my_gen = new UniformGenerator(config.num_records);
                 else if (config.distribution == ZIPFIAN && my_gen == NULL)
                         my_gen = new ZipfGenerator((uint64_t)config.num_records,
                                                 config.theta);
                 assert(my_gen != NULL);
-                if (config.experiment < 3)
-                        txn = generate_ycsb_action(my_gen, config);
+                txn = generate_ycsb_action(my_gen, config);
         } else {
                 assert(false);
         }
         assert(txn != NULL);
         return txn;
 }
+
+/* Rebuild a txn from its command log entry, see txn::log_params. */
+txn* replay_transaction(uint32_t proc, const char *params, uint32_t size)
+{
+        using namespace SmallBank;
+
+        switch (proc) {
+        case PROC_YCSB_READONLY:
+                return ycsb_readonly::from_log(params, size);
+        case PROC_YCSB_RMW:
+                return ycsb_rmw::from_log(params, size);
+        case PROC_YCSB_CHURN:
+                return ycsb_churn::from_log(params, size);
+        case PROC_YCSB_SCAN:
+                return ycsb_scan::from_log(params, size);
+        case PROC_SB_BALANCE:
+                return Balance::from_log(params, size);
+        case PROC_SB_DEPOSIT_CHECKING:
+                return DepositChecking::from_log(params, size);
+        case PROC_SB_TRANSACT_SAVING:
+                return TransactSaving::from_log(params, size);
+        case PROC_SB_AMALGAMATE:
+                return Amalgamate::from_log(params, size);
+        case PROC_SB_WRITE_CHECK:
+                return WriteCheck::from_log(params, size);
+        default:
+                assert(false);
+                return NULL;
+        }
+}
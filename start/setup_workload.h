@@ -7,5 +7,6 @@ struct workload_config;
 
 txn* generate_transaction(workload_config conf);
 uint32_t generate_input(workload_config conf, txn ***loaders);
+txn* replay_transaction(uint32_t proc, const char *params, uint32_t size);
 
 #endif // SETUP_WORKLOAD_H_
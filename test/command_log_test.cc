@@ -0,0 +1,182 @@
+#include <gtest/gtest.h>
+
+#include <command_log.h>
+#include <setup_workload.h>
+#include <ycsb.h>
+
+#include <cstdio>
+#include <cstring>
+#include <fcntl.h>
+#include <unistd.h>
+#include <vector>
+
+#define LOG_EPOCHS 5
+
+/*
+ * The log thread never exits, so the log is written once for all tests, and
+ * each test starts from a fresh copy of it.
+ */
+class CommandLogTest : public testing::Test {
+
+protected:
+        static char path[64];
+        static std::vector<txn*> logged;
+        static std::vector<char> written;
+        std::vector<CommandLogRecord> records;
+
+        /* Epochs 2 through LOG_EPOCHS+1, epoch e holding e-1 YCSB RMWs. */
+        static void SetUpTestCase() {
+                SimpleQueue<CommandLogRecord> *queue;
+                vector<uint64_t> reads, writes;
+                CommandLogConfig config;
+                ActionBatch batch;
+                CommandLog *log;
+                uint32_t epoch, i;
+                char *values;
+                FILE *file;
+                size_t ret;
+                txn *t;
+
+                snprintf(path, sizeof(path), "/tmp/command_log_test.%d",
+                         (int)getpid());
+                values = (char*)malloc(CACHE_LINE*16);
+                queue = new SimpleQueue<CommandLogRecord>(values, 16);
+                config.cpu = 0;
+                config.path = path;
+                config.inputQueue = queue;
+                log = new (0) CommandLog(config);
+                log->Run();
+                for (epoch = 2; epoch < LOG_EPOCHS + 2; ++epoch) {
+                        memset(&batch, 0x0, sizeof(ActionBatch));
+                        batch.arena = new ActionArena(4096);
+                        batch.actionBuf = (mv_action**)
+                                batch.arena->Alloc(sizeof(mv_action*)*epoch,
+                                                   CACHE_LINE);
+                        for (i = 0; i < epoch - 1; ++i) {
+                                reads.assign(1, 100*epoch + i);
+                                writes.assign(2, 1000*epoch + i);
+                                writes[1] += 500;
+                                t = new ycsb_rmw(reads, writes);
+                                logged.push_back(t);
+                                batch.actionBuf[i] =
+                                        mv_action::generate(t, batch.arena);
+                        }
+                        batch.numActions = epoch - 1;
+                        log->Append(epoch, batch);
+                }
+                log->WaitDurable(LOG_EPOCHS + 1);
+
+                file = fopen(path, "r");
+                assert(file != NULL);
+                fseek(file, 0, SEEK_END);
+                written.resize(ftell(file));
+                rewind(file);
+                ret = fread(written.data(), 1, written.size(), file);
+                assert(ret == written.size());
+                fclose(file);
+        }
+
+        virtual void SetUp() {
+                FILE *file;
+
+                file = fopen(path, "w");
+                ASSERT_TRUE(file != NULL);
+                ASSERT_EQ(written.size(),
+                          fwrite(written.data(), 1, written.size(), file));
+                fclose(file);
+                records = CommandLog::Read(path);
+        }
+
+        static void TearDownTestCase() {
+                unlink(path);
+        }
+
+        /* Offset of the logged epoch's record in the file. */
+        virtual uint64_t Offset(uint32_t index) {
+                return records[index].data - records[0].data;
+        }
+
+        virtual uint64_t FileSize() {
+                return Offset(LOG_EPOCHS-1) + records[LOG_EPOCHS-1].size;
+        }
+
+        virtual void Corrupt(uint64_t offset) {
+                char byte;
+                int fd;
+
+                fd = open(path, O_RDWR);
+                ASSERT_TRUE(fd >= 0);
+                ASSERT_EQ(1, pread(fd, &byte, 1, offset));
+                byte ^= 0x1;
+                ASSERT_EQ(1, pwrite(fd, &byte, 1, offset));
+                close(fd);
+        }
+};
+
+char CommandLogTest::path[64];
+std::vector<txn*> CommandLogTest::logged;
+std::vector<char> CommandLogTest::written;
+
+/* Replay rebuilds every logged txn, with the keys it was logged with. */
+TEST_F(CommandLogTest, ReplayTest) {
+        struct big_key expected[2], replayed[2];
+        CommandLogHeader header;
+        CommandLogTxn entry;
+        uint64_t offset;
+        uint32_t i, j, k;
+        txn *t;
+
+        ASSERT_EQ((uint32_t)LOG_EPOCHS, records.size());
+        k = 0;
+        for (i = 0; i < records.size(); ++i) {
+                memcpy(&header, records[i].data, sizeof(CommandLogHeader));
+                ASSERT_EQ(i + 2, header.epoch);
+                ASSERT_EQ(i + 1, header.numTxns);
+                offset = sizeof(CommandLogHeader);
+                for (j = 0; j < header.numTxns; ++j, ++k) {
+                        memcpy(&entry, &records[i].data[offset],
+                               sizeof(CommandLogTxn));
+                        offset += sizeof(CommandLogTxn);
+                        ASSERT_EQ((uint32_t)PROC_YCSB_RMW, entry.proc);
+                        t = replay_transaction(entry.proc,
+                                               &records[i].data[offset],
+                                               entry.size);
+                        offset += entry.size;
+                        ASSERT_EQ(logged[k]->num_reads(), t->num_reads());
+                        ASSERT_EQ(logged[k]->num_rmws(), t->num_rmws());
+                        logged[k]->get_rmws(expected);
+                        t->get_rmws(replayed);
+                        ASSERT_TRUE(expected[0] == replayed[0]);
+                        ASSERT_TRUE(expected[1] == replayed[1]);
+                        logged[k]->get_reads(expected);
+                        t->get_reads(replayed);
+                        ASSERT_TRUE(expected[0] == replayed[0]);
+                        delete(t);
+                }
+                ASSERT_EQ(header.size, offset);
+        }
+}
+
+/* A crash in the middle of the last write loses that epoch only. */
+TEST_F(CommandLogTest, TornTailTest) {
+        ASSERT_EQ((uint32_t)LOG_EPOCHS, records.size());
+        ASSERT_EQ(written.size(), FileSize());
+        ASSERT_EQ(0, truncate(path, FileSize() - 3));
+        ASSERT_EQ((uint32_t)LOG_EPOCHS - 1, CommandLog::Read(path).size());
+
+        /* Down to a partial header. */
+        ASSERT_EQ(0, truncate(path, Offset(LOG_EPOCHS-1) + 4));
+        ASSERT_EQ((uint32_t)LOG_EPOCHS - 1, CommandLog::Read(path).size());
+}
+
+/*
+ * Replay stops at the first epoch whose checksum does not match, the intact
+ * epochs after it included.
+ */
+TEST_F(CommandLogTest, ChecksumTest) {
+        ASSERT_EQ((uint32_t)LOG_EPOCHS, records.size());
+        Corrupt(Offset(2) + sizeof(CommandLogHeader) + 5);
+        ASSERT_EQ(2U, CommandLog::Read(path).size());
+        Corrupt(Offset(0) + records[0].size - 1);
+        ASSERT_EQ(0U, CommandLog::Read(path).size());
+}
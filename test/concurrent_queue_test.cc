@@ -0,0 +1,96 @@
+#include <gtest/gtest.h>
+
+#include <concurrent_queue.h>
+
+#include <thread>
+#include <vector>
+
+class WorkStealingDequeTest : public testing::Test {
+
+protected:
+        WorkStealingDeque<uint64_t> *deque;
+
+        virtual void SetUp() {
+                deque = new (0) WorkStealingDeque<uint64_t>(1024, 0);
+        }
+};
+
+/* The owner works LIFO, thieves FIFO, and a refused element stays put. */
+TEST_F(WorkStealingDequeTest, OrderTest) {
+        uint64_t elem;
+        uint32_t i;
+
+        ASSERT_TRUE(deque->IsEmpty());
+        ASSERT_FALSE(deque->Pop(&elem));
+        ASSERT_FALSE(deque->Steal(&elem, [](uint64_t) { return true; }));
+
+        for (i = 0; i < 10; ++i)
+                deque->Push(i);
+        ASSERT_TRUE(deque->Pop(&elem));
+        ASSERT_EQ(9U, elem);
+        ASSERT_TRUE(deque->Steal(&elem, [](uint64_t) { return true; }));
+        ASSERT_EQ(0U, elem);
+        ASSERT_FALSE(deque->Steal(&elem, [](uint64_t e) { return e != 1; }));
+        ASSERT_TRUE(deque->Steal(&elem, [](uint64_t) { return true; }));
+        ASSERT_EQ(1U, elem);
+        for (i = 8; i >= 2; --i) {
+                ASSERT_TRUE(deque->Pop(&elem));
+                ASSERT_EQ(i, elem);
+        }
+        ASSERT_TRUE(deque->IsEmpty());
+        ASSERT_FALSE(deque->Pop(&elem));
+
+        /* Indexes wrap around the buffer. */
+        for (i = 0; i < 5000; ++i) {
+                deque->Push(i);
+                ASSERT_TRUE(deque->Steal(&elem, [](uint64_t) { return true; }));
+                ASSERT_EQ(i, elem);
+        }
+}
+
+/*
+ * The owner pushes bursts of elements and pops some of them back while
+ * thieves steal from the other end. Every element must be taken exactly once,
+ * including the last one in the deque, which Pop and Steal race for.
+ */
+TEST_F(WorkStealingDequeTest, ConcurrentTest) {
+        std::vector<std::thread> thieves;
+        volatile uint64_t done;
+        uint64_t *taken, elem, next;
+        uint32_t numElems, i, j;
+
+        /* Room for everything, in case the thieves fall far behind. */
+        numElems = 200000;
+        deque = new (0) WorkStealingDeque<uint64_t>(1<<18, 0);
+        taken = (uint64_t*)calloc(numElems, sizeof(uint64_t));
+        done = 0;
+        for (i = 0; i < 2; ++i) {
+                thieves.push_back(std::thread([&]() {
+                        uint64_t stolen;
+
+                        while (!done || !deque->IsEmpty()) {
+                                if (deque->Steal(&stolen,
+                                                 [](uint64_t) { return true; }))
+                                        fetch_and_increment(&taken[stolen]);
+                        }
+                }));
+        }
+        next = 0;
+        while (next < numElems) {
+                for (j = 0; j < 8 && next < numElems; ++j)
+                        deque->Push(next++);
+                for (j = 0; j < 5; ++j)
+                        if (deque->Pop(&elem))
+                                fetch_and_increment(&taken[elem]);
+        }
+        while (deque->Pop(&elem))
+                fetch_and_increment(&taken[elem]);
+        done = 1;
+        for (i = 0; i < thieves.size(); ++i)
+                thieves[i].join();
+
+        ASSERT_TRUE(deque->IsEmpty());
+        for (i = 0; i < numElems; ++i)
+                ASSERT_EQ(1U, taken[i]) << "element " << i;
+        free(taken);
+}
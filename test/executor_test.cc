@@ -0,0 +1,299 @@
+#include <gtest/gtest.h>
+
+#include <executor.h>
+#include <small_bank.h>
+#include <util.h>
+
+#include <unistd.h>
+
+#include <cstring>
+#include <map>
+#include <thread>
+#include <utility>
+
+/* An RMW of one record that adds to it and then aborts. */
+class aborted_rmw : public txn {
+ private:
+        uint64_t key;
+        uint32_t table;
+        bool incr;
+
+ public:
+        aborted_rmw(uint64_t key, uint32_t table, bool incr) {
+                this->key = key;
+                this->table = table;
+                this->incr = incr;
+        }
+
+        virtual bool Run() {
+                SmallBankRecord *rec;
+
+                rec = (SmallBankRecord*)get_write_at(0, key, table);
+                rec->amount += 1000;
+                return abort();
+        }
+
+        virtual uint32_t num_rmws() {
+                return 1;
+        }
+
+        virtual uint32_t num_incrs() {
+                return incr? 1 : 0;
+        }
+
+        virtual void get_rmws(struct big_key *array) {
+                array[0].key = key;
+                array[0].table_id = table;
+        }
+};
+
+/*
+ * A single executor, running txns of epoch 2 over SmallBank records loaded in
+ * epoch 1, which is the low watermark. Txns are given their versions as the
+ * CC stage would: each write a new version linked to the key's latest, each
+ * read the key's latest version.
+ */
+class ExecutorTest : public testing::Test {
+
+protected:
+        uint64_t recordSizes[2];
+        uint64_t allocatorSizes[2];
+        volatile uint32_t lowWatermark;
+        MVRecordAllocator *allocator;
+        ActionArena *arena;
+        Executor *exec;
+        std::map<std::pair<uint32_t, uint64_t>, MVRecord*> latest;
+        uint32_t counter;
+
+        virtual void SetUp() {
+                ExecutorConfig config;
+
+                MVRecord::INLINE_VALUES = true;
+                recordSizes[CHECKING] = sizeof(SmallBankRecord);
+                recordSizes[SAVINGS] = sizeof(SmallBankRecord);
+                allocatorSizes[CHECKING] = 0;
+                allocatorSizes[SAVINGS] = 0;
+                lowWatermark = 1;
+                counter = 0;
+
+                memset(&config, 0x0, sizeof(ExecutorConfig));
+                config.threadId = 0;
+                config.numExecutors = 1;
+                config.cpu = 0;
+                config.lowWaterMarkPtr = &lowWatermark;
+                config.numTables = 2;
+                config.recordSizes = recordSizes;
+                config.allocatorSizes = allocatorSizes;
+                config.garbageConfig.numCCThreads = 1;
+                config.garbageConfig.numWorkers = 1;
+                config.garbageConfig.numTables = 2;
+                config.garbageConfig.cpu = 0;
+                config.garbageConfig.lowWaterMarkPtr = &lowWatermark;
+                config.placement = PAYLOAD_EXECUTOR;
+                exec = new (0) Executor(config);
+                allocator = new (0) MVRecordAllocator(MV_INLINE_HEADER_SIZE*
+                                                      256, 0, 0, 0);
+                arena = new ActionArena(4096);
+        }
+
+        virtual void TearDown() {
+                arena->Release();
+                MVRecord::INLINE_VALUES = false;
+                mv_action::INCR_DELTAS = false;
+        }
+
+        virtual MVRecord* NewVersion(uint32_t table, uint64_t key,
+                                     uint64_t timestamp) {
+                MVRecord *version, *prev;
+
+                prev = latest[std::make_pair(table, key)];
+                if (!allocator->GetRecord(&version))
+                        assert(false);
+                version->createTimestamp = timestamp;
+                version->key = key;
+                version->recordLink = prev;
+                version->value = NULL;
+                version->tombstone = false;
+                version->deltaState = DELTA_NONE;
+                version->writer = NULL;
+                latest[std::make_pair(table, key)] = version;
+                return version;
+        }
+
+        virtual MVRecord* Load(uint32_t table, uint64_t key, long amount) {
+                MVRecord *version;
+
+                version = NewVersion(table, key,
+                                     CREATE_MV_TIMESTAMP(1, ++counter));
+                version->value = version->InlineValue();
+                Amount(version) = amount;
+                return version;
+        }
+
+        virtual mv_action* Generate(txn *t) {
+                mv_action *action;
+                CompositeKey *key;
+                MVRecord *version;
+                uint32_t i;
+
+                action = mv_action::generate(t, arena);
+                action->__version = CREATE_MV_TIMESTAMP(2, ++counter);
+                for (i = 0; i < action->__writeset.size(); ++i) {
+                        key = &action->__writeset[i];
+                        version = NewVersion(key->tableId, key->key,
+                                             action->__version);
+                        version->writer = action;
+                        if (key->is_incr)
+                                version->deltaState = DELTA_PENDING;
+                        key->value = version;
+                }
+                for (i = 0; i < action->__readset.size(); ++i) {
+                        key = &action->__readset[i];
+                        key->value = latest[std::make_pair(key->tableId,
+                                                           key->key)];
+                }
+                action->__state = PROCESSING;
+                return action;
+        }
+
+        long& Amount(MVRecord *version) {
+                return ((SmallBankRecord*)version->value)->amount;
+        }
+
+        bool ProcessTxn(mv_action *action) {
+                return exec->ProcessTxn(action);
+        }
+
+        uint32_t Fold(MVRecord *version, uint32_t table) {
+                return exec->Fold(version, table);
+        }
+
+        ExecutorStats& Stats() {
+                return exec->stats;
+        }
+};
+
+/*
+ * A logically aborted RMW leaves a copy of its predecessor behind, which the
+ * txns after it read as if it had written nothing.
+ */
+TEST_F(ExecutorTest, RollbackTest) {
+        mv_action *aborted, *dependent;
+        MVRecord *version;
+
+        Load(CHECKING, 7, 100);
+        Load(SAVINGS, 7, 50);
+        aborted = Generate(new aborted_rmw(7, CHECKING, false));
+        ASSERT_TRUE(ProcessTxn(aborted));
+        ASSERT_TRUE(aborted->__aborted);
+        ASSERT_EQ(SUBSTANTIATED, aborted->__state);
+        version = aborted->__writeset[0].value;
+        ASSERT_EQ(0, memcmp(version->value, version->recordLink->value,
+                            sizeof(SmallBankRecord)));
+        ASSERT_EQ(1U, Stats().aborts.procs[PROC_NONE]);
+
+        dependent = Generate(new SmallBank::WriteCheck(7, 30, false));
+        ASSERT_TRUE(ProcessTxn(dependent));
+        ASSERT_FALSE(dependent->__aborted);
+        ASSERT_EQ(version, dependent->__writeset[0].value->recordLink);
+        ASSERT_EQ(70, Amount(dependent->__writeset[0].value));
+}
+
+/*
+ * An aborted increment is rolled back to a zero delta, which folds into the
+ * value it applies to unchanged.
+ */
+TEST_F(ExecutorTest, RollbackIncrTest) {
+        mv_action *aborted, *dependent;
+        MVRecord *version;
+
+        mv_action::INCR_DELTAS = true;
+        Load(CHECKING, 7, 100);
+        Load(SAVINGS, 7, 50);
+        aborted = Generate(new aborted_rmw(7, CHECKING, true));
+        ASSERT_TRUE(aborted->__writeset[0].is_incr);
+        ASSERT_TRUE(ProcessTxn(aborted));
+        ASSERT_TRUE(aborted->__aborted);
+        version = aborted->__writeset[0].value;
+        ASSERT_EQ(DELTA_PENDING, version->deltaState);
+        ASSERT_EQ(0, Amount(version));
+
+        dependent = Generate(new SmallBank::WriteCheck(7, 30, false));
+        ASSERT_TRUE(ProcessTxn(dependent));
+        ASSERT_EQ(DELTA_NONE, version->deltaState);
+        ASSERT_EQ(100, Amount(version));
+        ASSERT_EQ(70, Amount(dependent->__writeset[0].value));
+}
+
+/*
+ * A chain of pending deltas is folded oldest first, each into the sum of the
+ * increments up to it.
+ */
+TEST_F(ExecutorTest, FoldChainTest) {
+        MVRecord *deltas[4];
+        mv_action *action;
+        long sum;
+        uint32_t i;
+
+        mv_action::INCR_DELTAS = true;
+        Load(CHECKING, 7, 100);
+        for (i = 0; i < 4; ++i) {
+                action = Generate(new SmallBank::DepositChecking(7, 1 << i));
+                ASSERT_TRUE(ProcessTxn(action));
+                deltas[i] = action->__writeset[0].value;
+                ASSERT_EQ(DELTA_PENDING, deltas[i]->deltaState);
+                ASSERT_EQ(1 << i, Amount(deltas[i]));
+        }
+
+        ASSERT_EQ(4U, Fold(deltas[3], CHECKING));
+        sum = 100;
+        for (i = 0; i < 4; ++i) {
+                sum += 1 << i;
+                ASSERT_EQ(DELTA_NONE, deltas[i]->deltaState);
+                ASSERT_EQ(sum, Amount(deltas[i]));
+        }
+        ASSERT_EQ(4U, Stats().deltas.fold_chain_max);
+        ASSERT_EQ(0U, Fold(deltas[3], CHECKING));
+        ASSERT_EQ(115, Amount(deltas[3]));
+}
+
+/*
+ * A reader that finds a delta another executor is folding waits for it, and
+ * then folds what follows onto its value.
+ */
+TEST_F(ExecutorTest, FoldWaitTest) {
+        MVRecord *deltas[2];
+        mv_action *action, *reader;
+        volatile bool done;
+        uint32_t i;
+
+        mv_action::INCR_DELTAS = true;
+        Load(CHECKING, 7, 100);
+        Load(SAVINGS, 7, 50);
+        for (i = 0; i < 2; ++i) {
+                action = Generate(new SmallBank::DepositChecking(7, 5 + i));
+                ASSERT_TRUE(ProcessTxn(action));
+                deltas[i] = action->__writeset[0].value;
+        }
+        deltas[0]->deltaState = DELTA_FOLDING;
+
+        reader = Generate(new SmallBank::WriteCheck(7, 30, false));
+        done = false;
+        std::thread thread([&] {
+                ProcessTxn(reader);
+                done = true;
+        });
+        usleep(10000);
+        EXPECT_FALSE(done);
+        EXPECT_EQ(DELTA_PENDING, deltas[1]->deltaState);
+
+        Amount(deltas[0]) += 100;
+        barrier();
+        deltas[0]->deltaState = DELTA_NONE;
+        thread.join();
+        ASSERT_TRUE(done);
+        ASSERT_EQ(DELTA_NONE, deltas[1]->deltaState);
+        ASSERT_EQ(111, Amount(deltas[1]));
+        ASSERT_EQ(81, Amount(reader->__writeset[0].value));
+        ASSERT_EQ(1U, Stats().deltas.read_folds);
+}
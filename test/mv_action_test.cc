@@ -0,0 +1,93 @@
+#include <gtest/gtest.h>
+
+#include <mv_action.h>
+#include <ycsb.h>
+
+#include <cstring>
+#include <vector>
+
+/* A YCSB RMW that counts how many of its kind have been destroyed. */
+class counted_rmw : public ycsb_rmw {
+
+ public:
+        static uint32_t destroyed;
+
+        counted_rmw(vector<uint64_t> reads, vector<uint64_t> writes)
+                : ycsb_rmw(reads, writes) { }
+
+        virtual ~counted_rmw() {
+                destroyed += 1;
+        }
+};
+
+uint32_t counted_rmw::destroyed = 0;
+
+class ActionArenaTest : public testing::Test {
+
+protected:
+        ActionArena *arena;
+
+        virtual void SetUp() {
+                arena = new ActionArena(4096);
+                counted_rmw::destroyed = 0;
+        }
+};
+
+/*
+ * Allocations are aligned as asked and never overlap, also once the first
+ * chunk runs out and for objects larger than a chunk.
+ */
+TEST_F(ActionArenaTest, AllocTest) {
+        std::vector<std::pair<char*, uint64_t> > allocs;
+        uint64_t size, alignment;
+        char *ptr;
+        uint32_t i, j;
+
+        for (i = 0; i < 1000; ++i) {
+                size = 1 + (i*37) % 200;
+                if (i == 500)
+                        size = 3*4096;
+                alignment = (uint64_t)1 << (i % 7);
+                ptr = (char*)arena->Alloc(size, alignment);
+                ASSERT_TRUE(ptr != NULL);
+                ASSERT_EQ(0U, (uintptr_t)ptr % alignment);
+                memset(ptr, (char)i, size);
+                allocs.push_back(std::make_pair(ptr, size));
+        }
+        for (i = 0; i < allocs.size(); ++i)
+                for (j = 0; j < allocs[i].second; ++j)
+                        ASSERT_EQ((char)i, allocs[i].first[j]);
+        arena->Release();
+}
+
+/*
+ * Releasing the arena frees the txns of its actions, apart from those
+ * resubmitted to a later batch, which that batch's arena frees instead.
+ */
+TEST_F(ActionArenaTest, ReleaseTest) {
+        std::vector<counted_rmw*> txns;
+        vector<uint64_t> reads, writes;
+        ActionArena *next;
+        mv_action *action;
+        uint32_t i;
+
+        for (i = 0; i < 100; ++i) {
+                reads.clear();
+                writes.clear();
+                reads.push_back(2*i);
+                writes.push_back(2*i + 1);
+                txns.push_back(new counted_rmw(reads, writes));
+                action = mv_action::generate(txns[i], arena);
+                ASSERT_TRUE(action != NULL);
+                if (i % 10 == 0)
+                        action->__resubmitted = true;
+        }
+        arena->Release();
+        ASSERT_EQ(90U, counted_rmw::destroyed);
+
+        next = new ActionArena(4096);
+        for (i = 0; i < 100; i += 10)
+                mv_action::generate(txns[i], next);
+        next->Release();
+        ASSERT_EQ(100U, counted_rmw::destroyed);
+}
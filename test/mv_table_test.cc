@@ -0,0 +1,338 @@
+#include <gtest/gtest.h>
+
+#include <mv_ordered_index.h>
+#include <mv_table.h>
+#include <db.h>
+#include <util.h>
+
+#include <algorithm>
+#include <cstdlib>
+#include <thread>
+#include <vector>
+
+static uint64_t key_hash(uint64_t key)
+{
+        struct big_key k;
+
+        k.key = key;
+        k.table_id = 0;
+        return big_key::Hash(&k);
+}
+
+class MVOrderedIndexTest : public testing::Test {
+
+protected:
+        MVOrderedIndex *index;
+        std::vector<uint64_t> keys;
+
+        virtual void SetUp() {
+                index = new (0) MVOrderedIndex(0);
+        }
+
+        /* Insert keys 0, 2, 4, ... in random order. */
+        virtual void InsertShuffled(uint32_t count) {
+                uint32_t i;
+
+                for (i = 0; i < count; ++i)
+                        keys.push_back(2*i);
+                std::random_shuffle(keys.begin(), keys.end());
+                for (i = 0; i < count; ++i)
+                        index->Insert(keys[i], key_hash(keys[i]));
+                std::sort(keys.begin(), keys.end());
+        }
+
+        /* Everything from start on, in order, hashes next to their keys. */
+        virtual void CheckScan(uint64_t start,
+                               std::vector<uint64_t>::iterator expected) {
+                MVBTreeCursor cursor;
+                uint64_t key, hash;
+
+                cursor = index->Seek(start);
+                while (index->Next(&cursor, &key, &hash)) {
+                        ASSERT_TRUE(expected != keys.end());
+                        ASSERT_EQ(*expected, key);
+                        ASSERT_EQ(key_hash(key), hash);
+                        ++expected;
+                }
+                ASSERT_TRUE(expected == keys.end());
+        }
+};
+
+TEST_F(MVOrderedIndexTest, InsertTest) {
+        MVBTreeCursor cursor;
+        uint64_t key, hash;
+
+        cursor = index->Seek(0);
+        ASSERT_FALSE(index->Next(&cursor, &key, &hash));
+
+        InsertShuffled(20);
+        ASSERT_EQ(20U, index->Size());
+        CheckScan(0, keys.begin());
+        CheckScan(7, keys.begin() + 4);
+        CheckScan(38, keys.begin() + 19);
+
+        cursor = index->Seek(39);
+        ASSERT_FALSE(index->Next(&cursor, &key, &hash));
+}
+
+/*
+ * Enough keys for leaves and inner nodes to split several times over. Every
+ * key must be found right after each insert, whichever node it landed in.
+ */
+TEST_F(MVOrderedIndexTest, SplitTest) {
+        std::vector<uint64_t> order;
+        MVBTreeCursor cursor;
+        uint64_t key, hash;
+        uint32_t i;
+
+        for (i = 0; i < 20000; ++i)
+                order.push_back(i);
+        std::random_shuffle(order.begin(), order.end());
+        for (i = 0; i < order.size(); ++i) {
+                index->Insert(order[i], key_hash(order[i]));
+                cursor = index->Seek(order[i]);
+                ASSERT_TRUE(index->Next(&cursor, &key, &hash));
+                ASSERT_EQ(order[i], key);
+        }
+        ASSERT_EQ(20000U, index->Size());
+
+        /* Ascending and descending inserts split only the edge nodes. */
+        for (i = 0; i < 5000; ++i) {
+                index->Insert(100000 + i, key_hash(100000 + i));
+                index->Insert(50000 - i, key_hash(50000 - i));
+        }
+        for (i = 0; i < 20000; ++i)
+                keys.push_back(i);
+        for (i = 45001; i <= 50000; ++i)
+                keys.push_back(i);
+        for (i = 100000; i < 105000; ++i)
+                keys.push_back(i);
+        ASSERT_EQ(keys.size(), index->Size());
+        CheckScan(0, keys.begin());
+}
+
+TEST_F(MVOrderedIndexTest, RemoveTest) {
+        std::vector<uint64_t> remaining;
+        uint32_t i;
+
+        InsertShuffled(2000);
+        for (i = 0; i < keys.size(); ++i) {
+                if (i % 3 == 0 || (i >= 300 && i < 600))
+                        index->Remove(keys[i]);
+                else
+                        remaining.push_back(keys[i]);
+        }
+        keys = remaining;
+        ASSERT_EQ(keys.size(), index->Size());
+
+        /* Leaves emptied by the removals are skipped. */
+        CheckScan(0, keys.begin());
+        CheckScan(2*300, std::lower_bound(keys.begin(), keys.end(), 2*300));
+
+        index->Insert(2*300, key_hash(2*300));
+        keys.insert(std::lower_bound(keys.begin(), keys.end(), 2*300), 2*300);
+        CheckScan(0, keys.begin());
+}
+
+class MVPartitionTest : public testing::Test {
+
+protected:
+        MVRecordAllocator *allocator;
+        MVTablePartition *partition;
+
+        virtual void MakePartition(uint64_t numKeys, MVIndexType indexType,
+                                   bool ordered) {
+                allocator = new (0) MVRecordAllocator(sizeof(MVRecord)*
+                                                      4*numKeys, 0, 0, 0);
+                partition = new (0) MVTablePartition(numKeys, 0, allocator,
+                                                     indexType, ordered);
+        }
+
+        virtual MVRecord* Write(uint64_t key, uint32_t epoch,
+                                uint32_t counter,
+                                uint8_t flags = KEY_STREAM_WRITE) {
+                MVRecord *version;
+
+                partition->WriteNewVersion(key, key_hash(key), NULL,
+                                           CREATE_MV_TIMESTAMP(epoch, counter),
+                                           &version, flags);
+                return version;
+        }
+
+        virtual MVRecord* Read(uint64_t key, uint32_t epoch) {
+                return partition->GetMVRecord(key, key_hash(key),
+                                              CREATE_MV_TIMESTAMP(epoch, 0));
+        }
+};
+
+/*
+ * A range read gets the versions of the keys in [start, end) visible at its
+ * timestamp, no more than its limit, and none of the keys deleted by then.
+ */
+TEST_F(MVPartitionTest, ScanRangeTest) {
+        MVRecord *versions[1000];
+        uint32_t count, i;
+
+        MakePartition(1000, MV_INDEX_FINGERPRINT16, true);
+        for (i = 0; i < 500; ++i)
+                Write(2*i, 1, i+1);
+        for (i = 0; i < 500; i += 10)
+                Write(2*i, 2, i+1, KEY_STREAM_DELETE);
+
+        /* Bounds: start is inclusive, end exclusive. */
+        count = partition->ScanRange(100, 200, 1000,
+                                     CREATE_MV_TIMESTAMP(2, 0), versions);
+        ASSERT_EQ(50U, count);
+        for (i = 0; i < count; ++i) {
+                ASSERT_EQ(100 + 2*i, versions[i]->key);
+                ASSERT_EQ(CREATE_MV_TIMESTAMP(1, (50 + i + 1)),
+                          versions[i]->createTimestamp);
+        }
+        count = partition->ScanRange(101, 201, 1000,
+                                     CREATE_MV_TIMESTAMP(2, 0), versions);
+        ASSERT_EQ(50U, count);
+        ASSERT_EQ(102U, versions[0]->key);
+        ASSERT_EQ(200U, versions[count-1]->key);
+
+        /* Deleted keys drop out from the tombstone's timestamp on. */
+        count = partition->ScanRange(100, 200, 1000,
+                                     CREATE_MV_TIMESTAMP(3, 0), versions);
+        ASSERT_EQ(45U, count);
+        for (i = 0; i < count; ++i)
+                ASSERT_NE(0U, versions[i]->key % 20);
+
+        /* The limit counts visible keys only, across scan windows. */
+        count = partition->ScanRange(0, 1000, 3*MV_SCAN_WINDOW,
+                                     CREATE_MV_TIMESTAMP(3, 0), versions);
+        ASSERT_EQ(3U*MV_SCAN_WINDOW, count);
+        ASSERT_EQ(2U, versions[0]->key);
+        for (i = 1; i < count; ++i)
+                ASSERT_LT(versions[i-1]->key, versions[i]->key);
+
+        /* Nothing before the first write, past the last key, or in [x, x). */
+        ASSERT_EQ(0U, partition->ScanRange(0, 1000, 1000,
+                                           CREATE_MV_TIMESTAMP(1, 0),
+                                           versions));
+        ASSERT_EQ(0U, partition->ScanRange(999, 5000, 1000,
+                                           CREATE_MV_TIMESTAMP(3, 0),
+                                           versions));
+        ASSERT_EQ(0U, partition->ScanRange(100, 100, 1000,
+                                           CREATE_MV_TIMESTAMP(3, 0),
+                                           versions));
+        ASSERT_EQ(0U, partition->ScanRange(0, 1000, 0,
+                                           CREATE_MV_TIMESTAMP(3, 0),
+                                           versions));
+}
+
+/*
+ * Snapshot readers look keys up while the owning CC thread keeps inserting
+ * new ones, splitting ordered index nodes as it goes (the ordered index
+ * itself is only ever read by the owning thread). Every key published before
+ * a lookup started must be found.
+ */
+TEST_F(MVPartitionTest, ConcurrentReadTest) {
+        volatile uint64_t published, done;
+        std::vector<std::thread> readers;
+        uint32_t numKeys, i;
+        uint64_t failures;
+
+        numKeys = 50000;
+        MakePartition(numKeys, MV_INDEX_FINGERPRINT8, true);
+        published = 0;
+        done = 0;
+        failures = 0;
+        for (i = 0; i < 2; ++i) {
+                readers.push_back(std::thread([&, i]() {
+                        uint64_t seen, key;
+                        MVRecord *version;
+                        uint32_t seed;
+
+                        seed = i;
+                        while (!done) {
+                                seen = published;
+                                if (seen == 0)
+                                        continue;
+                                key = 3*(rand_r(&seed) % seen);
+                                version = Read(key, 2);
+                                if (version == NULL || version->key != key)
+                                        fetch_and_increment(&failures);
+                        }
+                }));
+        }
+        for (i = 0; i < numKeys; ++i) {
+                Write(3*i, 1, i+1);
+                barrier();
+                published = i + 1;
+        }
+        done = 1;
+        for (i = 0; i < readers.size(); ++i)
+                readers[i].join();
+        ASSERT_EQ(0U, failures);
+
+        std::vector<MVRecord*> versions(numKeys);
+        ASSERT_EQ(numKeys, partition->ScanRange(0, 3*numKeys, numKeys,
+                                                CREATE_MV_TIMESTAMP(2, 0),
+                                                versions.data()));
+        for (i = 0; i < numKeys; ++i)
+                ASSERT_EQ(3*i, versions[i]->key);
+}
+
+/*
+ * A fingerprint index never removes entries, a dead key's entry is released
+ * and reused by a later key instead. Many more keys than the index has
+ * entries come and go, which only fits if released entries are reused.
+ */
+TEST_F(MVPartitionTest, ReclaimReuseTest) {
+        std::vector<MVRecord*> heads;
+        MVRecord *versions[64];
+        uint32_t numKeys, round, epoch, i;
+        uint64_t key;
+
+        numKeys = 64;
+        allocator = new (0) MVRecordAllocator(sizeof(MVRecord)*64*numKeys, 0,
+                                              0, 0);
+        partition = new (0) MVTablePartition(numKeys, 0, allocator,
+                                             MV_INDEX_FINGERPRINT8, true);
+        ASSERT_LT(partition->IndexSize()*7, 20*numKeys);
+        for (round = 0; round < 20; ++round) {
+                epoch = round + 1;
+                for (i = 0; i < numKeys; ++i)
+                        Write(1000*round + i, epoch, i+1);
+                for (i = 0; i < numKeys; ++i)
+                        Write(1000*round + i, epoch, numKeys+i+1,
+                              KEY_STREAM_DELETE);
+
+                /* Nothing is reclaimed before the watermark passes. */
+                ASSERT_EQ(0U, partition->ReclaimDeadKeys(epoch - 1, epoch));
+                heads.clear();
+                partition->GetHeads(0, partition->IndexSize(), &heads);
+                ASSERT_EQ(numKeys, heads.size());
+
+                ASSERT_EQ(numKeys, partition->ReclaimDeadKeys(epoch,
+                                                              epoch + 1));
+                heads.clear();
+                partition->GetHeads(0, partition->IndexSize(), &heads);
+                ASSERT_EQ(0U, heads.size());
+                for (i = 0; i < numKeys; ++i) {
+                        key = 1000*round + i;
+                        ASSERT_TRUE(Read(key, epoch + 1) == NULL);
+                        ASSERT_TRUE(Read(key, epoch) == NULL);
+                }
+                ASSERT_EQ(0U, partition->ScanRange(0, 1000*(round+1),
+                                                   numKeys,
+                                                   CREATE_MV_TIMESTAMP(epoch+1,
+                                                                       0),
+                                                   versions));
+        }
+
+        /* Keys written into reused entries are found like any other. */
+        for (i = 0; i < numKeys; ++i)
+                Write(7*i, 30, i+1);
+        for (i = 0; i < numKeys; ++i) {
+                ASSERT_TRUE(Read(7*i, 31) != NULL);
+                ASSERT_EQ(7*i, Read(7*i, 31)->key);
+        }
+        ASSERT_EQ(numKeys, partition->ScanRange(0, 7*numKeys, numKeys,
+                                                CREATE_MV_TIMESTAMP(31, 0),
+                                                versions));
+}
@@ -0,0 +1,85 @@
+#!/usr/bin/python
+
+# End-to-end check of the command log and checkpoints: the state a logged run
+# leaves behind (log_digest) must be rebuilt exactly by replaying its log
+# against a fresh load, and by reloading its last checkpoint and replaying
+# the epochs logged after it. Run from the top of the tree after make, or
+# pass the binary to test.
+
+import os
+import shutil
+import subprocess
+import sys
+import tempfile
+
+fmt_run = "{0} --cc_type 0 --num_cc_threads 2 --num_txns 20000 --epoch_size 200 --num_records 1000 --num_worker_threads 2 --txn_size 8 --experiment {1} --record_size 1000 --distribution 0 --read_pct 0 --read_txn_size 5 --num_ppp_threads 1 --command_log {2}/log"
+
+
+# The key:value results of the last run in results.txt.
+def last_results(workdir):
+    lines = open(os.path.join(workdir, "results.txt")).read().splitlines()
+    results = {}
+    for tok in lines[-1].split():
+        if ":" in tok:
+            key, value = tok.split(":", 1)
+            results[key] = value
+    return results
+
+
+def run(workdir, cmd):
+    out = open(os.path.join(workdir, "out.txt"), "w")
+    ret = subprocess.call(cmd.split(), cwd=workdir, stdout=out, stderr=out)
+    out.close()
+    if ret != 0:
+        print("FAILED (exit " + str(ret) + "): " + cmd)
+        sys.exit(1)
+    return last_results(workdir)
+
+
+def check(name, expected, got):
+    if expected != got:
+        print("FAILED " + name + ": " + str(expected) + " != " + str(got))
+        sys.exit(1)
+    print("ok " + name + ": " + str(got))
+
+
+# A YCSB run and its replay.
+def replay_ycsb(binary, workdir):
+    cmd = fmt_run.format(binary, 0, workdir)
+    logged = run(workdir, cmd)
+    replayed = run(workdir, cmd + " --replay 1")
+    check("ycsb replay_epochs", logged["log_epochs"], replayed["replay_epochs"])
+    check("ycsb log_digest", logged["log_digest"], replayed["log_digest"])
+
+
+# A SmallBank run with aborts that checkpoints as it goes, replayed from the
+# load and from its last checkpoint.
+def replay_small_bank(binary, workdir):
+    ckpt_dir = os.path.join(workdir, "ckpt")
+    os.mkdir(ckpt_dir)
+    cmd = fmt_run.format(binary, 3, workdir) + " --overdraft_abort 1"
+    logged = run(workdir, cmd + " --checkpoint_dir " + ckpt_dir +
+                 " --checkpoint_interval 20")
+    replayed = run(workdir, cmd + " --replay 1")
+    check("small_bank log_digest", logged["log_digest"],
+          replayed["log_digest"])
+    reloaded = run(workdir, cmd + " --checkpoint_dir " + ckpt_dir +
+                   " --replay 1")
+    if int(reloaded["reload_epoch"]) == 0:
+        print("FAILED small_bank: no checkpoint was reloaded")
+        sys.exit(1)
+    check("small_bank checkpoint log_digest", logged["log_digest"],
+          reloaded["log_digest"])
+
+
+def main():
+    binary = os.path.abspath(sys.argv[1] if len(sys.argv) > 1 else "build/db")
+    workdir = tempfile.mkdtemp(prefix="replay_test.")
+    try:
+        replay_ycsb(binary, workdir)
+        replay_small_bank(binary, workdir)
+    finally:
+        shutil.rmtree(workdir)
+
+if __name__ == "__main__":
+    main()
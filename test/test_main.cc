@@ -0,0 +1,19 @@
+#include <gtest/gtest.h>
+#include <database.h>
+
+#include <cstdlib>
+#include <time.h>
+
+/* Globals that start/main.cc defines for the benchmark binary. */
+uint32_t GLOBAL_RECORD_SIZE = 1000;
+Database DB(2);
+uint32_t NUM_CC_THREADS = 1;
+uint32_t NUM_VPARTS = 1;
+uint64_t recordSize = 1000;
+
+int main(int argc, char **argv)
+{
+        srand(time(NULL));
+        testing::InitGoogleTest(&argc, argv);
+        return RUN_ALL_TESTS();
+}
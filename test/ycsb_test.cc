@@ -0,0 +1,125 @@
+#include <gtest/gtest.h>
+
+#include <mv_record.h>
+#include <setup_mv.h>
+#include <ycsb.h>
+
+#include <cstring>
+#include <unordered_map>
+
+/*
+ * Serves a txn's reads and writes from version headers, placing each value
+ * the way Executor::InstallPayloads does for a table of the given record
+ * size: inline when it fits, in a separate payload otherwise.
+ */
+class VersionTranslator : public translator {
+
+ public:
+        std::unordered_map<uint64_t, MVRecord*> versions;
+
+        VersionTranslator(txn *t) : translator(t) { }
+
+        virtual void *write_ref(uint64_t key,
+                                __attribute__((unused)) uint32_t table) {
+                return versions[key]->value;
+        }
+
+        virtual void *read(uint64_t key,
+                           __attribute__((unused)) uint32_t table) {
+                return versions[key]->value;
+        }
+
+        virtual int rand() {
+                return 0;
+        }
+};
+
+class YCSBRecordTest : public testing::Test {
+
+protected:
+        static const uint32_t numKeys = 4;
+
+        uint64_t recordSize, headerSize;
+        char *headers;
+        char *pristine;
+
+        /* Headers are laid out the way MVRecordAllocator hands them out. */
+        MVRecord* Header(char *base, uint32_t i) {
+                return (MVRecord*)&base[i*headerSize];
+        }
+
+        virtual void SetUp() {
+                MVConfig config;
+                uint64_t sizes[MV_MAX_TABLES];
+
+                config.experiment = 0;
+                ASSERT_EQ(1U, get_tables(config, sizes));
+                recordSize = sizes[0];
+                MVRecord::INLINE_VALUES = recordSize <= MV_INLINE_SIZE;
+                headerSize = MVRecord::HeaderSize();
+
+                /*
+                 * One header past the keys' own, to catch a write that runs
+                 * off the end of a value.
+                 */
+                headers = new char[headerSize*(numKeys+1)];
+                pristine = new char[headerSize*(numKeys+1)];
+                memset(headers, 0x0, headerSize*(numKeys+1));
+                for (uint32_t i = 0; i < numKeys; ++i) {
+                        if (MVRecord::INLINE_VALUES)
+                                Header(headers, i)->value =
+                                        Header(headers, i)->InlineValue();
+                        else
+                                Header(headers, i)->value = malloc(recordSize);
+                        memset(Header(headers, i)->value, 0x0, recordSize);
+                }
+                memcpy(pristine, headers, headerSize*(numKeys+1));
+        }
+
+        virtual void TearDown() {
+                for (uint32_t i = 0; i < numKeys; ++i)
+                        if (!Header(headers, i)->IsInline())
+                                free(Header(headers, i)->value);
+                delete[] headers;
+                delete[] pristine;
+                MVRecord::INLINE_VALUES = false;
+        }
+};
+
+/*
+ * A YCSB RMW only touches the values of its keys, wherever the table keeps
+ * them.
+ */
+TEST_F(YCSBRecordTest, RMWStaysInRecord) {
+        vector<uint64_t> reads, writes;
+        uint64_t *fields;
+        uint32_t i;
+
+        reads.push_back(0);
+        reads.push_back(1);
+        writes.push_back(2);
+        writes.push_back(3);
+        ycsb_rmw rmw(reads, writes);
+        VersionTranslator trans(&rmw);
+        for (i = 0; i < numKeys; ++i)
+                trans.versions[i] = Header(headers, i);
+        rmw.set_translator(&trans);
+        ASSERT_TRUE(rmw.Run());
+
+        /* Headers are untouched, apart from inline values that were written. */
+        for (i = 0; i <= numKeys; ++i) {
+                ASSERT_EQ(0, memcmp(Header(pristine, i), Header(headers, i),
+                                    sizeof(MVRecord)));
+                if (i == numKeys || !Header(headers, i)->IsInline()) {
+                        ASSERT_EQ(0, memcmp(Header(pristine, i) + 1,
+                                            Header(headers, i) + 1,
+                                            headerSize - sizeof(MVRecord)));
+                }
+        }
+
+        /* The writes added j+1 to each field j of their records. */
+        fields = (uint64_t*)Header(headers, 2)->value;
+        ASSERT_EQ(1U, fields[0]);
+        fields = (uint64_t*)Header(headers, 0)->value;
+        ASSERT_EQ(0U, fields[0]);
+}